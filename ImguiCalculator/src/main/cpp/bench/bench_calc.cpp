@@ -0,0 +1,341 @@
+//
+// Benchmark suite for calculator::calEverything.
+//
+// Each case is one point in a grid over expression length (operand count),
+// operator mix and trig density (the share of operands wrapped in sin, cos
+// or tan). A case times calls over a fixed corpus of random expressions
+// until it has run for --min-time seconds, keeps the best of --repetitions
+// runs, and reports ns per expression, input throughput and heap
+// allocations per call. Allocations are counted by replacing the global
+// operator new, so they cover everything C++ allocates on the call's
+// behalf, the log line included. The log goes to /dev/null while timing,
+// so the figures exclude terminal I/O.
+//
+// Usage: calc_bench [--filter SUBSTR] [--min-time SECONDS] [--repetitions N]
+//                   [--json FILE|-] [--label TEXT]
+//
+// --json writes the results in a stable JSON layout for tracking them from
+// commit to commit ("-" for stdout, in which case the table goes to
+// stderr); --label is copied into it, e.g. the commit id.
+//
+#include "bench_util.h"
+#include "calc_simd.h"
+#include "calc_trig.h"
+#include "calculator.h"
+#include "logger.h"
+#include <new>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    // Per thread, so the log's writer thread is not counted against the
+    // calls being timed.
+    thread_local size_t allocCount = 0;
+    thread_local size_t allocBytes = 0;
+
+}
+
+void* operator new(size_t size)
+{
+    ++allocCount;
+    allocBytes += size;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    ++allocCount;
+    allocBytes += size;
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+// GCC cannot see that the operator new above gets its memory from malloc.
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+    enum Mix { MIX_ADD, MIX_MUL, MIX_ALL };
+    const char* const kMixNames[] = { "add", "mul", "all" };
+
+    struct Case {
+        std::string name;
+        int operands;
+        Mix mix;
+        int trigPercent;
+    };
+
+    struct Result {
+        std::string name;
+        size_t iterations;
+        double nsPerExpr;
+        double exprsPerSecond;
+        double bytesPerSecond;
+        double allocsPerCall;
+        double allocBytesPerCall;
+        double avgLength;
+    };
+
+    std::string makeOperand(std::mt19937_64& rng, int trigPercent)
+    {
+        std::uniform_int_distribution<int> percent(0, 99);
+        std::uniform_int_distribution<int> whole(1, 9999);
+        std::uniform_int_distribution<int> frac(0, 99);
+        std::string s;
+        if (percent(rng) < trigPercent) {
+            static const char* const kFns[] = { "sin", "cos", "tan" };
+            s += kFns[percent(rng) % 3];
+        }
+        char buf[32];
+        if (percent(rng) < 50)
+            snprintf(buf, sizeof(buf), "%d", whole(rng));
+        else
+            snprintf(buf, sizeof(buf), "%d.%02d", whole(rng), frac(rng));
+        s += buf;
+        return s;
+    }
+
+    std::string makeExpression(std::mt19937_64& rng, const Case& c)
+    {
+        static const char kAddOps[] = "+-";
+        static const char kMulOps[] = "X/";
+        static const char kAllOps[] = "+-X/";
+        std::uniform_int_distribution<int> pick(0, 1 << 20);
+        std::string s = makeOperand(rng, c.trigPercent);
+        int open = 0;
+        for (int i = 1; i < c.operands; ++i) {
+            switch (c.mix) {
+                case MIX_ADD: s += kAddOps[pick(rng) % 2]; break;
+                case MIX_MUL: s += kMulOps[pick(rng) % 2]; break;
+                default:      s += kAllOps[pick(rng) % 4]; break;
+            }
+            // The full mix also nests: open a group now and then, close it
+            // a few operands later.
+            if (c.mix == MIX_ALL && pick(rng) % 4 == 0) {
+                s += '(';
+                ++open;
+            }
+            s += makeOperand(rng, c.trigPercent);
+            if (open && pick(rng) % 3 == 0) {
+                s += ')';
+                --open;
+            }
+        }
+        s.append((size_t) open, ')');
+        return s;
+    }
+
+    Result runCase(const Case& c, double minTime, int repetitions)
+    {
+        const size_t kCorpus = 512;
+        std::mt19937_64 rng(20180805 + c.operands * 31 + c.mix * 7 + c.trigPercent);
+        std::vector<std::string> corpus(kCorpus);
+        size_t bytes = 0;
+        for (size_t i = 0; i < kCorpus; ++i) {
+            corpus[i] = makeExpression(rng, c);
+            bytes += corpus[i].size();
+        }
+
+        Result r;
+        r.name = c.name;
+        r.avgLength = (double) bytes / kCorpus;
+        r.iterations = 0;
+        double bestPerExpr = 1e30;
+        size_t allocs = 0, allocated = 0;
+        double sum = 0.0;
+        for (int rep = 0; rep < repetitions; ++rep) {
+            // Grow the pass count until one timed run lasts minTime.
+            size_t passes = 1;
+            for (;;) {
+                size_t allocsBefore = allocCount, bytesBefore = allocBytes;
+                bench::Timer timer;
+                for (size_t p = 0; p < passes; ++p)
+                    for (size_t i = 0; i < kCorpus; ++i)
+                        sum += calculator::calEverything(corpus[i]);
+                double elapsed = timer.seconds();
+                if (elapsed < minTime && passes < ((size_t) 1 << 30)) {
+                    double scale = elapsed > 0 ? 1.4 * minTime / elapsed : 10.0;
+                    passes = (size_t) (passes * (scale > 10.0 ? 10.0 : scale < 2.0 ? 2.0 : scale));
+                    continue;
+                }
+                size_t iterations = passes * kCorpus;
+                if (elapsed / iterations < bestPerExpr) {
+                    bestPerExpr = elapsed / iterations;
+                    r.iterations = iterations;
+                    allocs = allocCount - allocsBefore;
+                    allocated = allocBytes - bytesBefore;
+                }
+                break;
+            }
+        }
+        bench::doNotOptimize(sum);
+
+        r.nsPerExpr = bestPerExpr * 1e9;
+        r.exprsPerSecond = 1.0 / bestPerExpr;
+        r.bytesPerSecond = r.avgLength / bestPerExpr;
+        r.allocsPerCall = (double) allocs / r.iterations;
+        r.allocBytesPerCall = (double) allocated / r.iterations;
+        return r;
+    }
+
+    void writeJsonString(FILE* f, const std::string& s)
+    {
+        fputc('"', f);
+        for (size_t i = 0; i < s.size(); ++i) {
+            char ch = s[i];
+            if (ch == '"' || ch == '\\')
+                fprintf(f, "\\%c", ch);
+            else if ((unsigned char) ch < 0x20)
+                fprintf(f, "\\u%04x", ch);
+            else
+                fputc(ch, f);
+        }
+        fputc('"', f);
+    }
+
+    void writeJson(FILE* f, const std::vector<Result>& results, const std::string& label,
+                   double minTime, int repetitions)
+    {
+        char date[32];
+        time_t now = time(NULL);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+        char host[256] = "";
+        gethostname(host, sizeof(host) - 1);
+
+        fprintf(f, "{\n  \"context\": {\n    \"date\": ");
+        writeJsonString(f, date);
+        fprintf(f, ",\n    \"host_name\": ");
+        writeJsonString(f, host);
+        fprintf(f, ",\n    \"label\": ");
+        writeJsonString(f, label);
+        fprintf(f, ",\n    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+        fprintf(f, "    \"column_kernels\": \"%s\",\n", calc::columnKernels().name);
+        fprintf(f, "    \"trig_kernels\": \"%s\",\n", calc::trigKernels().name);
+        fprintf(f, "    \"min_time\": %g,\n    \"repetitions\": %d\n  },\n", minTime, repetitions);
+        fprintf(f, "  \"benchmarks\": [");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            fprintf(f, "%s\n    {\n      \"name\": ", i ? "," : "");
+            writeJsonString(f, r.name);
+            fprintf(f, ",\n      \"iterations\": %zu,\n", r.iterations);
+            fprintf(f, "      \"ns_per_expr\": %.3f,\n", r.nsPerExpr);
+            fprintf(f, "      \"exprs_per_second\": %.1f,\n", r.exprsPerSecond);
+            fprintf(f, "      \"bytes_per_second\": %.1f,\n", r.bytesPerSecond);
+            fprintf(f, "      \"allocs_per_call\": %.3f,\n", r.allocsPerCall);
+            fprintf(f, "      \"alloc_bytes_per_call\": %.1f,\n", r.allocBytesPerCall);
+            fprintf(f, "      \"avg_expr_bytes\": %.1f\n    }", r.avgLength);
+        }
+        fprintf(f, "\n  ]\n}\n");
+    }
+
+    int usage()
+    {
+        fprintf(stderr, "usage: calc_bench [--filter SUBSTR] [--min-time SECONDS] [--repetitions N]\n"
+                        "                  [--json FILE|-] [--label TEXT]\n");
+        return 2;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = "";
+    const char* jsonPath = NULL;
+    std::string label;
+    double minTime = 0.1;
+    int repetitions = 3;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc)
+            return usage();
+        const char* value = argv[++i];
+        if (!strcmp(arg, "--filter"))
+            filter = value;
+        else if (!strcmp(arg, "--min-time"))
+            minTime = atof(value);
+        else if (!strcmp(arg, "--repetitions"))
+            repetitions = atoi(value) > 0 ? atoi(value) : 1;
+        else if (!strcmp(arg, "--json"))
+            jsonPath = value;
+        else if (!strcmp(arg, "--label"))
+            label = value;
+        else
+            return usage();
+    }
+
+    std::vector<Case> cases;
+    static const int kOperands[] = { 2, 8, 32, 128 };
+    static const int kTrigPercents[] = { 0, 25, 100 };
+    for (size_t l = 0; l < sizeof(kOperands) / sizeof(kOperands[0]); ++l) {
+        for (int m = MIX_ADD; m <= MIX_ALL; ++m) {
+            for (size_t t = 0; t < sizeof(kTrigPercents) / sizeof(kTrigPercents[0]); ++t) {
+                Case c;
+                c.operands = kOperands[l];
+                c.mix = (Mix) m;
+                c.trigPercent = kTrigPercents[t];
+                char name[96];
+                snprintf(name, sizeof(name), "calEverything/operands:%d/mix:%s/trig:%d",
+                         c.operands, kMixNames[m], c.trigPercent);
+                c.name = name;
+                if (strstr(name, filter))
+                    cases.push_back(c);
+            }
+        }
+    }
+
+    bool jsonToStdout = jsonPath && !strcmp(jsonPath, "-");
+    FILE* table = jsonToStdout ? stderr : stdout;
+    fprintf(table, "%-46s %12s %10s %12s %10s %12s\n",
+            "benchmark", "iterations", "ns/expr", "Mexpr/s", "MB/s", "allocs/call");
+
+    std::vector<Result> results;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        _Logger::Logger::setFile("/dev/null");
+        Result r = runCase(cases[i], minTime, repetitions);
+        _Logger::Logger::setFile(NULL);
+        results.push_back(r);
+        fprintf(table, "%-46s %12zu %10.1f %12.3f %10.1f %12.2f\n", r.name.c_str(), r.iterations,
+                r.nsPerExpr, r.exprsPerSecond / 1e6, r.bytesPerSecond / 1e6, r.allocsPerCall);
+        fflush(table);
+    }
+
+    if (jsonPath) {
+        FILE* f = jsonToStdout ? stdout : fopen(jsonPath, "w");
+        if (!f) {
+            perror(jsonPath);
+            return 1;
+        }
+        writeJson(f, results, label, minTime, repetitions);
+        if (!jsonToStdout)
+            fclose(f);
+    }
+    return 0;
+}
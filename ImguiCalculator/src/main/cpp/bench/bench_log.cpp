@@ -0,0 +1,122 @@
+//
+// Cost of a Log(...) or LogEvent(...) call that is filtered out, against one
+// that is written.
+//
+// Every call logs two integers and a double, one of the integers the result
+// of a function that counts its calls, so the table also shows whether a
+// filtered call evaluated its arguments. LOG_DEBUG lines are compiled out
+// when LOG_MIN_SEVERITY is above LOG_DEBUG (release builds) and filtered at
+// run time otherwise; LOG_WARN lines are filtered at run time by
+// Logger::minSeverity(). Written lines go to /dev/null, as text or as an
+// event file. Back to back, they soon fill the calling thread's ring, and
+// from then on the loop times the writer's throughput. The "caller side"
+// cases log half a ring per timed batch and flush between batches, outside
+// the timer, so they time only what a call costs the thread making it.
+//
+// Usage: calc_log_bench [count]
+//
+#include "bench_util.h"
+#include "logger.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+    size_t evaluated = 0;
+
+    __attribute__((noinline)) int argument(size_t i)
+    {
+        ++evaluated;
+        return (int) i;
+    }
+
+    struct Case {
+        const char* name;
+        _Logger::Severity minSeverity;
+        bool eventFile;
+        size_t count;
+        size_t batch;           // calls per timed batch, 0 for all of them
+        void (*run)(size_t);
+    };
+
+    void runEmpty(size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            bench::doNotOptimize(i);
+    }
+
+    void runDebug(size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            Log(LOG_DEBUG) << "step " << argument(i) << " depth " << i % 7 << " value " << i * 0.25;
+            bench::doNotOptimize(i);
+        }
+    }
+
+    void runWarn(size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            Log(LOG_WARN) << "step " << argument(i) << " depth " << i % 7 << " value " << i * 0.25;
+            bench::doNotOptimize(i);
+        }
+    }
+
+    void runWarnEvent(size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            LogEvent(LOG_WARN, "step {} depth {} value {}", argument(i), i % 7, i * 0.25);
+            bench::doNotOptimize(i);
+        }
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? (size_t) strtoull(argv[1], NULL, 10) : 10000000;
+    bool debugCompiledIn = _Logger::LOG_DEBUG >= _Logger::LOG_MIN_SEVERITY;
+
+    const size_t batch = _Logger::Logger::kRingLines / 2;
+    const Case cases[] = {
+        { "empty loop", _Logger::LOG_DEBUG, false, count, 0, runEmpty },
+        { debugCompiledIn ? "LOG_DEBUG, filtered at run time" : "LOG_DEBUG, compiled out",
+                _Logger::LOG_ERROR, false, count, 0, runDebug },
+        { "LOG_WARN, filtered at run time", _Logger::LOG_ERROR, false, count, 0, runWarn },
+        { "LOG_WARN, written", _Logger::LOG_WARN, false, count / 10, 0, runWarn },
+        { "LOG_WARN, written, caller side", _Logger::LOG_WARN, false, count / 10, batch, runWarn },
+        { "LogEvent LOG_WARN, filtered", _Logger::LOG_ERROR, false, count, 0, runWarnEvent },
+        { "LogEvent LOG_WARN, written as text", _Logger::LOG_WARN, false, count / 10, 0, runWarnEvent },
+        { "LogEvent LOG_WARN, as text, caller side", _Logger::LOG_WARN, false, count / 10, batch, runWarnEvent },
+        { "LogEvent LOG_WARN, to an event file", _Logger::LOG_WARN, true, count / 10, 0, runWarnEvent },
+        { "LogEvent LOG_WARN, event file, caller side", _Logger::LOG_WARN, true, count / 10, batch, runWarnEvent },
+    };
+
+    if (!_Logger::Logger::setFile("/dev/null")) {
+        fprintf(stderr, "calc_log_bench: cannot open /dev/null\n");
+        return 1;
+    }
+    printf("%-44s %12s %10s %16s\n", "case", "calls", "ns/call", "args evaluated");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        const Case& k = cases[c];
+        _Logger::Logger::minSeverity() = k.minSeverity;
+        _Logger::Logger::setEventFile(k.eventFile ? "/dev/null" : NULL);
+        // Best of a few passes.
+        double best = 1e30;
+        evaluated = 0;
+        size_t batchSize = k.batch ? k.batch : k.count;
+        for (int pass = 0; pass < 5; ++pass) {
+            double elapsed = 0;
+            for (size_t done = 0; done < k.count; done += batchSize) {
+                bench::Timer timer;
+                k.run(std::min(batchSize, k.count - done));
+                elapsed += timer.seconds();
+                _Logger::Logger::flush();
+            }
+            if (elapsed < best)
+                best = elapsed;
+        }
+        printf("%-44s %12zu %10.2f %16zu\n", k.name, k.count, best * 1e9 / k.count, evaluated);
+    }
+    return 0;
+}
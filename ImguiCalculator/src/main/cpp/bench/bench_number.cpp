@@ -0,0 +1,185 @@
+//
+// Compares calc_number's conversions with the ones the calculator used before.
+//
+// Parsing is timed over random literals the way the keypad produces them:
+// mostly short integers and decimals, with some long digit runs. Formatting
+// is timed over calculator-like results (literals and quotients of them).
+// Each formatter is also checked for whether its text reads back exactly.
+//
+// Usage: calc_number_bench [count]
+//
+#include "bench_util.h"
+#include "calc_number.h"
+#include <random>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+    struct Literals {
+        std::vector<char> text;
+        std::vector<size_t> start;
+        std::vector<size_t> length;
+    };
+
+    Literals makeLiterals(size_t count, std::mt19937_64& rng)
+    {
+        Literals lits;
+        std::uniform_int_distribution<int> digit(0, 9);
+        std::uniform_int_distribution<int> shortLen(1, 6);
+        std::uniform_int_distribution<int> longLen(7, 24);
+        std::uniform_int_distribution<int> shape(0, 9);
+        for (size_t i = 0; i < count; ++i) {
+            int s = shape(rng);
+            int intDigits = s < 8 ? shortLen(rng) : longLen(rng);
+            int fracDigits = s < 4 ? 0 : s < 8 ? shortLen(rng) : longLen(rng) / 2;
+            lits.start.push_back(lits.text.size());
+            lits.text.push_back((char) ('1' + digit(rng) % 9));
+            for (int d = 1; d < intDigits; ++d)
+                lits.text.push_back((char) ('0' + digit(rng)));
+            if (fracDigits) {
+                lits.text.push_back('.');
+                for (int d = 0; d < fracDigits; ++d)
+                    lits.text.push_back((char) ('0' + digit(rng)));
+            }
+            lits.length.push_back(lits.text.size() - lits.start.back());
+        }
+        return lits;
+    }
+
+    // The original evaluator: one ostringstream per character, then std::stod.
+    double parseStream(const char* s, size_t n)
+    {
+        std::string output = "0";
+        for (size_t i = 0; i < n; ++i) {
+            std::ostringstream strs;
+            strs << s[i];
+            output += strs.str();
+        }
+        return std::stod(output);
+    }
+
+    // The strtod path calc_program used before calc_number.
+    double parseStrtod(const char* s, size_t n)
+    {
+        char buf[64];
+        if (n < sizeof(buf)) {
+            memcpy(buf, s, n);
+            buf[n] = '\0';
+            return strtod(buf, NULL);
+        }
+        std::string big(s, n);
+        return strtod(big.c_str(), NULL);
+    }
+
+    size_t formatStream(double v, char* buf)
+    {
+        std::ostringstream strs;
+        strs << v;
+        std::string s = strs.str();
+        size_t n = s.size() < calc::kFormatBufferSize - 1 ? s.size() : calc::kFormatBufferSize - 1;
+        memcpy(buf, s.data(), n);
+        buf[n] = '\0';
+        return n;
+    }
+
+    size_t formatPrintf(double v, char* buf)
+    {
+        return (size_t) snprintf(buf, calc::kFormatBufferSize, "%g", v);
+    }
+
+    // Round-trips, but is not the shortest text.
+    size_t formatPrintf17(double v, char* buf)
+    {
+        return (size_t) snprintf(buf, calc::kFormatBufferSize, "%.17g", v);
+    }
+
+    size_t formatNew(double v, char* buf)
+    {
+        return calc::formatShortest(v, buf);
+    }
+
+    double parseNew(const char* s, size_t n)
+    {
+        return calc::parseLiteral(s, n);
+    }
+
+    void runParse(const char* name, double (*parse)(const char*, size_t), const Literals& lits,
+                  const std::vector<double>& reference)
+    {
+        size_t count = lits.start.size();
+        size_t wrong = 0;
+        double sum = 0.0;
+        bench::Timer timer;
+        for (size_t i = 0; i < count; ++i) {
+            double v = parse(&lits.text[lits.start[i]], lits.length[i]);
+            sum += v;
+            if (v != reference[i])
+                ++wrong;
+        }
+        double elapsed = timer.seconds();
+        bench::doNotOptimize(sum);
+        printf("parse  %-8s %8.1f ns/literal  %zu inexact\n", name, elapsed * 1e9 / count, wrong);
+    }
+
+    void runFormat(const char* name, size_t (*format)(double, char*), const std::vector<double>& values)
+    {
+        size_t count = values.size();
+        char buf[calc::kFormatBufferSize];
+        size_t total = 0;
+        bench::Timer timer;
+        for (size_t i = 0; i < count; ++i) {
+            total += format(values[i], buf);
+            bench::doNotOptimize(buf);
+        }
+        double elapsed = timer.seconds();
+
+        size_t lossy = 0;
+        for (size_t i = 0; i < count; ++i) {
+            format(values[i], buf);
+            if (strtod(buf, NULL) != values[i])
+                ++lossy;
+        }
+        printf("format %-8s %8.1f ns/value    %zu do not round-trip, %.1f chars avg\n",
+               name, elapsed * 1e9 / count, lossy, (double) total / count);
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? (size_t) strtoull(argv[1], NULL, 10) : 2000000;
+    std::mt19937_64 rng(20180805);
+
+    Literals lits = makeLiterals(count, rng);
+    std::vector<double> reference(count);
+    for (size_t i = 0; i < count; ++i)
+        reference[i] = parseStrtod(&lits.text[lits.start[i]], lits.length[i]);
+
+    // The stream path is far slower; time it on a slice so runs stay short.
+    Literals slice = lits;
+    size_t sliceCount = count < 200000 ? count : 200000;
+    slice.start.resize(sliceCount);
+    slice.length.resize(sliceCount);
+
+    printf("%zu literals, %zu bytes\n", count, lits.text.size());
+    runParse("stream", parseStream, slice, reference);
+    runParse("strtod", parseStrtod, lits, reference);
+    runParse("calc", parseNew, lits, reference);
+
+    std::vector<double> values(count);
+    std::uniform_int_distribution<size_t> pick(0, count - 1);
+    for (size_t i = 0; i < count; ++i)
+        values[i] = (i & 1) ? reference[i] : reference[i] / reference[pick(rng)];
+
+    std::vector<double> valueSlice(values.begin(), values.begin() + sliceCount);
+    runFormat("stream", formatStream, valueSlice);
+    runFormat("printf", formatPrintf, values);
+    runFormat("%.17g", formatPrintf17, values);
+    runFormat("calc", formatNew, values);
+    return 0;
+}
@@ -0,0 +1,199 @@
+//
+// Compares calc_trig's degree functions with libm.
+//
+// "libm" converts with an accurate pi / 180 and calls sin/cos/tan, "legacy"
+// is the evaluator's old conversion with PI = 3.14159265. Accuracy is
+// measured in ulps against a long double reference whose argument reduction
+// is exact, over three input sets: random reals in [-720, 720], random whole
+// degrees, and multiples of 30 and 45 degrees, where the table values should
+// make every result correctly rounded. Zeros and poles are left out of the
+// ulp figures and counted as misses when the result is not exactly 0 or inf.
+// Throughput is over the random reals.
+//
+// Usage: calc_trig_bench [count]
+//
+#include "bench_util.h"
+#include "calc_trig.h"
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace {
+
+    enum Fn { FN_SIN, FN_COS, FN_TAN };
+    const char* const kFnNames[] = { "sin", "cos", "tan" };
+
+    // Reduces to a quadrant and a remainder of at most 45 degrees in long
+    // double, where both steps are exact for double inputs.
+    long double reference(Fn fn, double x)
+    {
+        long double r = fmodl((long double) x, 360.0L);
+        long double q = nearbyintl(r / 90.0L);
+        r -= q * 90.0L;
+        int quadrant = ((int) q) & 3;
+        long double a = r * (3.14159265358979323846264338327950288L / 180.0L);
+        long double s = r == 0 ? 0.0L : sinl(a);
+        long double c = r == 0 ? 1.0L : cosl(a);
+        long double sinQ[4] = { s, c, -s, -c };
+        long double cosQ[4] = { c, -s, -c, s };
+        if (fn == FN_SIN)
+            return sinQ[quadrant];
+        if (fn == FN_COS)
+            return cosQ[quadrant];
+        return sinQ[quadrant] / cosQ[quadrant];
+    }
+
+    // Error of v in units of the last place of the correctly rounded result;
+    // exact is finite and nonzero.
+    double ulpError(double v, long double exact)
+    {
+        double rounded = (double) exact;
+        int e;
+        frexp(rounded, &e);
+        if (e < -1021)
+            e = -1021;
+        return (double) (fabsl((long double) v - exact) / ldexp(1.0, e - 53));
+    }
+
+    void libmColumn(Fn fn, double* a, size_t n)
+    {
+        const double k = M_PI / 180.0;
+        for (size_t i = 0; i < n; ++i)
+            a[i] = fn == FN_SIN ? sin(a[i] * k) : fn == FN_COS ? cos(a[i] * k) : tan(a[i] * k);
+    }
+
+    void legacyColumn(Fn fn, double* a, size_t n)
+    {
+        const double pi = 3.14159265;
+        for (size_t i = 0; i < n; ++i)
+            a[i] = fn == FN_SIN ? sin(a[i] * pi / 180.0) : fn == FN_COS ? cos(a[i] * pi / 180.0) : tan(a[i] * pi / 180.0);
+    }
+
+    struct Contender {
+        char name[16];
+        const calc::TrigKernels* kernels;   // NULL for the libm variants
+        void (*column)(Fn, double*, size_t);
+    };
+
+    void apply(const Contender& c, Fn fn, double* a, size_t n)
+    {
+        if (!c.kernels) {
+            c.column(fn, a, n);
+            return;
+        }
+        switch (fn) {
+            case FN_SIN: c.kernels->sinDeg(a, n); break;
+            case FN_COS: c.kernels->cosDeg(a, n); break;
+            default:     c.kernels->tanDeg(a, n); break;
+        }
+    }
+
+    struct Accuracy {
+        double maxUlp;
+        double meanUlp;
+        size_t inexact;     // not the correctly rounded result
+        size_t misses;      // a zero or pole not hit exactly
+    };
+
+    Accuracy measure(const Contender& c, Fn fn, const std::vector<double>& in,
+                     const std::vector<long double>& exact, std::vector<double>& out)
+    {
+        out = in;
+        apply(c, fn, &out[0], out.size());
+        Accuracy acc = { 0.0, 0.0, 0, 0 };
+        size_t measured = 0;
+        for (size_t i = 0; i < in.size(); ++i) {
+            if (exact[i] == 0 || isinf(exact[i])) {
+                if (exact[i] == 0 ? out[i] != 0.0 : !isinf(out[i]))
+                    ++acc.misses;
+                continue;
+            }
+            ++measured;
+            double u = ulpError(out[i], exact[i]);
+            if (u > acc.maxUlp)
+                acc.maxUlp = u;
+            acc.meanUlp += u;
+            if (u > 0.5)
+                ++acc.inexact;
+        }
+        if (measured)
+            acc.meanUlp /= measured;
+        return acc;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? (size_t) strtoull(argv[1], NULL, 10) : 1000000;
+    std::mt19937_64 rng(20180805);
+
+    std::vector<double> reals(count), whole(count), multiples;
+    std::uniform_real_distribution<double> angle(-720.0, 720.0);
+    std::uniform_int_distribution<int> degree(-100000, 100000);
+    for (size_t i = 0; i < count; ++i) {
+        reals[i] = angle(rng);
+        whole[i] = degree(rng);
+    }
+    for (int d = -1440; d <= 1440; d += 15) {
+        if (d % 30 == 0 || d % 45 == 0)
+            multiples.push_back(d);
+    }
+
+    std::vector<Contender> contenders;
+    Contender libm = { "libm", NULL, libmColumn };
+    Contender legacy = { "legacy", NULL, legacyColumn };
+    contenders.push_back(libm);
+    contenders.push_back(legacy);
+    const calc::TrigKernels* sets[3];
+    size_t setCount = calc::allTrigKernels(sets, 3);
+    for (size_t i = 0; i < setCount; ++i) {
+        Contender c = { "", sets[i], NULL };
+        snprintf(c.name, sizeof(c.name), "calc-%s", sets[i]->name);
+        contenders.push_back(c);
+    }
+
+    const std::vector<double>* inputs[] = { &reals, &whole, &multiples };
+    const char* const inputNames[] = { "reals", "whole", "x30|45" };
+    std::vector<double> out;
+    std::vector<double> scratch(reals.size());
+
+    printf("%zu values per set; ulp error vs long double, inexact = not correctly rounded,\n"
+           "miss = a zero or pole that did not come out as exactly 0 or inf\n", count);
+    for (int f = FN_SIN; f <= FN_TAN; ++f) {
+        Fn fn = (Fn) f;
+        std::vector<long double> exact[3];
+        for (int s = 0; s < 3; ++s) {
+            exact[s].resize(inputs[s]->size());
+            for (size_t i = 0; i < inputs[s]->size(); ++i)
+                exact[s][i] = reference(fn, (*inputs[s])[i]);
+        }
+        for (size_t ci = 0; ci < contenders.size(); ++ci) {
+            const Contender& c = contenders[ci];
+            printf("%s %-12s", kFnNames[fn], c.name);
+            for (int s = 0; s < 3; ++s) {
+                Accuracy acc = measure(c, fn, *inputs[s], exact[s], out);
+                printf("  %s max %-8.3g mean %-8.3g inexact %-6zu miss %-6zu",
+                       inputNames[s], acc.maxUlp, acc.meanUlp, acc.inexact, acc.misses);
+            }
+
+            // Best of a few passes; the kernels work in place, so each pass
+            // starts from a fresh copy outside the timed region.
+            double best = 1e30;
+            for (int pass = 0; pass < 5; ++pass) {
+                std::copy(reals.begin(), reals.end(), scratch.begin());
+                bench::Timer timer;
+                apply(c, fn, &scratch[0], scratch.size());
+                double elapsed = timer.seconds();
+                bench::doNotOptimize(scratch[0]);
+                if (elapsed < best)
+                    best = elapsed;
+            }
+            printf("  %6.2f ns/value\n", best * 1e9 / count);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+//
+// Small helpers shared by the benchmark programs.
+//
+
+#ifndef IMGUI_ANDROID_BENCH_UTIL_H
+#define IMGUI_ANDROID_BENCH_UTIL_H
+
+#include <chrono>
+
+namespace bench {
+
+    class Timer {
+    public:
+        Timer() : start_(std::chrono::steady_clock::now()) {}
+
+        double seconds() const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Keeps the compiler from discarding a result that is otherwise unused.
+    template <typename T>
+    inline void doNotOptimize(const T& value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+}
+
+#endif //IMGUI_ANDROID_BENCH_UTIL_H
@@ -3031,6 +3031,21 @@ ImVec2 ImGui::CalcTextSize(const char* text, const char* text_end, bool hide_tex
     const float font_size = g.FontSize;
     if (text == text_display_end)
         return ImVec2(0.0f, font_size);
+
+    // Labels are measured every frame and rarely change: look the size up by a hash of the text, which is cheaper than walking the glyphs.
+    if (!text_display_end)
+        text_display_end = text + strlen(text);
+    const int text_len = (int)(text_display_end - text);
+    if (g.TextSizeCacheAtlasGeneration != g.IO.Fonts->BuildGeneration)
+    {
+        memset(g.TextSizeCache, 0, sizeof(g.TextSizeCache));
+        g.TextSizeCacheAtlasGeneration = g.IO.Fonts->BuildGeneration;
+    }
+    const ImU32 hash = ImHash(text, text_len, 0);
+    ImGuiTextSizeCacheEntry& entry = g.TextSizeCache[hash & (IMGUI_TEXT_SIZE_CACHE_SIZE - 1)];
+    if (entry.Hash == hash && entry.Length == text_len && entry.Font == font && entry.FontSize == font_size && entry.WrapWidth == wrap_width)
+        return entry.Size;
+
     ImVec2 text_size = font->CalcTextSizeA(font_size, FLT_MAX, wrap_width, text, text_display_end, NULL);
 
     // Cancel out character spacing for the last character of a line (it is baked into glyph->XAdvance field)
@@ -3040,6 +3055,12 @@ ImVec2 ImGui::CalcTextSize(const char* text, const char* text_end, bool hide_tex
         text_size.x -= character_spacing_x;
     text_size.x = (float)(int)(text_size.x + 0.95f);
 
+    entry.Hash = hash;
+    entry.Length = text_len;
+    entry.Font = font;
+    entry.FontSize = font_size;
+    entry.WrapWidth = wrap_width;
+    entry.Size = text_size;
     return text_size;
 }
 
@@ -1406,6 +1406,7 @@ struct ImFontAtlas
     int                         TexGlyphPadding;    // Padding between glyphs within texture in pixels. Defaults to 1.
     ImVec2                      TexUvWhitePixel;    // Texture coordinates to a white pixel
     ImVector<ImFont*>           Fonts;              // Hold all the fonts returned by AddFont*. Fonts[0] is the default font upon calling ImGui::NewFrame(), use ImGui::PushFont()/PopFont() to change the current font.
+    int                         BuildGeneration;    // Incremented whenever glyph metrics may have changed (Build(), ClearFonts()). Text size caches compare against it.
 
     // [Private] User rectangle for packing custom texture data into the atlas.
     struct CustomRect
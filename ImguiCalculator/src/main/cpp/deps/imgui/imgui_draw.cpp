@@ -1105,6 +1105,7 @@ ImFontAtlas::ImFontAtlas()
     TexWidth = TexHeight = TexDesiredWidth = 0;
     TexGlyphPadding = 1;
     TexUvWhitePixel = ImVec2(0, 0);
+    BuildGeneration = 0;
 }
 
 ImFontAtlas::~ImFontAtlas()
@@ -1150,6 +1151,7 @@ void    ImFontAtlas::ClearFonts()
         ImGui::MemFree(Fonts[i]);
     }
     Fonts.clear();
+    BuildGeneration++;
 }
 
 void    ImFontAtlas::Clear()
@@ -1339,6 +1341,7 @@ void ImFontAtlas::CustomRectCalcUV(const CustomRect* rect, ImVec2* out_uv_min, I
 
 bool    ImFontAtlas::Build()
 {
+    BuildGeneration++;
     return ImFontAtlasBuildWithStbTruetype(this);
 }
 
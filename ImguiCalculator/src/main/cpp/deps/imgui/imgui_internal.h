@@ -390,6 +390,19 @@ struct ImGuiPopupRef
     ImGuiPopupRef(ImGuiID id, ImGuiWindow* parent_window, ImGuiID parent_menu_set, const ImVec2& mouse_pos) { PopupId = id; Window = NULL; ParentWindow = parent_window; ParentMenuSet = parent_menu_set; MousePosOnOpen = mouse_pos; }
 };
 
+// Memoized CalcTextSize() result. Keyed by a hash of the displayed text plus everything else the size depends on.
+struct ImGuiTextSizeCacheEntry
+{
+    ImU32           Hash;           // ImHash() of the text
+    int             Length;         // 0 for an empty slot; empty text is never cached
+    ImFont*         Font;
+    float           FontSize;
+    float           WrapWidth;
+    ImVec2          Size;
+};
+
+#define IMGUI_TEXT_SIZE_CACHE_SIZE  512     // Direct-mapped slots; must be a power of two
+
 // Main state for ImGui
 struct ImGuiContext
 {
@@ -489,6 +502,10 @@ struct ImGuiContext
     int                     CaptureKeyboardNextFrame;
     char                    TempBuffer[1024*3+1];               // temporary text buffer
 
+    // Text measurement
+    ImGuiTextSizeCacheEntry TextSizeCache[IMGUI_TEXT_SIZE_CACHE_SIZE]; // CalcTextSize() results; a new entry replaces whatever shared its slot
+    int                     TextSizeCacheAtlasGeneration;       // IO.Fonts->BuildGeneration the cache was filled under; any rebuild empties it
+
     ImGuiContext()
     {
         Initialized = false;
@@ -559,6 +576,9 @@ struct ImGuiContext
         FramerateSecPerFrameAccum = 0.0f;
         CaptureMouseNextFrame = CaptureKeyboardNextFrame = -1;
         memset(TempBuffer, 0, sizeof(TempBuffer));
+
+        memset(TextSizeCache, 0, sizeof(TextSizeCache));
+        TextSizeCacheAtlasGeneration = -1;
     }
 };
 
@@ -0,0 +1,122 @@
+//
+// Evaluation off the UI thread.
+//
+#include "calc_async.h"
+
+namespace calc {
+
+    // What the stop hook needs to know about the job in progress.
+    struct EvaluationWorker::Running {
+        const EvaluationWorker* worker;
+        uint64_t id;
+        Clock::time_point deadline;
+        bool timedOut;
+    };
+
+    EvaluationWorker::EvaluationWorker(Notify notify, void* context)
+            : cancelUpTo_(0), submitted_(0), polled_(0), notify_(notify), context_(context),
+              stopping_(false)
+    {
+        thread_ = std::thread(&EvaluationWorker::workerMain, this);
+    }
+
+    EvaluationWorker::~EvaluationWorker()
+    {
+        cancelUpTo_.store(UINT64_MAX, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    uint64_t EvaluationWorker::submit(const std::string& expr, CalcMode mode, uint32_t deadlineMs)
+    {
+        // Results are only ever queued for polled-for jobs, so capping what
+        // is outstanding also keeps the worker from finding results_ full.
+        if (submitted_ - polled_ >= kMaxPending)
+            return 0;
+
+        Job job;
+        job.id = submitted_ + 1;
+        job.mode = mode;
+        job.deadline = Clock::now() + std::chrono::milliseconds(deadlineMs);
+        job.expr = expr;
+        cancel(job.id - 1);
+        if (!jobs_.push(job))
+            return 0;
+        ++submitted_;
+
+        // Taking the lock orders the push before the worker's last look at
+        // the queue, so it is either awake already or gets this notify.
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        wake_.notify_one();
+        return submitted_;
+    }
+
+    void EvaluationWorker::cancel(uint64_t id)
+    {
+        uint64_t cur = cancelUpTo_.load(std::memory_order_relaxed);
+        while (cur < id && !cancelUpTo_.compare_exchange_weak(cur, id, std::memory_order_relaxed)) {
+        }
+    }
+
+    bool EvaluationWorker::poll(Result& result)
+    {
+        if (!results_.pop(result))
+            return false;
+        ++polled_;
+        return true;
+    }
+
+    void EvaluationWorker::workerMain()
+    {
+        Job job;
+        Result result;
+        for (;;) {
+            if (!jobs_.pop(job)) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+                if (stopping_)
+                    return;
+                continue;
+            }
+            result.id = job.id;
+            result.text.clear();
+            result.status = evaluate(job, result.text);
+            results_.push(result);
+            if (notify_)
+                notify_(context_);
+        }
+    }
+
+    EvaluationWorker::Status EvaluationWorker::evaluate(Job& job, std::string& text)
+    {
+        Running running = { this, job.id, job.deadline, false };
+        if (shouldStop(&running))
+            return running.timedOut ? EVAL_TIMED_OUT : EVAL_CANCELLED;
+        std::string value = calculator::calToString(job.expr, job.mode, shouldStop, &running);
+        // A stopped evaluation returns whatever it had; only the check
+        // afterwards says whether that is the answer.
+        if (shouldStop(&running))
+            return running.timedOut ? EVAL_TIMED_OUT : EVAL_CANCELLED;
+        text.swap(value);
+        return EVAL_DONE;
+    }
+
+    bool EvaluationWorker::shouldStop(void* p)
+    {
+        Running& running = *static_cast<Running*>(p);
+        if (running.worker->cancelUpTo_.load(std::memory_order_relaxed) >= running.id)
+            return true;
+        if (Clock::now() >= running.deadline) {
+            running.timedOut = true;
+            return true;
+        }
+        return false;
+    }
+
+}
@@ -0,0 +1,110 @@
+//
+// Evaluation off the UI thread.
+//
+// An EvaluationWorker owns one thread that takes expressions from a
+// lock-free single-producer queue, evaluates them with calToString and hands
+// the text back through a second queue. The thread that submits must be the
+// thread that polls, and only that one. A new submission supersedes every
+// earlier one, so a job still queued behind it is dropped and a job already
+// running is abandoned at its next instruction. A job also gives up once its
+// deadline, counted from submission, passes. Double evaluation cannot be
+// interrupted, but it is linear in the expression and never the slow case;
+// its result is still discarded if it arrives late.
+//
+// Every job produces exactly one Result. The optional notify callback runs
+// on the worker thread after each one is queued, so an event loop that
+// sleeps can be woken to poll.
+//
+
+#ifndef IMGUI_ANDROID_CALC_ASYNC_H
+#define IMGUI_ANDROID_CALC_ASYNC_H
+
+#include "calc_spsc.h"
+#include "calculator.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace calc {
+
+    class EvaluationWorker {
+    public:
+        enum Status {
+            EVAL_DONE,
+            EVAL_CANCELLED,
+            EVAL_TIMED_OUT
+        };
+
+        struct Result {
+            uint64_t id;
+            Status status;
+            std::string text;   // empty unless status is EVAL_DONE
+        };
+
+        typedef void (*Notify)(void* context);
+
+        // Jobs submitted and not yet polled; submit fails beyond this.
+        static const size_t kMaxPending = 64;
+
+        explicit EvaluationWorker(Notify notify = NULL, void* context = NULL);
+        // Abandons whatever is running and joins the thread.
+        ~EvaluationWorker();
+
+        // Queues expr for evaluation and returns its id, which is never 0.
+        // Returns 0, queuing nothing, if kMaxPending results are still
+        // waiting to be polled.
+        uint64_t submit(const std::string& expr, CalcMode mode, uint32_t deadlineMs);
+
+        // Cancels job id and every job submitted before it.
+        void cancel(uint64_t id);
+
+        // Takes the next finished job's result, in submission order. False
+        // if none is ready.
+        bool poll(Result& result);
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Job {
+            uint64_t id;
+            CalcMode mode;
+            Clock::time_point deadline;
+            std::string expr;
+        };
+
+        struct Running;
+
+        EvaluationWorker(const EvaluationWorker&);
+        EvaluationWorker& operator=(const EvaluationWorker&);
+
+        void workerMain();
+        Status evaluate(Job& job, std::string& text);
+        static bool shouldStop(void* running);
+
+        SpscQueue<Job, kMaxPending> jobs_;
+        SpscQueue<Result, kMaxPending> results_;
+
+        // Every id up to this one is cancelled.
+        std::atomic<uint64_t> cancelUpTo_;
+        // UI side only.
+        uint64_t submitted_;
+        uint64_t polled_;
+
+        Notify notify_;
+        void* context_;
+
+        // Only for sleeping while there is no work; jobs go through jobs_.
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        bool stopping_;
+
+        std::thread thread_;
+    };
+
+}
+
+#endif //IMGUI_ANDROID_CALC_ASYNC_H
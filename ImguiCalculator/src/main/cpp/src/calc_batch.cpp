@@ -0,0 +1,233 @@
+//
+// Batch evaluation of many calculator expressions across all cores.
+//
+#include "calc_batch.h"
+#include "calc_program.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace calc {
+
+    namespace {
+
+        // Expressions a worker claims from its own range at a time.
+        const uint32_t kGrain = 64;
+        // Ranges are packed into one 64-bit word, so a single job is capped.
+        const size_t kMaxJob = 0x7fffffffu;
+
+        inline uint64_t pack(uint32_t begin, uint32_t end) { return ((uint64_t) end << 32) | begin; }
+        inline uint32_t lo(uint64_t r) { return (uint32_t) r; }
+        inline uint32_t hi(uint64_t r) { return (uint32_t) (r >> 32); }
+
+        // A half-open [begin, end) slice of the job. The owner takes chunks off
+        // the front, thieves take the back half; both sides use CAS on the
+        // packed pair, so nobody ever blocks on another worker. Padded to a
+        // cache line so neighbouring workers do not false-share.
+        struct Range {
+            std::atomic<uint64_t> bounds;
+            char pad[64 - sizeof(std::atomic<uint64_t>)];
+        };
+
+        class BatchPool {
+        public:
+            static BatchPool& instance()
+            {
+                static BatchPool pool;
+                return pool;
+            }
+
+            unsigned concurrency() const { return (unsigned) workers_.size() + 1; }
+
+            void run(const void* exprs, ExprAccessor at, size_t count, double* out)
+            {
+                std::lock_guard<std::mutex> serial(jobLock_);
+                for (size_t base = 0; base < count; base += kMaxJob) {
+                    size_t n = std::min(count - base, kMaxJob);
+                    runJob(exprs, at, base, (uint32_t) n, out);
+                }
+            }
+
+            ~BatchPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stop_ = true;
+                }
+                wake_.notify_all();
+                for (size_t i = 0; i < workers_.size(); ++i)
+                    workers_[i].join();
+                delete[] ranges_;
+            }
+
+        private:
+            BatchPool() : ranges_(NULL), exprs_(NULL), at_(NULL), base_(0), out_(NULL),
+                          generation_(0), busy_(0), stop_(false)
+            {
+                unsigned n = std::thread::hardware_concurrency();
+                if (n == 0)
+                    n = 1;
+                ranges_ = new Range[n];
+                for (unsigned i = 1; i < n; ++i)
+                    workers_.push_back(std::thread(&BatchPool::workerMain, this, i));
+            }
+
+            void runJob(const void* exprs, ExprAccessor at, size_t base, uint32_t count, double* out)
+            {
+                unsigned n = concurrency();
+                // Small jobs are not worth waking anybody for.
+                if (n == 1 || count <= kGrain) {
+                    Program program;
+                    for (uint32_t i = 0; i < count; ++i)
+                        out[base + i] = evaluateOne(program, exprs, at, base + i);
+                    return;
+                }
+
+                for (unsigned i = 0; i < n; ++i) {
+                    uint32_t b = (uint32_t) ((uint64_t) count * i / n);
+                    uint32_t e = (uint32_t) ((uint64_t) count * (i + 1) / n);
+                    ranges_[i].bounds.store(pack(b, e), std::memory_order_relaxed);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    exprs_ = exprs;
+                    at_ = at;
+                    base_ = base;
+                    out_ = out;
+                    busy_ = n - 1;
+                    ++generation_;
+                }
+                wake_.notify_all();
+
+                work(0);
+
+                std::unique_lock<std::mutex> lock(mutex_);
+                done_.wait(lock, [this] { return busy_ == 0; });
+            }
+
+            void workerMain(unsigned self)
+            {
+                uint64_t seen = 0;
+                for (;;) {
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                        if (stop_)
+                            return;
+                        seen = generation_;
+                    }
+                    work(self);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        --busy_;
+                    }
+                    done_.notify_one();
+                }
+            }
+
+            static double evaluateOne(Program& program, const void* exprs, ExprAccessor at, size_t i)
+            {
+                const char* s;
+                size_t len;
+                at(exprs, i, &s, &len);
+                program.compile(s, len);
+                return program.run();
+            }
+
+            bool takeOwn(unsigned self, uint32_t& b, uint32_t& e)
+            {
+                std::atomic<uint64_t>& r = ranges_[self].bounds;
+                uint64_t cur = r.load(std::memory_order_acquire);
+                for (;;) {
+                    b = lo(cur);
+                    uint32_t end = hi(cur);
+                    if (b >= end)
+                        return false;
+                    e = std::min(end, b + kGrain);
+                    if (r.compare_exchange_weak(cur, pack(e, end), std::memory_order_acq_rel))
+                        return true;
+                }
+            }
+
+            bool steal(unsigned self)
+            {
+                unsigned n = concurrency();
+                for (unsigned k = 1; k < n; ++k) {
+                    std::atomic<uint64_t>& victim = ranges_[(self + k) % n].bounds;
+                    uint64_t cur = victim.load(std::memory_order_acquire);
+                    for (;;) {
+                        uint32_t b = lo(cur), e = hi(cur);
+                        if (b >= e)
+                            break;
+                        uint32_t mid = b + (e - b) / 2;
+                        if (victim.compare_exchange_weak(cur, pack(b, mid), std::memory_order_acq_rel)) {
+                            // Our own range is empty, and thieves skip empty
+                            // ranges, so a plain store hands the loot to us.
+                            ranges_[self].bounds.store(pack(mid, e), std::memory_order_release);
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            void work(unsigned self)
+            {
+                // One program per participant; its buffers grow to the longest
+                // expression once and are reused for the rest of the job.
+                Program program;
+                uint32_t b, e;
+                do {
+                    while (takeOwn(self, b, e)) {
+                        for (uint32_t i = b; i < e; ++i)
+                            out_[base_ + i] = evaluateOne(program, exprs_, at_, base_ + i);
+                    }
+                } while (steal(self));
+            }
+
+            std::vector<std::thread> workers_;
+            Range* ranges_;
+
+            const void* exprs_;
+            ExprAccessor at_;
+            size_t base_;
+            double* out_;
+
+            std::mutex jobLock_;
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            std::condition_variable done_;
+            uint64_t generation_;
+            unsigned busy_;
+            bool stop_;
+        };
+
+        void refAt(const void* exprs, size_t i, const char** str, size_t* len)
+        {
+            const ExprRef& r = static_cast<const ExprRef*>(exprs)[i];
+            *str = r.str;
+            *len = r.len;
+        }
+
+    }
+
+    void evaluateBatch(const void* exprs, ExprAccessor at, size_t count, double* out)
+    {
+        BatchPool::instance().run(exprs, at, count, out);
+    }
+
+    void evaluateBatch(const ExprRef* exprs, size_t count, double* out)
+    {
+        evaluateBatch(exprs, refAt, count, out);
+    }
+
+    unsigned batchConcurrency()
+    {
+        return BatchPool::instance().concurrency();
+    }
+
+}
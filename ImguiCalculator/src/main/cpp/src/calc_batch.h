@@ -0,0 +1,35 @@
+//
+// Batch evaluation of many calculator expressions across all cores.
+//
+
+#ifndef IMGUI_ANDROID_CALC_BATCH_H
+#define IMGUI_ANDROID_CALC_BATCH_H
+
+#include <cstddef>
+
+namespace calc {
+
+    // A borrowed expression: len bytes starting at str, no terminator needed.
+    struct ExprRef {
+        const char* str;
+        size_t len;
+    };
+
+    // Hands out the i-th expression of a caller-owned container, so batches
+    // of std::string or ExprRef can be scored without building an index array.
+    typedef void (*ExprAccessor)(const void* exprs, size_t i, const char** str, size_t* len);
+
+    // Evaluates count expressions into out[0..count). Work is split over a
+    // process-wide pool of worker threads that steal ranges from each other;
+    // every out[i] depends only on expression i, so results are identical to
+    // calling calEverything on each one in order. Nothing is logged.
+    void evaluateBatch(const void* exprs, ExprAccessor at, size_t count, double* out);
+
+    void evaluateBatch(const ExprRef* exprs, size_t count, double* out);
+
+    // Number of threads (including the caller) a batch is spread over.
+    unsigned batchConcurrency();
+
+}
+
+#endif //IMGUI_ANDROID_CALC_BATCH_H
@@ -0,0 +1,151 @@
+//
+// Bounded memo of evaluated expressions.
+//
+#include "calc_cache.h"
+#include "calc_program.h"
+#include <cstring>
+
+namespace calc {
+
+    namespace {
+
+        inline uint64_t fnv1a(uint64_t h, const void* data, size_t n)
+        {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < n; ++i) {
+                h ^= p[i];
+                h *= 0x100000001b3ULL;
+            }
+            return h;
+        }
+
+        // splitmix64 finalizer, so the low bits used for bucketing are well mixed.
+        inline uint64_t finalize(uint64_t h)
+        {
+            h ^= h >> 30;
+            h *= 0xbf58476d1ce4e5b9ULL;
+            h ^= h >> 27;
+            h *= 0x94d049bb133111ebULL;
+            h ^= h >> 31;
+            return h;
+        }
+
+    }
+
+    ResultCache::ResultCache(size_t capacity)
+            : slots_(capacity ? capacity : 1), mask_(0), hand_(0), size_(0),
+              hits_(0), misses_(0), evictions_(0)
+    {
+        size_t buckets = 1;
+        while (buckets < slots_.size() * 2)
+            buckets <<= 1;
+        buckets_.assign(buckets, 0);
+        mask_ = buckets - 1;
+        clear();
+    }
+
+    uint64_t ResultCache::keyOf(const Program& program)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        const std::vector<Instr>& code = program.code();
+        for (size_t i = 0; i < code.size(); ++i) {
+            const Instr& in = code[i];
+            unsigned char head[2] = { (unsigned char) in.op, in.arg };
+            h = fnv1a(h, head, sizeof(head));
+            if (in.op == OP_CONST)
+                h = fnv1a(h, &in.value, sizeof(in.value));
+        }
+        return finalize(h ^ code.size());
+    }
+
+    size_t ResultCache::findBucket(uint64_t key) const
+    {
+        size_t i = (size_t) key & mask_;
+        while (buckets_[i] && slots_[buckets_[i] - 1].key != key)
+            i = (i + 1) & mask_;
+        return i;
+    }
+
+    void ResultCache::eraseBucket(size_t hole)
+    {
+        // Backward-shift deletion keeps linear probing free of tombstones.
+        buckets_[hole] = 0;
+        for (size_t j = (hole + 1) & mask_; buckets_[j]; j = (j + 1) & mask_) {
+            size_t home = (size_t) slots_[buckets_[j] - 1].key & mask_;
+            bool stays = hole <= j ? (hole < home && home <= j) : (hole < home || home <= j);
+            if (stays)
+                continue;
+            buckets_[hole] = buckets_[j];
+            buckets_[j] = 0;
+            hole = j;
+        }
+    }
+
+    size_t ResultCache::evict()
+    {
+        for (;;) {
+            size_t s = hand_;
+            hand_ = (hand_ + 1) % slots_.size();
+            Slot& slot = slots_[s];
+            if (slot.referenced) {
+                slot.referenced = false;
+                continue;
+            }
+            eraseBucket(findBucket(slot.key));
+            --size_;
+            ++evictions_;
+            return s;
+        }
+    }
+
+    bool ResultCache::lookup(uint64_t key, CachedResult& out)
+    {
+        size_t b = buckets_[findBucket(key)];
+        if (!b) {
+            ++misses_;
+            return false;
+        }
+        ++hits_;
+        Slot& slot = slots_[b - 1];
+        slot.referenced = true;
+        out = slot.result;
+        return true;
+    }
+
+    void ResultCache::insert(uint64_t key, const CachedResult& result)
+    {
+        size_t bucket = findBucket(key);
+        if (buckets_[bucket]) {
+            Slot& slot = slots_[buckets_[bucket] - 1];
+            slot.result = result;
+            slot.referenced = true;
+            return;
+        }
+
+        // Free slots are always the tail [size_, capacity): evicting frees a
+        // slot that is refilled straight away.
+        size_t s;
+        if (size_ < slots_.size()) {
+            s = size_;
+        } else {
+            s = evict();
+            bucket = findBucket(key);
+        }
+        Slot& slot = slots_[s];
+        slot.key = key;
+        slot.result = result;
+        slot.referenced = false;
+        buckets_[bucket] = (uint32_t) (s + 1);
+        ++size_;
+    }
+
+    void ResultCache::clear()
+    {
+        std::memset(&buckets_[0], 0, buckets_.size() * sizeof(buckets_[0]));
+        for (size_t i = 0; i < slots_.size(); ++i)
+            slots_[i].referenced = false;
+        hand_ = 0;
+        size_ = 0;
+    }
+
+}
@@ -0,0 +1,78 @@
+//
+// Bounded memo of evaluated expressions.
+//
+// Entries are keyed by a hash of the compiled program rather than the input
+// text, so "1+2", "1 + 2" and "01+2.0" share one slot. Replacement uses the
+// CLOCK approximation of LRU: a hit only sets a reference bit, and eviction
+// sweeps a hand over the slots giving referenced entries a second chance.
+// All storage is allocated up front; lookups and inserts never allocate.
+//
+
+#ifndef IMGUI_ANDROID_CALC_CACHE_H
+#define IMGUI_ANDROID_CALC_CACHE_H
+
+#include "calc_number.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace calc {
+
+    class Program;
+
+    struct CachedResult {
+        double value;
+        char text[kFormatBufferSize];  // formatShortest of value
+    };
+
+    // Not thread-safe; callers sharing a cache between threads must lock.
+    class ResultCache {
+    public:
+        explicit ResultCache(size_t capacity = 256);
+
+        // Hash of the canonical token stream of a compiled program: opcodes,
+        // variable indices and literal values, ignoring source positions,
+        // whitespace and how the literals were spelled.
+        static uint64_t keyOf(const Program& program);
+
+        // Copies the entry for key into out and marks it recently used.
+        bool lookup(uint64_t key, CachedResult& out);
+
+        // Stores or replaces the entry for key, evicting if full.
+        void insert(uint64_t key, const CachedResult& result);
+
+        void clear();
+
+        size_t size() const { return size_; }
+        size_t capacity() const { return slots_.size(); }
+        uint64_t hits() const { return hits_; }
+        uint64_t misses() const { return misses_; }
+        uint64_t evictions() const { return evictions_; }
+        void resetStats() { hits_ = misses_ = evictions_ = 0; }
+
+    private:
+        struct Slot {
+            uint64_t key;
+            CachedResult result;
+            bool referenced;
+        };
+
+        // Open-addressed key -> slot map; 0 marks an empty bucket, otherwise
+        // the bucket holds slot index + 1.
+        size_t findBucket(uint64_t key) const;
+        void eraseBucket(size_t bucket);
+        size_t evict();
+
+        std::vector<Slot> slots_;
+        std::vector<uint32_t> buckets_;
+        size_t mask_;
+        size_t hand_;
+        size_t size_;
+        uint64_t hits_;
+        uint64_t misses_;
+        uint64_t evictions_;
+    };
+
+}
+
+#endif //IMGUI_ANDROID_CALC_CACHE_H
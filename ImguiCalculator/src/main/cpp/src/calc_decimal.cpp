@@ -0,0 +1,898 @@
+//
+// Exact decimal arithmetic for the calculator's decimal mode.
+//
+#include "calc_decimal.h"
+#include "calc_number.h"
+#include "calc_program.h"
+#include <algorithm>
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+namespace calc {
+
+    namespace {
+
+        const uint32_t kPow10[] = {
+            1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+        };
+
+        const uint64_t kPow10Wide[] = {
+            1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+            100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+            10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+            100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+        };
+
+        int digitsIn(uint32_t limb)
+        {
+            int n = 1;
+            while (n < Natural::kBaseDigits && limb >= kPow10[n])
+                ++n;
+            return n;
+        }
+
+        // c * 10^k without overflow, or false.
+        bool scaleSmall(uint64_t& c, int32_t k)
+        {
+            if (k == 0)
+                return true;
+            if (k >= 20)
+                return c == 0;
+            return !__builtin_mul_overflow(c, kPow10Wide[k], &c);
+        }
+
+        // ---- Limb-array multiplication --------------------------------
+
+        // out[0..an+bn) must be zero.
+        void mulSchool(const uint32_t* a, size_t an, const uint32_t* b, size_t bn, uint32_t* out)
+        {
+            for (size_t i = 0; i < an; ++i) {
+                uint64_t ai = a[i];
+                if (!ai)
+                    continue;
+                uint64_t carry = 0;
+                for (size_t j = 0; j < bn; ++j) {
+                    uint64_t t = ai * b[j] + out[i + j] + carry;
+                    out[i + j] = (uint32_t) (t % Natural::kBase);
+                    carry = t / Natural::kBase;
+                }
+                out[i + bn] = (uint32_t) carry;
+            }
+        }
+
+        // out[off..) += x, carrying as far as needed within outN limbs.
+        void addAt(uint32_t* out, size_t outN, size_t off, const uint32_t* x, size_t xn)
+        {
+            uint32_t carry = 0;
+            size_t i = off;
+            for (size_t j = 0; j < xn; ++j, ++i) {
+                uint32_t s = out[i] + x[j] + carry;
+                carry = s >= Natural::kBase;
+                out[i] = carry ? s - Natural::kBase : s;
+            }
+            for (; carry && i < outN; ++i) {
+                uint32_t s = out[i] + 1;
+                carry = s == Natural::kBase;
+                out[i] = carry ? 0 : s;
+            }
+        }
+
+        // x -= y; x >= y.
+        void subFrom(uint32_t* x, size_t xn, const uint32_t* y, size_t yn)
+        {
+            uint32_t borrow = 0;
+            size_t i = 0;
+            for (; i < yn; ++i) {
+                uint32_t sub = y[i] + borrow;
+                borrow = x[i] < sub;
+                x[i] = borrow ? x[i] + Natural::kBase - sub : x[i] - sub;
+            }
+            for (; borrow && i < xn; ++i) {
+                borrow = x[i] == 0;
+                x[i] = borrow ? Natural::kBase - 1 : x[i] - 1;
+            }
+        }
+
+        size_t trimmed(const uint32_t* x, size_t n)
+        {
+            while (n > 0 && x[n - 1] == 0)
+                --n;
+            return n;
+        }
+
+        // out[0..an+bn) must be zero. Splits the longer operand in half, so
+        // three half-size products replace four.
+        void mulKaratsuba(const uint32_t* a, size_t an, const uint32_t* b, size_t bn, uint32_t* out)
+        {
+            if (an < bn) {
+                std::swap(a, b);
+                std::swap(an, bn);
+            }
+            if (bn < Natural::kKaratsubaLimbs) {
+                mulSchool(a, an, b, bn, out);
+                return;
+            }
+            if (2 * bn <= an) {
+                // Lopsided: multiply b by bn-limb slices of a.
+                std::vector<uint32_t> part(2 * bn);
+                for (size_t off = 0; off < an; off += bn) {
+                    size_t len = std::min(bn, an - off);
+                    std::fill(part.begin(), part.end(), 0);
+                    mulKaratsuba(a + off, len, b, bn, &part[0]);
+                    addAt(out, an + bn, off, &part[0], trimmed(&part[0], len + bn));
+                }
+                return;
+            }
+
+            const size_t m = an / 2;
+            const uint32_t* a1 = a + m;
+            const uint32_t* b1 = b + m;
+            const size_t a1n = an - m;
+            const size_t b1n = bn - m;
+
+            std::vector<uint32_t> z0(2 * m), z2(a1n + b1n);
+            mulKaratsuba(a, m, b, m, &z0[0]);
+            mulKaratsuba(a1, a1n, b1, b1n, &z2[0]);
+
+            // (a0 + a1)(b0 + b1) - z0 - z2 is the middle term.
+            std::vector<uint32_t> sa(a1n + 1), sb(std::max(m, b1n) + 1);
+            std::copy(a1, a1 + a1n, sa.begin());
+            addAt(&sa[0], sa.size(), 0, a, m);
+            std::copy(b, b + m, sb.begin());
+            addAt(&sb[0], sb.size(), 0, b1, b1n);
+            size_t san = trimmed(&sa[0], sa.size());
+            size_t sbn = trimmed(&sb[0], sb.size());
+            std::vector<uint32_t> z1(san + sbn + 1);
+            if (san && sbn)
+                mulKaratsuba(&sa[0], san, &sb[0], sbn, &z1[0]);
+            // z1 is sized by the trimmed sums, which can be shorter than z0
+            // or z2 when a low half has leading zero limbs; their values
+            // still fit, so only their significant limbs are subtracted.
+            subFrom(&z1[0], z1.size(), &z0[0], trimmed(&z0[0], z0.size()));
+            subFrom(&z1[0], z1.size(), &z2[0], trimmed(&z2[0], z2.size()));
+
+            std::copy(z0.begin(), z0.end(), out);
+            std::copy(z2.begin(), z2.end(), out + 2 * m);
+            addAt(out, an + bn, m, &z1[0], trimmed(&z1[0], z1.size()));
+        }
+
+    }
+
+    // ---- Natural ---------------------------------------------------------
+
+    Natural::Natural(uint64_t v) : limbs_(inline_), size_(0), capacity_(kInlineLimbs)
+    {
+        assign(v);
+    }
+
+    Natural::Natural(const Natural& other) : limbs_(inline_), size_(0), capacity_(kInlineLimbs)
+    {
+        *this = other;
+    }
+
+    Natural::Natural(Natural&& other) : limbs_(inline_), size_(0), capacity_(kInlineLimbs)
+    {
+        *this = std::move(other);
+    }
+
+    Natural& Natural::operator=(const Natural& other)
+    {
+        if (this != &other) {
+            resize(other.size_);
+            std::copy(other.limbs_, other.limbs_ + other.size_, limbs_);
+        }
+        return *this;
+    }
+
+    Natural& Natural::operator=(Natural&& other)
+    {
+        if (this == &other)
+            return *this;
+        if (other.onHeap()) {
+            if (onHeap())
+                delete[] limbs_;
+            limbs_ = other.limbs_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.limbs_ = other.inline_;
+            other.size_ = 0;
+            other.capacity_ = kInlineLimbs;
+        } else {
+            *this = static_cast<const Natural&>(other);
+        }
+        return *this;
+    }
+
+    Natural::~Natural()
+    {
+        if (onHeap())
+            delete[] limbs_;
+    }
+
+    void Natural::reserve(uint32_t n)
+    {
+        if (n <= capacity_)
+            return;
+        uint32_t cap = std::max(n, capacity_ * 2);
+        uint32_t* grown = new uint32_t[cap];
+        std::copy(limbs_, limbs_ + size_, grown);
+        if (onHeap())
+            delete[] limbs_;
+        limbs_ = grown;
+        capacity_ = cap;
+    }
+
+    void Natural::resize(uint32_t n)
+    {
+        reserve(n);
+        if (n > size_)
+            std::fill(limbs_ + size_, limbs_ + n, 0);
+        size_ = n;
+    }
+
+    void Natural::trim()
+    {
+        while (size_ > 0 && limbs_[size_ - 1] == 0)
+            --size_;
+    }
+
+    bool Natural::toUint64(uint64_t& out) const
+    {
+        if (size_ > 3)
+            return false;
+        if (size_ == 3) {
+            // 18446744073709551615 is 18 446744073 709551615 in limbs.
+            if (limbs_[2] > 18)
+                return false;
+            uint64_t low = (uint64_t) limbs_[1] * kBase + limbs_[0];
+            uint64_t high = (uint64_t) limbs_[2] * 1000000000000000000ULL;
+            if (low > ~0ULL - high)
+                return false;
+            out = high + low;
+            return true;
+        }
+        out = size_ == 2 ? (uint64_t) limbs_[1] * kBase + limbs_[0] : size_ == 1 ? limbs_[0] : 0;
+        return true;
+    }
+
+    void Natural::assign(uint64_t v)
+    {
+        size_ = 0;
+        while (v) {
+            limbs_[size_++] = (uint32_t) (v % kBase);  // at most 3 limbs, always inline
+            v /= kBase;
+        }
+    }
+
+    size_t Natural::digitCount() const
+    {
+        if (!size_)
+            return 0;
+        return (size_t) (size_ - 1) * kBaseDigits + digitsIn(limbs_[size_ - 1]);
+    }
+
+    unsigned Natural::digit(size_t i) const
+    {
+        size_t limb = i / kBaseDigits;
+        if (limb >= size_)
+            return 0;
+        return limbs_[limb] / kPow10[i % kBaseDigits] % 10;
+    }
+
+    void Natural::mulSmall(uint32_t m, uint32_t add)
+    {
+        uint64_t carry = add;
+        for (uint32_t i = 0; i < size_; ++i) {
+            uint64_t t = (uint64_t) limbs_[i] * m + carry;
+            limbs_[i] = (uint32_t) (t % kBase);
+            carry = t / kBase;
+        }
+        while (carry) {
+            reserve(size_ + 1);
+            limbs_[size_++] = (uint32_t) (carry % kBase);
+            carry /= kBase;
+        }
+        trim();
+    }
+
+    uint32_t Natural::divSmall(uint32_t d)
+    {
+        uint64_t rem = 0;
+        for (uint32_t i = size_; i-- > 0;) {
+            uint64_t cur = rem * kBase + limbs_[i];
+            limbs_[i] = (uint32_t) (cur / d);
+            rem = cur % d;
+        }
+        trim();
+        return (uint32_t) rem;
+    }
+
+    void Natural::mulPow10(size_t k)
+    {
+        if (!size_ || !k)
+            return;
+        uint32_t shift = (uint32_t) (k / kBaseDigits);
+        if (shift) {
+            uint32_t n = size_;
+            resize(n + shift);
+            std::copy_backward(limbs_, limbs_ + n, limbs_ + n + shift);
+            std::fill(limbs_, limbs_ + shift, 0);
+        }
+        if (k % kBaseDigits)
+            mulSmall(kPow10[k % kBaseDigits]);
+    }
+
+    void Natural::divPow10(size_t k)
+    {
+        uint32_t shift = (uint32_t) (k / kBaseDigits);
+        if (shift >= size_) {
+            size_ = 0;
+            return;
+        }
+        if (shift) {
+            std::copy(limbs_ + shift, limbs_ + size_, limbs_);
+            size_ -= shift;
+        }
+        if (k % kBaseDigits)
+            divSmall(kPow10[k % kBaseDigits]);
+    }
+
+    int Natural::compare(const Natural& a, const Natural& b)
+    {
+        if (a.size_ != b.size_)
+            return a.size_ < b.size_ ? -1 : 1;
+        for (uint32_t i = a.size_; i-- > 0;) {
+            if (a.limbs_[i] != b.limbs_[i])
+                return a.limbs_[i] < b.limbs_[i] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    void Natural::add(const Natural& a, const Natural& b, Natural& out)
+    {
+        const Natural& longer = a.size_ >= b.size_ ? a : b;
+        const Natural& shorter = a.size_ >= b.size_ ? b : a;
+        Natural sum;
+        sum.resize(longer.size_ + 1);
+        std::copy(longer.limbs_, longer.limbs_ + longer.size_, sum.limbs_);
+        addAt(sum.limbs_, sum.size_, 0, shorter.limbs_, shorter.size_);
+        sum.trim();
+        out = std::move(sum);
+    }
+
+    void Natural::sub(const Natural& a, const Natural& b, Natural& out)
+    {
+        Natural diff(a);
+        subFrom(diff.limbs_, diff.size_, b.limbs_, b.size_);
+        diff.trim();
+        out = std::move(diff);
+    }
+
+    void Natural::mul(const Natural& a, const Natural& b, Natural& out)
+    {
+        if (a.isZero() || b.isZero()) {
+            out.size_ = 0;
+            return;
+        }
+        Natural product;
+        product.resize(a.size_ + b.size_);
+        mulKaratsuba(a.limbs_, a.size_, b.limbs_, b.size_, product.limbs_);
+        product.trim();
+        out = std::move(product);
+    }
+
+    void Natural::divMod(const Natural& a, const Natural& b, Natural& q, Natural& r)
+    {
+        if (compare(a, b) < 0) {
+            q.size_ = 0;
+            r = a;
+            return;
+        }
+        if (b.size_ == 1) {
+            q = a;
+            r.assign(q.divSmall(b.limbs_[0]));
+            return;
+        }
+
+        // Knuth's algorithm D. Scaling both sides so the divisor's top limb
+        // is at least half the base keeps each estimated quotient limb at
+        // most two too large.
+        const uint32_t scale = (uint32_t) (kBase / ((uint64_t) b.limbs_[b.size_ - 1] + 1));
+        Natural u(a), v(b);
+        u.mulSmall(scale);
+        v.mulSmall(scale);
+        u.resize(a.size_ + 1);
+        const uint32_t n = v.size_;
+        const uint32_t m = a.size_ - n;
+        const uint64_t vTop = v.limbs_[n - 1];
+        const uint64_t vNext = v.limbs_[n - 2];
+        q.resize(m + 1);
+
+        for (uint32_t j = m + 1; j-- > 0;) {
+            uint64_t num = (uint64_t) u.limbs_[j + n] * kBase + u.limbs_[j + n - 1];
+            uint64_t qhat = num / vTop;
+            uint64_t rhat = num % vTop;
+            while (qhat >= kBase || qhat * vNext > rhat * kBase + u.limbs_[j + n - 2]) {
+                --qhat;
+                rhat += vTop;
+                if (rhat >= kBase)
+                    break;
+            }
+
+            uint64_t carry = 0;
+            uint32_t borrow = 0;
+            for (uint32_t i = 0; i < n; ++i) {
+                uint64_t p = qhat * v.limbs_[i] + carry;
+                carry = p / kBase;
+                uint32_t sub = (uint32_t) (p % kBase) + borrow;
+                borrow = u.limbs_[i + j] < sub;
+                u.limbs_[i + j] = borrow ? u.limbs_[i + j] + kBase - sub : u.limbs_[i + j] - sub;
+            }
+            int64_t top = (int64_t) u.limbs_[j + n] - (int64_t) carry - borrow;
+            if (top < 0) {
+                // qhat was one too large: add the divisor back.
+                --qhat;
+                u.limbs_[j + n] = (uint32_t) (top + kBase);
+                addAt(u.limbs_, j + n + 1, j, v.limbs_, n);
+                u.limbs_[j + n] %= kBase;
+            } else {
+                u.limbs_[j + n] = (uint32_t) top;
+            }
+            q.limbs_[j] = (uint32_t) qhat;
+        }
+        q.trim();
+        u.trim();
+        u.divSmall(scale);
+        r = std::move(u);
+    }
+
+    // ---- Decimal ---------------------------------------------------------
+
+    void Decimal::setSmall(bool negative, uint64_t c, int32_t exponent)
+    {
+        coefficient_.assign(c);
+        exponent_ = exponent;
+        negative_ = negative && c != 0;
+        kind_ = FINITE;
+    }
+
+    void Decimal::normalize()
+    {
+        if (coefficient_.isZero()) {
+            exponent_ = 0;
+            negative_ = false;
+            return;
+        }
+        size_t zeros = 0;
+        while (coefficient_.digit(zeros) == 0)
+            ++zeros;
+        if (zeros) {
+            coefficient_.divPow10(zeros);
+            exponent_ += (int32_t) zeros;
+        }
+    }
+
+    Decimal Decimal::fromLiteral(const char* s, size_t n)
+    {
+        // Nine digits at a time, so each limb pass adds a whole limb.
+        Decimal d;
+        uint32_t chunk = 0;
+        int chunkDigits = 0;
+        bool dot = false;
+        for (size_t i = 0; i < n; ++i) {
+            char c = s[i];
+            if (c == '.') {
+                if (dot)
+                    break;
+                dot = true;
+                continue;
+            }
+            chunk = chunk * 10 + (uint32_t) (c - '0');
+            if (dot)
+                --d.exponent_;
+            if (++chunkDigits == Natural::kBaseDigits) {
+                d.coefficient_.mulSmall(Natural::kBase, chunk);
+                chunk = 0;
+                chunkDigits = 0;
+            }
+        }
+        if (chunkDigits)
+            d.coefficient_.mulSmall(kPow10[chunkDigits], chunk);
+        if (d.coefficient_.isZero())
+            d.exponent_ = 0;
+        return d;
+    }
+
+    Decimal Decimal::fromDouble(double v)
+    {
+        Decimal d;
+        if (v != v) {
+            d.kind_ = NOT_A_NUMBER;
+            return d;
+        }
+        if (isinf(v)) {
+            d.kind_ = INFINITE;
+            d.negative_ = v < 0;
+            return d;
+        }
+        char buf[kFormatBufferSize];
+        size_t n = formatShortest(v, buf);
+        const char* p = buf;
+        bool negative = *p == '-';
+        if (negative)
+            ++p;
+        const char* mantissaEnd = (const char*) memchr(p, 'e', n - (p - buf));
+        if (!mantissaEnd)
+            mantissaEnd = buf + n;
+        d = fromLiteral(p, mantissaEnd - p);
+        if (mantissaEnd != buf + n && !d.coefficient_.isZero())
+            d.exponent_ += (int32_t) strtol(mantissaEnd + 1, NULL, 10);
+        d.negative_ = negative && !d.coefficient_.isZero();
+        return d;
+    }
+
+    namespace {
+
+        Decimal viaDouble(Opcode op, const Decimal& a, const Decimal& b)
+        {
+            return Decimal::fromDouble(applyBinary(op, a.toDouble(), b.toDouble()));
+        }
+
+    }
+
+    Decimal Decimal::add(const Decimal& a, const Decimal& b)
+    {
+        if (!a.isFinite() || !b.isFinite())
+            return viaDouble(OP_ADD, a, b);
+        return addFinite(a, b, b.negative_);
+    }
+
+    Decimal Decimal::sub(const Decimal& a, const Decimal& b)
+    {
+        if (!a.isFinite() || !b.isFinite())
+            return viaDouble(OP_SUB, a, b);
+        return addFinite(a, b, !b.negative_);
+    }
+
+    Decimal Decimal::addFinite(const Decimal& a, const Decimal& b, bool bNegative)
+    {
+        if (b.isZero())
+            return a;
+        if (a.isZero()) {
+            Decimal r(b);
+            r.negative_ = bNegative;
+            return r;
+        }
+
+        const int32_t e = std::min(a.exponent_, b.exponent_);
+        Decimal r;
+        uint64_t ca, cb;
+        if (a.small(ca) && b.small(cb) && scaleSmall(ca, a.exponent_ - e) && scaleSmall(cb, b.exponent_ - e)) {
+            if (a.negative_ == bNegative) {
+                uint64_t sum;
+                if (!__builtin_add_overflow(ca, cb, &sum)) {
+                    r.setSmall(a.negative_, sum, e);
+                    return r;
+                }
+            } else if (ca >= cb) {
+                r.setSmall(a.negative_, ca - cb, e);
+                return r;
+            } else {
+                r.setSmall(bNegative, cb - ca, e);
+                return r;
+            }
+        }
+
+        Natural x(a.coefficient_), y(b.coefficient_);
+        x.mulPow10((size_t) (a.exponent_ - e));
+        y.mulPow10((size_t) (b.exponent_ - e));
+        r.exponent_ = e;
+        if (a.negative_ == bNegative) {
+            Natural::add(x, y, r.coefficient_);
+            r.negative_ = a.negative_;
+        } else if (Natural::compare(x, y) >= 0) {
+            Natural::sub(x, y, r.coefficient_);
+            r.negative_ = a.negative_ && !r.coefficient_.isZero();
+        } else {
+            Natural::sub(y, x, r.coefficient_);
+            r.negative_ = bNegative;
+        }
+        return r;
+    }
+
+    Decimal Decimal::negate() const
+    {
+        Decimal r(*this);
+        if (kind_ != NOT_A_NUMBER && !isZero())
+            r.negative_ = !negative_;
+        return r;
+    }
+
+    Decimal Decimal::mul(const Decimal& a, const Decimal& b)
+    {
+        if (!a.isFinite() || !b.isFinite())
+            return viaDouble(OP_MUL, a, b);
+        Decimal r;
+        if (a.isZero() || b.isZero())
+            return r;
+        const bool negative = a.negative_ != b.negative_;
+        const int32_t e = a.exponent_ + b.exponent_;
+        uint64_t ca, cb, product;
+        if (a.small(ca) && b.small(cb) && !__builtin_mul_overflow(ca, cb, &product)) {
+            r.setSmall(negative, product, e);
+            return r;
+        }
+        Natural::mul(a.coefficient_, b.coefficient_, r.coefficient_);
+        r.exponent_ = e;
+        r.negative_ = negative;
+        return r;
+    }
+
+    Decimal Decimal::div(const Decimal& a, const Decimal& b, int digits)
+    {
+        if (!a.isFinite() || !b.isFinite() || b.isZero())
+            return viaDouble(OP_DIV, a, b);
+        Decimal r;
+        if (a.isZero())
+            return r;
+        const bool negative = a.negative_ != b.negative_;
+
+        // Most quotients typed on a keypad terminate within a few digits
+        // (7/2, 6/8). Long division in 64 bits finds those without limbs.
+        uint64_t ca, cb;
+        if (a.small(ca) && b.small(cb) && cb <= ~0ULL / 10) {
+            uint64_t q = ca / cb, rest = ca % cb;
+            int32_t e = a.exponent_ - b.exponent_;
+            while (rest && q <= (~0ULL - 9) / 10) {
+                rest *= 10;
+                q = q * 10 + rest / cb;
+                rest %= cb;
+                --e;
+            }
+            if (!rest && (digits >= 20 || q < kPow10Wide[digits])) {
+                r.setSmall(negative, q, e);
+                r.normalize();
+                return r;
+            }
+        }
+
+        // Scale the dividend so the integer quotient has at least digits + 1
+        // digits; one more than needed for rounding, plus the remainder as a
+        // sticky bit.
+        const long na = (long) a.coefficient_.digitCount();
+        const long nb = (long) b.coefficient_.digitCount();
+        const long scale = std::max(0L, digits + 1 + nb - na);
+        Natural num(a.coefficient_), rem;
+        num.mulPow10((size_t) scale);
+        Natural::divMod(num, b.coefficient_, r.coefficient_, rem);
+        r.exponent_ = a.exponent_ - b.exponent_ - (int32_t) scale;
+        r.negative_ = negative;
+
+        // Round half to even at digits significant digits. The quotient is
+        // one or two digits over unless the dividend was already long.
+        const long extra = (long) r.coefficient_.digitCount() - digits;
+        if (extra > 0) {
+            const unsigned first = r.coefficient_.digit((size_t) extra - 1);
+            bool rest = !rem.isZero();
+            for (long i = 0; i < extra - 1 && !rest; ++i)
+                rest = r.coefficient_.digit((size_t) i) != 0;
+            r.coefficient_.divPow10((size_t) extra);
+            const bool odd = r.coefficient_.digit(0) & 1;
+            if (first > 5 || (first == 5 && (rest || odd)))
+                r.coefficient_.mulSmall(1, 1);
+            r.exponent_ += (int32_t) extra;
+        }
+        r.normalize();
+        return r;
+    }
+
+    double Decimal::toDouble() const
+    {
+        if (kind_ == NOT_A_NUMBER)
+            return NAN;
+        if (kind_ == INFINITE)
+            return negative_ ? -HUGE_VAL : HUGE_VAL;
+        if (coefficient_.isZero())
+            return 0.0;
+
+        // A coefficient exact in a double scaled by an exact power of ten is
+        // one correctly rounded operation.
+        static const double kExactPow10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        uint64_t c;
+        if (small(c) && c <= (1ULL << 53) && exponent_ >= -22 && exponent_ <= 22) {
+            double v = exponent_ >= 0 ? (double) c * kExactPow10[exponent_] : (double) c / kExactPow10[-exponent_];
+            return negative_ ? -v : v;
+        }
+
+        // Forty leading digits decide the rounding; anything nonzero below
+        // them only matters as a tie-breaker, so one sticky digit stands in.
+        // No radix character is written, so strtod's locale does not matter.
+        const size_t kLead = 40;
+        char buf[kLead + 32];
+        char* p = buf;
+        if (negative_)
+            *p++ = '-';
+        const size_t nd = coefficient_.digitCount();
+        const size_t take = std::min(nd, kLead);
+        for (size_t i = 0; i < take; ++i)
+            *p++ = (char) ('0' + coefficient_.digit(nd - 1 - i));
+        long exponent = exponent_ + (long) (nd - take);
+        if (take < nd) {
+            bool tail = false;
+            for (size_t i = 0; i < nd - take && !tail; ++i)
+                tail = coefficient_.digit(i) != 0;
+            if (tail) {
+                *p++ = '1';
+                --exponent;
+            }
+        }
+        snprintf(p, buf + sizeof(buf) - p, "e%ld", exponent);
+        return strtod(buf, NULL);
+    }
+
+    std::string Decimal::toString() const
+    {
+        if (!isFinite()) {
+            char buf[kFormatBufferSize];
+            formatShortest(toDouble(), buf);
+            return buf;
+        }
+        if (coefficient_.isZero())
+            return "0";
+
+        // Top limb unpadded, the rest nine digits each, trailing zeros cut.
+        // Coefficients that are still inline are unpacked on the stack.
+        const uint32_t* limbs = coefficient_.limbs();
+        const uint32_t size = coefficient_.size();
+        char local[Natural::kInlineLimbs * Natural::kBaseDigits + 1];
+        std::vector<char> spill;
+        char* digits = local;
+        if (size > Natural::kInlineLimbs) {
+            spill.resize((size_t) size * Natural::kBaseDigits + 1);
+            digits = &spill[0];
+        }
+        long nd = digitsIn(limbs[size - 1]);
+        for (uint32_t v = limbs[size - 1], j = (uint32_t) nd; j-- > 0; v /= 10)
+            digits[j] = (char) ('0' + v % 10);
+        for (uint32_t i = size - 1; i-- > 0; nd += Natural::kBaseDigits) {
+            uint32_t v = limbs[i];
+            for (int j = Natural::kBaseDigits; j-- > 0; v /= 10)
+                digits[nd + j] = (char) ('0' + v % 10);
+        }
+        long zeros = 0;
+        while (digits[nd - 1] == '0') {
+            --nd;
+            ++zeros;
+        }
+        const long k = nd + exponent_ + zeros;     // digits before the point
+
+        std::string out;
+        out.reserve((size_t) nd + 32);
+        if (negative_)
+            out.push_back('-');
+        if (k > -6 && k <= std::max(21L, nd)) {
+            if (k <= 0) {
+                out.append("0.");
+                out.append((size_t) -k, '0');
+                out.append(digits, (size_t) nd);
+            } else if (k >= nd) {
+                out.append(digits, (size_t) nd);
+                out.append((size_t) (k - nd), '0');
+            } else {
+                out.append(digits, (size_t) k);
+                out.push_back('.');
+                out.append(digits + k, (size_t) (nd - k));
+            }
+        } else {
+            out.push_back(digits[0]);
+            if (nd > 1) {
+                out.push_back('.');
+                out.append(digits + 1, (size_t) (nd - 1));
+            }
+            char exp[24];
+            snprintf(exp, sizeof(exp), "e%+ld", k - 1);
+            out.append(exp);
+        }
+        return out;
+    }
+
+    // ---- Evaluation ------------------------------------------------------
+
+    namespace {
+
+        // Operand stack in raw storage, so a run only constructs the slots
+        // the program reaches instead of all kMaxStack of them.
+        class DecimalStack {
+        public:
+            DecimalStack() : sp(0) {}
+            ~DecimalStack()
+            {
+                while (sp)
+                    slot(--sp)->~Decimal();
+            }
+
+            void push(const Decimal& d) { new (slot(sp++)) Decimal(d); }
+            Decimal& top() { return *slot(sp - 1); }
+
+            Decimal pop()
+            {
+                Decimal d(std::move(*slot(--sp)));
+                slot(sp)->~Decimal();
+                return d;
+            }
+
+        private:
+            Decimal* slot(int i) { return reinterpret_cast<Decimal*>(storage) + i; }
+
+            alignas(Decimal) unsigned char storage[kMaxStack * sizeof(Decimal)];
+            int sp;
+        };
+
+        size_t literalLength(const char* s, size_t n)
+        {
+            size_t i = 0;
+            while (i < n && ((s[i] >= '0' && s[i] <= '9') || s[i] == '.'))
+                ++i;
+            return i;
+        }
+
+    }
+
+    Decimal evaluateDecimal(const Program& program, const char* src, size_t len,
+                            bool (*stop)(void*), void* stopContext)
+    {
+        if (!program.ok())
+            return Decimal::fromDouble(NAN);
+
+        DecimalStack stack;
+        const std::vector<Instr>& code = program.code();
+        for (std::vector<Instr>::const_iterator it = code.begin(); it != code.end(); ++it) {
+            if (stop && stop(stopContext))
+                return Decimal::fromDouble(NAN);
+            switch (it->op) {
+                case OP_CONST: {
+                    // Implicit zeros point at a non-digit and read as empty.
+                    const char* s = src + it->pos;
+                    stack.push(Decimal::fromLiteral(s, literalLength(s, len - it->pos)));
+                    break;
+                }
+                case OP_VAR:
+                    stack.push(Decimal());
+                    break;
+                case OP_ADD:
+                case OP_SUB:
+                case OP_MUL:
+                case OP_DIV: {
+                    Decimal b = stack.pop();
+                    Decimal& a = stack.top();
+                    switch (it->op) {
+                        case OP_ADD: a = Decimal::add(a, b); break;
+                        case OP_SUB: a = Decimal::sub(a, b); break;
+                        case OP_MUL: a = Decimal::mul(a, b); break;
+                        default: a = Decimal::div(a, b); break;
+                    }
+                    break;
+                }
+                case OP_NEG:
+                    // From zero, like the double path, so "-0" is 0.
+                    stack.top() = Decimal::sub(Decimal(), stack.top());
+                    break;
+                case OP_SIN:
+                case OP_COS:
+                case OP_TAN:
+                    stack.top() = Decimal::fromDouble(applyUnary(it->op, stack.top().toDouble()));
+                    break;
+            }
+        }
+        return stack.pop();
+    }
+
+}
@@ -0,0 +1,145 @@
+//
+// Exact decimal arithmetic for the calculator's decimal mode.
+//
+// A Decimal is sign x coefficient x 10^exponent with an arbitrary-precision
+// coefficient, so sums, differences and products of typed literals are exact
+// ("0.1+0.2" is 0.3) and only division rounds, to kDecimalDigits significant
+// digits. Coefficients are base 10^9 limbs kept inside the object while they
+// fit in kInlineLimbs limbs (54 digits), which covers everyday input without
+// touching the heap; operands that fit in 64 bits skip the limb loops
+// entirely. Past kKaratsubaLimbs limbs products switch from schoolbook to
+// Karatsuba multiplication.
+//
+// The trigonometric functions have no exact decimal form; they are evaluated
+// in double precision and converted back through the shortest round-trip
+// digits, as are infinities and NaN, which follow IEEE rules.
+//
+
+#ifndef IMGUI_ANDROID_CALC_DECIMAL_H
+#define IMGUI_ANDROID_CALC_DECIMAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace calc {
+
+    class Program;
+
+    // Significant digits kept by a division that does not terminate.
+    static const int kDecimalDigits = 34;
+
+    // Unsigned integer in base 10^9 limbs, least significant first, with no
+    // leading zero limbs; zero has no limbs.
+    class Natural {
+    public:
+        static const uint32_t kBase = 1000000000;
+        static const int kBaseDigits = 9;
+        static const uint32_t kInlineLimbs = 6;
+        static const size_t kKaratsubaLimbs = 32;
+
+        Natural() : limbs_(inline_), size_(0), capacity_(kInlineLimbs) {}
+        explicit Natural(uint64_t v);
+        Natural(const Natural& other);
+        Natural(Natural&& other);
+        Natural& operator=(const Natural& other);
+        Natural& operator=(Natural&& other);
+        ~Natural();
+
+        bool isZero() const { return size_ == 0; }
+        bool onHeap() const { return limbs_ != inline_; }
+        uint32_t size() const { return size_; }
+        const uint32_t* limbs() const { return limbs_; }
+
+        // False if the value needs more than 64 bits.
+        bool toUint64(uint64_t& out) const;
+        void assign(uint64_t v);
+        size_t digitCount() const;
+        // Decimal digit i, counting from the least significant.
+        unsigned digit(size_t i) const;
+
+        // this = this * m + add
+        void mulSmall(uint32_t m, uint32_t add = 0);
+        // this /= d, returning the remainder. d != 0.
+        uint32_t divSmall(uint32_t d);
+        void mulPow10(size_t k);
+        // this /= 10^k, discarding the remainder.
+        void divPow10(size_t k);
+
+        static int compare(const Natural& a, const Natural& b);
+        static void add(const Natural& a, const Natural& b, Natural& out);
+        // a - b; a >= b.
+        static void sub(const Natural& a, const Natural& b, Natural& out);
+        static void mul(const Natural& a, const Natural& b, Natural& out);
+        // Truncating division; b != 0. q and r may not alias a or b.
+        static void divMod(const Natural& a, const Natural& b, Natural& q, Natural& r);
+
+    private:
+        void reserve(uint32_t n);
+        void resize(uint32_t n);
+        void trim();
+
+        uint32_t* limbs_;
+        uint32_t size_;
+        uint32_t capacity_;
+        uint32_t inline_[kInlineLimbs];
+    };
+
+    class Decimal {
+    public:
+        Decimal() : exponent_(0), negative_(false), kind_(FINITE) {}
+
+        // A run of digits and dots, read like parseLiteral reads it.
+        static Decimal fromLiteral(const char* s, size_t n);
+        // The shortest decimal that reads back as v; non-finite v keep their kind.
+        static Decimal fromDouble(double v);
+
+        static Decimal add(const Decimal& a, const Decimal& b);
+        static Decimal sub(const Decimal& a, const Decimal& b);
+        static Decimal mul(const Decimal& a, const Decimal& b);
+        // Exact when the quotient terminates within digits significant
+        // digits, otherwise rounded half to even.
+        static Decimal div(const Decimal& a, const Decimal& b, int digits = kDecimalDigits);
+        Decimal negate() const;
+
+        bool isFinite() const { return kind_ == FINITE; }
+        bool isZero() const { return kind_ == FINITE && coefficient_.isZero(); }
+        const Natural& coefficient() const { return coefficient_; }
+        int32_t exponent() const { return exponent_; }
+
+        // Correctly rounded.
+        double toDouble() const;
+
+        // Every digit, in plain notation when that needs no padding zeros
+        // beyond the JavaScript-style range formatShortest uses, otherwise as
+        // d.ddde+N. Non-finite values print as formatShortest prints them.
+        std::string toString() const;
+
+    private:
+        enum Kind : uint8_t { FINITE, INFINITE, NOT_A_NUMBER };
+
+        // Coefficients that fit in a uint64, for the allocation-free paths.
+        bool small(uint64_t& c) const { return coefficient_.toUint64(c); }
+        // a + b with b's sign taken as bNegative; both finite.
+        static Decimal addFinite(const Decimal& a, const Decimal& b, bool bNegative);
+        void setSmall(bool negative, uint64_t c, int32_t exponent);
+        // Drops trailing zero digits into the exponent.
+        void normalize();
+
+        Natural coefficient_;
+        int32_t exponent_;
+        bool negative_;
+        Kind kind_;
+    };
+
+    // Evaluates a compiled program in decimal. src and len must be the text
+    // the program was compiled from; literals are re-read from it so they
+    // keep every digit typed. Variables read as zero. NaN if the compile
+    // failed. If stop is given it is called with stopContext before every
+    // instruction, and a true return abandons the evaluation with NaN.
+    Decimal evaluateDecimal(const Program& program, const char* src, size_t len,
+                            bool (*stop)(void*) = NULL, void* stopContext = NULL);
+
+}
+
+#endif //IMGUI_ANDROID_CALC_DECIMAL_H
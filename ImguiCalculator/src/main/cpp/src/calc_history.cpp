@@ -0,0 +1,109 @@
+//
+// Bounded, append-only store of past calculations.
+//
+#include "calc_history.h"
+#include <cstring>
+
+namespace calc {
+
+    HistoryStore::HistoryStore(size_t maxEntries, size_t arenaBytes)
+            : arena_(arenaBytes ? arenaBytes : 1), records_(maxEntries ? maxEntries : 1),
+              head_(0), count_(0), write_(0), appended_(0)
+    {
+    }
+
+    namespace {
+        const char kCutMark[] = "...";
+        const size_t kCutMarkSize = sizeof(kCutMark) - 1;
+    }
+
+    void HistoryStore::copyCut(char* dst, const char* s, size_t size, size_t keep, bool keepEnd)
+    {
+        if (keep >= size) {
+            memcpy(dst, s, size);
+        } else if (keepEnd) {
+            memcpy(dst, kCutMark, kCutMarkSize);
+            memcpy(dst + kCutMarkSize, s + size - keep, keep);
+        } else {
+            memcpy(dst, s, keep);
+            memcpy(dst + keep, kCutMark, kCutMarkSize);
+        }
+    }
+
+    bool HistoryStore::append(const char* equation, size_t equationSize, const char* result, size_t resultSize)
+    {
+        const size_t capacity = arena_.size();
+        if (capacity < kMinArenaBytes)
+            return false;
+
+        // Text bytes kept of each string; a string cut short also gets the mark.
+        size_t equationKeep = equationSize, resultKeep = resultSize;
+        const size_t room = capacity - 2;
+        if (equationSize + resultSize > room) {
+            if (resultSize > room / 2)
+                resultKeep = room / 2 - kCutMarkSize;
+            size_t resultStored = resultKeep < resultSize ? resultKeep + kCutMarkSize : resultSize;
+            if (equationSize > room - resultStored)
+                equationKeep = room - resultStored - kCutMarkSize;
+        }
+        const size_t equationStored = equationKeep < equationSize ? equationKeep + kCutMarkSize : equationSize;
+        const size_t resultStored = resultKeep < resultSize ? resultKeep + kCutMarkSize : resultSize;
+        const size_t need = equationStored + 1 + resultStored + 1;
+
+        // Offsets only grow; the physical position wraps. A pair that would
+        // straddle the end of the arena skips to the start instead.
+        uint64_t start = write_;
+        size_t phys = (size_t) (start % capacity);
+        if (phys + need > capacity)
+            start += capacity - phys;
+        while (count_ && (count_ == records_.size() || start + need - records_[head_].offset > capacity))
+            evictOldest();
+
+        char* dst = &arena_[(size_t) (start % capacity)];
+        copyCut(dst, equation, equationSize, equationKeep, true);
+        dst[equationStored] = '\0';
+        copyCut(dst + equationStored + 1, result, resultSize, resultKeep, false);
+        dst[equationStored + 1 + resultStored] = '\0';
+
+        Record& r = records_[(head_ + count_) % records_.size()];
+        r.offset = start;
+        r.equationSize = (uint32_t) equationStored;
+        r.resultSize = (uint32_t) resultStored;
+        ++count_;
+        ++appended_;
+        write_ = start + need;
+        return true;
+    }
+
+    HistoryStore::Entry HistoryStore::at(size_t i) const
+    {
+        const Record& r = records_[(head_ + i) % records_.size()];
+        const char* text = &arena_[(size_t) (r.offset % arena_.size())];
+        Entry e;
+        e.equation.data = text;
+        e.equation.size = r.equationSize;
+        e.result.data = text + r.equationSize + 1;
+        e.result.size = r.resultSize;
+        return e;
+    }
+
+    size_t HistoryStore::bytesUsed() const
+    {
+        return count_ ? (size_t) (write_ - records_[head_].offset) : 0;
+    }
+
+    void HistoryStore::clear()
+    {
+        head_ = 0;
+        count_ = 0;
+        // The arena restarts too; appended() keeps counting.
+        write_ = 0;
+    }
+
+    void HistoryStore::evictOldest()
+    {
+        head_ = (head_ + 1) % records_.size();
+        --count_;
+    }
+
+}
@@ -0,0 +1,86 @@
+//
+// Bounded, append-only store of past calculations.
+//
+// Entries are (equation, result) pairs whose text lives in one byte arena
+// used as a ring: each entry's two strings are written back to back, NUL
+// terminated, at the arena's write position, wrapping to the start when
+// they would not fit before the end. Both the arena and the ring of entry
+// records are allocated once, by the constructor, so memory stays flat no
+// matter how long the session runs. An append evicts the oldest entries
+// until the new one fits within both the entry limit and the arena; that is
+// O(1) amortized, since every entry is evicted at most once.
+//
+
+#ifndef IMGUI_ANDROID_CALC_HISTORY_H
+#define IMGUI_ANDROID_CALC_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace calc {
+
+    class HistoryStore {
+    public:
+        // A NUL-terminated string inside the arena, valid until its entry
+        // is evicted or the store cleared.
+        struct Slice {
+            const char* data;
+            uint32_t size;      // not counting the NUL
+        };
+
+        struct Entry {
+            Slice equation;
+            Slice result;
+        };
+
+        // Keeps at most maxEntries entries and arenaBytes bytes of text,
+        // counting one NUL per string.
+        HistoryStore(size_t maxEntries, size_t arenaBytes);
+
+        // A pair larger than the whole arena is cut to fit: the result keeps
+        // its start and at most half the room, the equation keeps its end,
+        // and "..." marks each cut. False, storing nothing, only if the
+        // arena is under kMinArenaBytes; true otherwise, cut or not.
+        static const size_t kMinArenaBytes = 16;
+        bool append(const char* equation, size_t equationSize, const char* result, size_t resultSize);
+
+        // Entry i, oldest first; i < size().
+        Entry at(size_t i) const;
+
+        size_t size() const { return count_; }
+        bool empty() const { return count_ == 0; }
+        // Entries ever appended; the entry at(i) was number appended() - size() + i.
+        uint64_t appended() const { return appended_; }
+        uint64_t evicted() const { return appended_ - count_; }
+
+        size_t maxEntries() const { return records_.size(); }
+        size_t arenaBytes() const { return arena_.size(); }
+        // Arena bytes between the oldest entry and the write position,
+        // including any skipped tail.
+        size_t bytesUsed() const;
+
+        void clear();
+
+    private:
+        struct Record {
+            uint64_t offset;        // logical arena offset; physical is offset % arenaBytes
+            uint32_t equationSize;
+            uint32_t resultSize;
+        };
+
+        void evictOldest();
+        // Copies s, or its start or end when cut, to dst with "..." at the cut.
+        static void copyCut(char* dst, const char* s, size_t size, size_t keep, bool keepEnd);
+
+        std::vector<char> arena_;
+        std::vector<Record> records_;
+        size_t head_;               // ring index of the oldest record
+        size_t count_;
+        uint64_t write_;            // logical offset of the next write
+        uint64_t appended_;
+    };
+
+}
+
+#endif //IMGUI_ANDROID_CALC_HISTORY_H
@@ -0,0 +1,375 @@
+//
+// Persistent history: an append-only log of (equation, result) pairs.
+//
+#include "calc_history_log.h"
+#include "logger.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace calc {
+
+    namespace {
+
+        const char kMagic[8] = { 'C', 'A', 'L', 'C', 'H', 'I', 'S', 'T' };
+        const uint32_t kVersion = 1;
+
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t headerSize;
+            uint64_t end;           // end of the last complete record
+            uint64_t records;
+        };
+
+        const uint64_t kHeaderSize = sizeof(FileHeader);
+        // The file grows by at least this much, so appends rarely remap.
+        const uint64_t kGrowBytes = 64 * 1024;
+        // Compaction waits until the log is this big and holds this many
+        // times the records it would keep.
+        const uint64_t kCompactMinBytes = 256 * 1024;
+        const size_t kCompactFactor = 4;
+
+        // Lengths, text, padding, trailer.
+        inline uint64_t recordSize(uint64_t equationSize, uint64_t resultSize)
+        {
+            return ((8 + equationSize + resultSize + 3) & ~(uint64_t) 3) + 4;
+        }
+
+        inline uint32_t load32(const char* p)
+        {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        bool writeAll(int fd, const void* buf, size_t n, uint64_t offset)
+        {
+            const char* p = static_cast<const char*>(buf);
+            while (n) {
+                ssize_t w = pwrite(fd, p, n, (off_t) offset);
+                if (w < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    return false;
+                }
+                p += w;
+                n -= (size_t) w;
+                offset += (uint64_t) w;
+            }
+            return true;
+        }
+
+        void fillHeader(FileHeader& h, uint64_t end, uint64_t records)
+        {
+            memcpy(h.magic, kMagic, sizeof(kMagic));
+            h.version = kVersion;
+            h.headerSize = (uint32_t) kHeaderSize;
+            h.end = end;
+            h.records = records;
+        }
+
+    }
+
+    HistoryLog::HistoryLog(size_t keepEntries)
+            : keepEntries_(keepEntries ? keepEntries : 1), fd_(-1), map_(NULL), capacity_(0), end_(0),
+              records_(0), compactDone_(false), compactOk_(false), tmpFd_(-1), compactFrom_(0),
+              compactTo_(0), compactRecords_(0), compactBaseRecords_(0)
+    {
+    }
+
+    HistoryLog::~HistoryLog()
+    {
+        // Let a compaction finish rather than throw its work away; what it
+        // copies is only a few times what we keep.
+        finishCompaction(true);
+        close();
+    }
+
+    bool HistoryLog::open(const char* path)
+    {
+        // The compactor reads the old file's descriptor and the rename
+        // needs the old path, so it has to be done before either goes.
+        finishCompaction(true);
+        close();
+        path_ = path;
+        // Left over from a compaction the last run did not finish.
+        unlink((path_ + ".tmp").c_str());
+
+        fd_ = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            Log(LOG_ERROR) << "Could not open history log " << path << ": " << strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            Log(LOG_ERROR) << "Could not stat history log " << path << ": " << strerror(errno);
+            close();
+            return false;
+        }
+        if (st.st_size == 0)
+            return create();
+
+        bool valid = (uint64_t) st.st_size >= kHeaderSize && map((uint64_t) st.st_size);
+        if (valid) {
+            const FileHeader* h = reinterpret_cast<const FileHeader*>(map_);
+            valid = !memcmp(h->magic, kMagic, sizeof(kMagic)) && h->version == kVersion
+                    && h->headerSize == kHeaderSize && h->end >= kHeaderSize && h->end <= capacity_;
+            if (valid) {
+                end_ = h->end;
+                records_ = h->records;
+                return true;
+            }
+        }
+
+        // Not ours, or damaged beyond the header; keep it for inspection.
+        Log(LOG_WARN) << "History log " << path << " is not readable; moving it aside";
+        close();
+        path_ = path;
+        if (rename(path, (path_ + ".corrupt").c_str()) != 0) {
+            Log(LOG_ERROR) << "Could not move " << path << " aside: " << strerror(errno);
+            return false;
+        }
+        fd_ = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            Log(LOG_ERROR) << "Could not create history log " << path << ": " << strerror(errno);
+            return false;
+        }
+        return create();
+    }
+
+    bool HistoryLog::create()
+    {
+        end_ = kHeaderSize;
+        records_ = 0;
+        if (!reserve(kHeaderSize)) {
+            close();
+            return false;
+        }
+        FileHeader h;
+        fillHeader(h, end_, records_);
+        memcpy(map_, &h, sizeof(h));
+        return true;
+    }
+
+    bool HistoryLog::map(uint64_t capacity)
+    {
+        if (map_)
+            munmap(map_, (size_t) capacity_);
+        void* p = mmap(NULL, (size_t) capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) {
+            Log(LOG_ERROR) << "Could not map history log " << path_ << ": " << strerror(errno);
+            map_ = NULL;
+            capacity_ = 0;
+            return false;
+        }
+        map_ = static_cast<char*>(p);
+        capacity_ = capacity;
+        return true;
+    }
+
+    bool HistoryLog::reserve(uint64_t size)
+    {
+        if (size <= capacity_)
+            return true;
+        uint64_t capacity = std::max(capacity_ * 2, (size + kGrowBytes - 1) / kGrowBytes * kGrowBytes);
+        // Allocate the blocks now: a write through the mapping to a hole the
+        // disk cannot fill would be a SIGBUS instead of an error.
+        int err = posix_fallocate(fd_, 0, (off_t) capacity);
+        if (err == EINVAL || err == EOPNOTSUPP)
+            err = ftruncate(fd_, (off_t) capacity) == 0 ? 0 : errno;
+        if (err) {
+            Log(LOG_ERROR) << "Could not grow history log " << path_ << ": " << strerror(err);
+            return false;
+        }
+        return map(capacity);
+    }
+
+    void HistoryLog::writeEnd()
+    {
+        FileHeader* h = reinterpret_cast<FileHeader*>(map_);
+        h->records = records_;
+        h->end = end_;
+    }
+
+    void HistoryLog::close()
+    {
+        if (map_) {
+            munmap(map_, (size_t) capacity_);
+            map_ = NULL;
+        }
+        if (fd_ >= 0) {
+            // Give back the room reserved for appends.
+            if (end_ >= kHeaderSize && ftruncate(fd_, (off_t) end_) != 0)
+                Log(LOG_WARN) << "Could not trim history log " << path_ << ": " << strerror(errno);
+            ::close(fd_);
+            fd_ = -1;
+        }
+        capacity_ = 0;
+        end_ = 0;
+        records_ = 0;
+    }
+
+    uint64_t HistoryLog::previous(uint64_t pos) const
+    {
+        if (pos < kHeaderSize + recordSize(0, 0))
+            return 0;
+        uint64_t size = load32(map_ + pos - 4);
+        if (size < recordSize(0, 0) || size % 4 || size > pos - kHeaderSize)
+            return 0;
+        uint64_t start = pos - size;
+        if (recordSize(load32(map_ + start), load32(map_ + start + 4)) != size)
+            return 0;
+        return start;
+    }
+
+    size_t HistoryLog::loadTail(HistoryStore& store) const
+    {
+        if (fd_ < 0)
+            return 0;
+        std::vector<uint64_t> starts;
+        starts.reserve(std::min<uint64_t>(store.maxEntries(), records_));
+        uint64_t pos = end_;
+        while (pos > kHeaderSize && starts.size() < store.maxEntries()) {
+            uint64_t start = previous(pos);
+            if (!start) {
+                Log(LOG_WARN) << "History log " << path_ << " is damaged before offset " << pos
+                              << "; older entries are skipped";
+                break;
+            }
+            starts.push_back(start);
+            pos = start;
+        }
+        for (size_t i = starts.size(); i-- > 0;) {
+            const char* r = map_ + starts[i];
+            uint32_t equationSize = load32(r), resultSize = load32(r + 4);
+            store.append(r + 8, equationSize, r + 8 + equationSize, resultSize);
+        }
+        return starts.size();
+    }
+
+    bool HistoryLog::append(const char* equation, size_t equationSize, const char* result, size_t resultSize)
+    {
+        if (fd_ < 0 || equationSize > UINT32_MAX || resultSize > UINT32_MAX)
+            return false;
+        finishCompaction(false);
+
+        uint64_t size = recordSize(equationSize, resultSize);
+        if (!reserve(end_ + size))
+            return false;
+        char* r = map_ + end_;
+        uint32_t e = (uint32_t) equationSize, s = (uint32_t) resultSize, total = (uint32_t) size;
+        memcpy(r, &e, 4);
+        memcpy(r + 4, &s, 4);
+        memcpy(r + 8, equation, equationSize);
+        memcpy(r + 8 + equationSize, result, resultSize);
+        memset(r + 8 + equationSize + resultSize, 0, size - 4 - (8 + equationSize + resultSize));
+        memcpy(r + size - 4, &total, 4);
+        // The record is complete before the header points past it.
+        end_ += size;
+        ++records_;
+        writeEnd();
+
+        maybeCompact();
+        return true;
+    }
+
+    void HistoryLog::maybeCompact()
+    {
+        if (compactor_.joinable() || end_ < kCompactMinBytes || records_ <= kCompactFactor * keepEntries_)
+            return;
+
+        // Walking back is cheap: it reads one trailer and one header per record.
+        uint64_t from = end_, kept = 0;
+        while (kept < keepEntries_) {
+            uint64_t start = previous(from);
+            if (!start)
+                break;
+            from = start;
+            ++kept;
+        }
+
+        std::string tmp = path_ + ".tmp";
+        tmpFd_ = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (tmpFd_ < 0) {
+            Log(LOG_WARN) << "Could not start compacting " << path_ << ": " << strerror(errno);
+            return;
+        }
+        compactFrom_ = from;
+        compactTo_ = end_;
+        compactRecords_ = kept;
+        compactBaseRecords_ = records_;
+        compactOk_ = false;
+        compactDone_.store(false, std::memory_order_relaxed);
+        compactor_ = std::thread(&HistoryLog::compactMain, this, from, end_);
+    }
+
+    void HistoryLog::compactMain(uint64_t from, uint64_t to)
+    {
+        // Reads with pread, not through map_: the owning thread may remap
+        // while we copy. Nothing below to is written again.
+        std::vector<char> buf(kGrowBytes);
+        bool ok = true;
+        uint64_t out = kHeaderSize;
+        for (uint64_t pos = from; ok && pos < to;) {
+            size_t want = (size_t) std::min<uint64_t>(buf.size(), to - pos);
+            ssize_t got = pread(fd_, &buf[0], want, (off_t) pos);
+            if (got < 0 && errno == EINTR)
+                continue;
+            ok = got > 0 && writeAll(tmpFd_, &buf[0], (size_t) got, out);
+            pos += (uint64_t) std::max<ssize_t>(got, 0);
+            out += (uint64_t) std::max<ssize_t>(got, 0);
+        }
+        compactOk_ = ok;
+        compactDone_.store(true, std::memory_order_release);
+    }
+
+    void HistoryLog::finishCompaction(bool wait)
+    {
+        if (!compactor_.joinable() || (!wait && !compactDone_.load(std::memory_order_acquire)))
+            return;
+        compactor_.join();
+
+        std::string tmp = path_ + ".tmp";
+        bool ok = compactOk_;
+        // Records appended while the thread copied.
+        uint64_t copied = compactTo_ - compactFrom_;
+        uint64_t newEnd = kHeaderSize + copied + (end_ - compactTo_);
+        uint64_t newRecords = compactRecords_ + (records_ - compactBaseRecords_);
+        if (ok && end_ > compactTo_)
+            ok = writeAll(tmpFd_, map_ + compactTo_, (size_t) (end_ - compactTo_), kHeaderSize + copied);
+        FileHeader h;
+        fillHeader(h, newEnd, newRecords);
+        ok = ok && writeAll(tmpFd_, &h, sizeof(h), 0) && fsync(tmpFd_) == 0
+             && rename(tmp.c_str(), path_.c_str()) == 0;
+        if (!ok) {
+            Log(LOG_WARN) << "Could not compact history log " << path_ << ": " << strerror(errno);
+            ::close(tmpFd_);
+            tmpFd_ = -1;
+            unlink(tmp.c_str());
+            return;
+        }
+
+        uint64_t oldBytes = end_;
+        munmap(map_, (size_t) capacity_);
+        map_ = NULL;
+        capacity_ = 0;
+        ::close(fd_);
+        fd_ = tmpFd_;
+        tmpFd_ = -1;
+        end_ = newEnd;
+        records_ = newRecords;
+        if (!reserve(newEnd + kGrowBytes)) {
+            ::close(fd_);
+            fd_ = -1;
+            return;
+        }
+        Log(LOG_INFO) << "Compacted history log from " << oldBytes << " to " << newEnd << " bytes";
+    }
+
+}
@@ -0,0 +1,99 @@
+//
+// Persistent history: an append-only log of (equation, result) pairs.
+//
+// The file is a fixed header followed by records. Each record is the two
+// string lengths, the two strings, padding to four bytes and then its own
+// total size as a trailer, so the log can be walked backwards from its end.
+// Startup maps the file and reads only as many records from the tail as the
+// in-memory HistoryStore will keep, however long the log has grown; no text
+// is parsed. Appends write through the mapping, which grows in chunks, and
+// then advance the end recorded in the header, so a record cut short by a
+// crash is never seen.
+//
+// The log keeps everything ever appended until it is compacted: once it holds
+// several times more records than are kept, a background thread copies the
+// tail into a new file. Whatever was appended meanwhile is copied over by the
+// next append on the owning thread, which then renames the new file into
+// place. A HistoryLog is not itself thread-safe; one thread owns it.
+//
+
+#ifndef IMGUI_ANDROID_CALC_HISTORY_LOG_H
+#define IMGUI_ANDROID_CALC_HISTORY_LOG_H
+
+#include "calc_history.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace calc {
+
+    class HistoryLog {
+    public:
+        // Compaction keeps the newest keepEntries records.
+        explicit HistoryLog(size_t keepEntries);
+        // Waits for a compaction in progress and trims the file to its end.
+        ~HistoryLog();
+
+        // Opens the log at path, creating it if missing. A file that is not a
+        // history log is moved aside to path + ".corrupt" and a new log
+        // started. False, with the reason logged, if the file cannot be used.
+        bool open(const char* path);
+        bool isOpen() const { return fd_ >= 0; }
+
+        // Appends the newest records to store, oldest first, stopping once
+        // store is full. Returns the number appended.
+        size_t loadTail(HistoryStore& store) const;
+
+        // False if the log is not open or the file could not grow.
+        bool append(const char* equation, size_t equationSize, const char* result, size_t resultSize);
+
+        uint64_t records() const { return records_; }
+        uint64_t bytes() const { return end_; }
+        // True while a background compaction is running or waiting to finish.
+        bool compacting() const { return compactor_.joinable(); }
+
+    private:
+        HistoryLog(const HistoryLog&);
+        HistoryLog& operator=(const HistoryLog&);
+
+        bool create();
+        bool map(uint64_t capacity);
+        bool reserve(uint64_t size);
+        void writeEnd();
+        void close();
+
+        // Offset of the record before the one starting at pos; 0 if there
+        // is none or the trailer is damaged.
+        uint64_t previous(uint64_t pos) const;
+
+        void maybeCompact();
+        void compactMain(uint64_t from, uint64_t to);
+        // Renames the compacted file into place once the thread is done, or
+        // waits for it first.
+        void finishCompaction(bool wait);
+
+        size_t keepEntries_;
+        std::string path_;
+        int fd_;
+        char* map_;
+        uint64_t capacity_;     // bytes mapped, the file's size
+        uint64_t end_;          // end of the last complete record
+        uint64_t records_;
+
+        // Compaction, started from maybeCompact. The thread copies
+        // [compactFrom_, compactTo_) of this file into tmpFd_.
+        std::thread compactor_;
+        std::atomic<bool> compactDone_;
+        bool compactOk_;
+        int tmpFd_;
+        uint64_t compactFrom_;
+        uint64_t compactTo_;
+        uint64_t compactRecords_;   // records in the copied range
+        uint64_t compactBaseRecords_;   // records_ when it started
+    };
+
+}
+
+#endif //IMGUI_ANDROID_CALC_HISTORY_LOG_H
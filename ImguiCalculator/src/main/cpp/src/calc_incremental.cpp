@@ -0,0 +1,300 @@
+//
+// Live preview of an expression while it is being typed.
+//
+#include "calc_incremental.h"
+#include "calc_number.h"
+#include <math.h>
+
+namespace calc {
+
+    namespace {
+
+        // Literals with at most 2^53 as digits and at most 22 fractional
+        // digits are one correctly rounded division away from their value,
+        // which is exactly what the full parse returns for them.
+        const uint64_t kFastMantissa = 1ULL << 53;
+        const uint16_t kFastFrac = 22;
+        const double kPow10[kFastFrac + 1] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        const char* functionName(uint8_t op)
+        {
+            switch (op) {
+                case OP_SIN: return "sin";
+                case OP_COS: return "cos";
+                default: return "tan";
+            }
+        }
+
+        bool binaryOp(char ch, Opcode& op)
+        {
+            switch (ch) {
+                case '+': op = OP_ADD; return true;
+                case '-': op = OP_SUB; return true;
+                case 'X':
+                case '*': op = OP_MUL; return true;
+                case '/': op = OP_DIV; return true;
+                default: return false;
+            }
+        }
+
+    }
+
+    IncrementalEvaluator::IncrementalEvaluator()
+    {
+        Step initial = Step();
+        initial.opTop = -1;
+        initial.valTop = -1;
+        steps_.push_back(initial);
+    }
+
+    void IncrementalEvaluator::append(char ch)
+    {
+        text_.push_back(ch);
+        Step s = next(steps_.back(), ch);
+        s.opsSize = (uint32_t) ops_.size();
+        s.valsSize = (uint32_t) vals_.size();
+        steps_.push_back(s);
+    }
+
+    void IncrementalEvaluator::append(const char* s, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            append(s[i]);
+    }
+
+    void IncrementalEvaluator::pop()
+    {
+        if (text_.empty())
+            return;
+        text_.pop_back();
+        steps_.pop_back();
+        ops_.resize(steps_.back().opsSize);
+        vals_.resize(steps_.back().valsSize);
+    }
+
+    void IncrementalEvaluator::clear()
+    {
+        text_.clear();
+        steps_.resize(1);
+        ops_.clear();
+        vals_.clear();
+    }
+
+    bool IncrementalEvaluator::pushOp(Step& s, Opcode op, bool paren)
+    {
+        if (s.opDepth == kMaxNesting)
+            return false;
+        OpNode node = { op, paren, s.opTop };
+        ops_.push_back(node);
+        s.opTop = (int32_t) ops_.size() - 1;
+        ++s.opDepth;
+        return true;
+    }
+
+    bool IncrementalEvaluator::pushVal(Step& s, double v)
+    {
+        if (s.valDepth == kMaxStack)
+            return false;
+        ValNode node = { v, s.valTop };
+        vals_.push_back(node);
+        s.valTop = (int32_t) vals_.size() - 1;
+        ++s.valDepth;
+        return true;
+    }
+
+    void IncrementalEvaluator::reduce(Step& s, int prec)
+    {
+        // Same release rule as the compiler, applied to values instead of
+        // emitted as code. Popping only moves the top index, so older
+        // snapshots still see their nodes.
+        while (s.opTop >= 0 && !ops_[s.opTop].paren && precedence(ops_[s.opTop].op) >= prec) {
+            const OpNode op = ops_[s.opTop];
+            s.opTop = op.below;
+            --s.opDepth;
+            const ValNode top = vals_[s.valTop];
+            ValNode result;
+            if (isUnary(op.op)) {
+                result.value = applyUnary(op.op, top.value);
+                result.below = top.below;
+            } else {
+                const ValNode left = vals_[top.below];
+                result.value = applyBinary(op.op, left.value, top.value);
+                result.below = left.below;
+                --s.valDepth;
+            }
+            vals_.push_back(result);
+            s.valTop = (int32_t) vals_.size() - 1;
+        }
+    }
+
+    bool IncrementalEvaluator::commitOperand(Step& s)
+    {
+        if (!s.inLiteral)
+            return true;
+        s.inLiteral = false;
+        s.afterOperand = true;
+        return pushVal(s, s.literal);
+    }
+
+    IncrementalEvaluator::Step IncrementalEvaluator::next(const Step& cur, char ch)
+    {
+        Step s = cur;
+        if (s.error)
+            return s;
+        const uint32_t at = (uint32_t) text_.size() - 1;
+
+        // Half way through a function name only its next letter will do.
+        if (s.word) {
+            if (ch != functionName(s.word)[s.wordLen]) {
+                s.error = true;
+            } else if (++s.wordLen == 3) {
+                s.error = !pushOp(s, (Opcode) s.word, false);
+                s.word = 0;
+                s.wordLen = 0;
+            }
+            return s;
+        }
+
+        if ((ch >= '0' && ch <= '9') || ch == '.') {
+            if (!s.inLiteral) {
+                if (s.afterOperand) {
+                    s.error = true;
+                    return s;
+                }
+                s.inLiteral = true;
+                s.litStart = at;
+                s.literal = 0.0;
+                s.mantissa = 0;
+                s.frac = 0;
+                s.dot = s.frozen = s.slow = false;
+            }
+            if (s.frozen)
+                return s;
+            if (ch == '.') {
+                if (s.dot)
+                    s.frozen = true;
+                s.dot = true;
+                return s;
+            }
+            if (s.dot)
+                ++s.frac;
+            if (!s.slow) {
+                s.mantissa = s.mantissa * 10 + (uint64_t) (ch - '0');
+                s.slow = s.mantissa > kFastMantissa || s.frac > kFastFrac;
+            }
+            if (s.slow)
+                s.literal = parseLiteral(text_.data() + s.litStart, at + 1 - s.litStart);
+            else
+                s.literal = (double) s.mantissa / kPow10[s.frac];
+            return s;
+        }
+
+        if (!commitOperand(s)) {
+            s.error = true;
+            return s;
+        }
+
+        if (ch == ' ' || ch == '\t')
+            return s;
+
+        Opcode op;
+        if (binaryOp(ch, op)) {
+            if (!s.afterOperand) {
+                if (op == OP_SUB) {
+                    s.error = !pushOp(s, OP_NEG, false);
+                    return s;
+                }
+                if (op == OP_ADD)
+                    return s;
+                // A missing left operand is zero.
+                if (!pushVal(s, 0.0)) {
+                    s.error = true;
+                    return s;
+                }
+                s.afterOperand = true;
+            }
+            reduce(s, precedence(op));
+            s.error = !pushOp(s, op, false);
+            s.afterOperand = false;
+            return s;
+        }
+
+        if (ch == ')') {
+            if (!s.afterOperand && !pushVal(s, 0.0)) {
+                s.error = true;
+                return s;
+            }
+            s.afterOperand = true;
+            reduce(s, 0);
+            if (s.opTop < 0) {
+                s.error = true;
+                return s;
+            }
+            s.opTop = ops_[s.opTop].below;
+            --s.opDepth;
+            return s;
+        }
+
+        // Everything else starts an operand, so it needs an operand position.
+        if (s.afterOperand) {
+            s.error = true;
+            return s;
+        }
+        if (ch >= 'x' && ch <= 'z') {
+            // Variables read as zero, as in calEverything.
+            s.error = !pushVal(s, 0.0);
+            s.afterOperand = true;
+        } else if (ch == '(') {
+            s.error = !pushOp(s, OP_ADD, true);
+        } else if (ch == 's' || ch == 'c' || ch == 't') {
+            s.word = ch == 's' ? OP_SIN : ch == 'c' ? OP_COS : OP_TAN;
+            s.wordLen = 1;
+        } else {
+            s.error = true;
+        }
+        return s;
+    }
+
+    bool IncrementalEvaluator::valid() const
+    {
+        const Step& s = steps_.back();
+        return !s.error && !s.word;
+    }
+
+    double IncrementalEvaluator::value() const
+    {
+        if (!valid())
+            return NAN;
+        const Step& s = steps_.back();
+
+        // Finish the text the way the compiler finishes it: the operand being
+        // typed (or an implicit zero) goes on top, then every pending
+        // operator is released and open parentheses are dropped.
+        double v;
+        int32_t below = s.valTop;
+        if (s.inLiteral || !s.afterOperand) {
+            if (s.valDepth == kMaxStack)
+                return NAN;
+            v = s.inLiteral ? s.literal : 0.0;
+        } else {
+            v = vals_[below].value;
+            below = vals_[below].below;
+        }
+        for (int32_t i = s.opTop; i >= 0; i = ops_[i].below) {
+            const OpNode& op = ops_[i];
+            if (op.paren)
+                continue;
+            if (isUnary(op.op)) {
+                v = applyUnary(op.op, v);
+            } else {
+                v = applyBinary(op.op, vals_[below].value, v);
+                below = vals_[below].below;
+            }
+        }
+        return v;
+    }
+
+}
@@ -0,0 +1,93 @@
+//
+// Live preview of an expression while it is being typed.
+//
+// The evaluator keeps the lexer and shunting-yard state for every prefix of
+// the text, so appending a character is O(1) amortized and removing the last
+// one just restores the previous snapshot. The operator and value stacks are
+// persistent linked lists in append-only arenas: a snapshot is a pair of top
+// indices, and undo truncates the arenas. value() always equals what
+// calEverything would return for text(), NaN included.
+//
+
+#ifndef IMGUI_ANDROID_CALC_INCREMENTAL_H
+#define IMGUI_ANDROID_CALC_INCREMENTAL_H
+
+#include "calc_program.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace calc {
+
+    class IncrementalEvaluator {
+    public:
+        IncrementalEvaluator();
+
+        void append(char ch);
+        void append(const char* s, size_t n);
+        void append(const std::string& s) { append(s.data(), s.size()); }
+
+        // Drops the last character; no-op on empty text.
+        void pop();
+        void clear();
+
+        // Result of the text so far. Reading it folds the operators still
+        // pending, so it costs the nesting depth of the text, not its length.
+        double value() const;
+        // False while the text cannot be evaluated, e.g. half of "sin".
+        bool valid() const;
+
+        const std::string& text() const { return text_; }
+        bool empty() const { return text_.empty(); }
+
+    private:
+        struct OpNode {
+            Opcode op;
+            bool paren;
+            int32_t below;
+        };
+
+        struct ValNode {
+            double value;
+            int32_t below;
+        };
+
+        // Everything needed to resume after a given prefix. One is kept per
+        // character typed; undo pops one.
+        struct Step {
+            double literal;         // value of the operand literal so far
+            uint64_t mantissa;      // literal digits, while they fit the fast path
+            int32_t opTop;          // ops_ index of the innermost pending operator, -1 if none
+            int32_t valTop;         // vals_ index of the top value, -1 if none
+            uint32_t opsSize;       // arena sizes to roll back to
+            uint32_t valsSize;
+            uint16_t opDepth;
+            uint16_t valDepth;
+            uint32_t litStart;      // text offset of the operand literal
+            uint16_t frac;          // digits after the point
+            bool inLiteral;         // digits still being appended
+            uint8_t word;           // function name being spelled, 0 if none
+            uint8_t wordLen;
+            bool afterOperand;      // expecting an operator or ')'
+            bool dot;               // literal has a point
+            bool frozen;            // a second point ended the parsed prefix
+            bool slow;              // literal too long for the fast path
+            bool error;
+        };
+
+        Step next(const Step& cur, char ch);
+        bool pushOp(Step& s, Opcode op, bool paren);
+        bool pushVal(Step& s, double v);
+        void reduce(Step& s, int prec);
+        bool commitOperand(Step& s);
+
+        std::string text_;
+        std::vector<Step> steps_;       // steps_[i] is the state after i characters
+        std::vector<OpNode> ops_;
+        std::vector<ValNode> vals_;
+    };
+
+}
+
+#endif //IMGUI_ANDROID_CALC_INCREMENTAL_H
@@ -0,0 +1,837 @@
+//
+// Exact, allocation-free conversions between calculator literals and doubles.
+//
+#include "calc_number.h"
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+
+namespace calc {
+
+    namespace {
+
+        // ---- Parsing ----------------------------------------------------
+
+        const uint64_t kExactMantissa = 1ULL << 53;
+        const double kExactPow10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        // 128-bit mantissas of 10^q, normalized to the top bit and rounded
+        // down, for the exponents a typed literal realistically reaches.
+        // Literals outside the range take the slow path.
+        const int kPow10Min = -64;
+        const int kPow10Max = 64;
+        const uint64_t kPow10Mantissa[kPow10Max - kPow10Min + 1][2] = {
+            { 0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL },
+            { 0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL },
+            { 0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL },
+            { 0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL },
+            { 0xcdb02555653131b6ULL, 0x3792f412cb06794dULL },
+            { 0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL },
+            { 0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL },
+            { 0xc8de047564d20a8bULL, 0xf245825a5a445275ULL },
+            { 0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL },
+            { 0x9ced737bb6c4183dULL, 0x55464dd69685606bULL },
+            { 0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL },
+            { 0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL },
+            { 0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL },
+            { 0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL },
+            { 0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL },
+            { 0x95a8637627989aadULL, 0xdde7001379a44aa8ULL },
+            { 0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL },
+            { 0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL },
+            { 0x9226712162ab070dULL, 0xcab3961304ca70e8ULL },
+            { 0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL },
+            { 0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL },
+            { 0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL },
+            { 0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL },
+            { 0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL },
+            { 0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL },
+            { 0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL },
+            { 0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL },
+            { 0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL },
+            { 0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL },
+            { 0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL },
+            { 0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL },
+            { 0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL },
+            { 0xcfb11ead453994baULL, 0x67de18eda5814af2ULL },
+            { 0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL },
+            { 0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL },
+            { 0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL },
+            { 0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL },
+            { 0x9e74d1b791e07e48ULL, 0x775ea264cf55347dULL },
+            { 0xc612062576589ddaULL, 0x95364afe032a819dULL },
+            { 0xf79687aed3eec551ULL, 0x3a83ddbd83f52204ULL },
+            { 0x9abe14cd44753b52ULL, 0xc4926a9672793542ULL },
+            { 0xc16d9a0095928a27ULL, 0x75b7053c0f178293ULL },
+            { 0xf1c90080baf72cb1ULL, 0x5324c68b12dd6338ULL },
+            { 0x971da05074da7beeULL, 0xd3f6fc16ebca5e03ULL },
+            { 0xbce5086492111aeaULL, 0x88f4bb1ca6bcf584ULL },
+            { 0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e5ULL },
+            { 0x9392ee8e921d5d07ULL, 0x3aff322e62439fcfULL },
+            { 0xb877aa3236a4b449ULL, 0x09befeb9fad487c2ULL },
+            { 0xe69594bec44de15bULL, 0x4c2ebe687989a9b3ULL },
+            { 0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a10ULL },
+            { 0xb424dc35095cd80fULL, 0x538484c19ef38c94ULL },
+            { 0xe12e13424bb40e13ULL, 0x2865a5f206b06fb9ULL },
+            { 0x8cbccc096f5088cbULL, 0xf93f87b7442e45d3ULL },
+            { 0xafebff0bcb24aafeULL, 0xf78f69a51539d748ULL },
+            { 0xdbe6fecebdedd5beULL, 0xb573440e5a884d1bULL },
+            { 0x89705f4136b4a597ULL, 0x31680a88f8953030ULL },
+            { 0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3dULL },
+            { 0xd6bf94d5e57a42bcULL, 0x3d32907604691b4cULL },
+            { 0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b10fULL },
+            { 0xa7c5ac471b478423ULL, 0x0fcf80dc33721d53ULL },
+            { 0xd1b71758e219652bULL, 0xd3c36113404ea4a8ULL },
+            { 0x83126e978d4fdf3bULL, 0x645a1cac083126e9ULL },
+            { 0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a3ULL },
+            { 0xccccccccccccccccULL, 0xccccccccccccccccULL },
+            { 0x8000000000000000ULL, 0x0000000000000000ULL },
+            { 0xa000000000000000ULL, 0x0000000000000000ULL },
+            { 0xc800000000000000ULL, 0x0000000000000000ULL },
+            { 0xfa00000000000000ULL, 0x0000000000000000ULL },
+            { 0x9c40000000000000ULL, 0x0000000000000000ULL },
+            { 0xc350000000000000ULL, 0x0000000000000000ULL },
+            { 0xf424000000000000ULL, 0x0000000000000000ULL },
+            { 0x9896800000000000ULL, 0x0000000000000000ULL },
+            { 0xbebc200000000000ULL, 0x0000000000000000ULL },
+            { 0xee6b280000000000ULL, 0x0000000000000000ULL },
+            { 0x9502f90000000000ULL, 0x0000000000000000ULL },
+            { 0xba43b74000000000ULL, 0x0000000000000000ULL },
+            { 0xe8d4a51000000000ULL, 0x0000000000000000ULL },
+            { 0x9184e72a00000000ULL, 0x0000000000000000ULL },
+            { 0xb5e620f480000000ULL, 0x0000000000000000ULL },
+            { 0xe35fa931a0000000ULL, 0x0000000000000000ULL },
+            { 0x8e1bc9bf04000000ULL, 0x0000000000000000ULL },
+            { 0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL },
+            { 0xde0b6b3a76400000ULL, 0x0000000000000000ULL },
+            { 0x8ac7230489e80000ULL, 0x0000000000000000ULL },
+            { 0xad78ebc5ac620000ULL, 0x0000000000000000ULL },
+            { 0xd8d726b7177a8000ULL, 0x0000000000000000ULL },
+            { 0x878678326eac9000ULL, 0x0000000000000000ULL },
+            { 0xa968163f0a57b400ULL, 0x0000000000000000ULL },
+            { 0xd3c21bcecceda100ULL, 0x0000000000000000ULL },
+            { 0x84595161401484a0ULL, 0x0000000000000000ULL },
+            { 0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL },
+            { 0xcecb8f27f4200f3aULL, 0x0000000000000000ULL },
+            { 0x813f3978f8940984ULL, 0x4000000000000000ULL },
+            { 0xa18f07d736b90be5ULL, 0x5000000000000000ULL },
+            { 0xc9f2c9cd04674edeULL, 0xa400000000000000ULL },
+            { 0xfc6f7c4045812296ULL, 0x4d00000000000000ULL },
+            { 0x9dc5ada82b70b59dULL, 0xf020000000000000ULL },
+            { 0xc5371912364ce305ULL, 0x6c28000000000000ULL },
+            { 0xf684df56c3e01bc6ULL, 0xc732000000000000ULL },
+            { 0x9a130b963a6c115cULL, 0x3c7f400000000000ULL },
+            { 0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL },
+            { 0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL },
+            { 0x96769950b50d88f4ULL, 0x1314448000000000ULL },
+            { 0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL },
+            { 0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL },
+            { 0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL },
+            { 0xb7abc627050305adULL, 0xf14a3d9e40000000ULL },
+            { 0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL },
+            { 0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL },
+            { 0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL },
+            { 0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL },
+            { 0x8c213d9da502de45ULL, 0x4526f422cc340000ULL },
+            { 0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL },
+            { 0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL },
+            { 0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL },
+            { 0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL },
+            { 0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL },
+            { 0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL },
+            { 0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL },
+            { 0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL },
+            { 0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL },
+            { 0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL },
+            { 0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL },
+            { 0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL },
+            { 0x9f4f2726179a2245ULL, 0x01d762422c946590ULL },
+            { 0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL },
+            { 0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL },
+            { 0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL },
+            { 0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL },
+        };
+
+        void mul64(uint64_t a, uint64_t b, uint64_t& hi, uint64_t& lo)
+        {
+#if defined(__SIZEOF_INT128__)
+            unsigned __int128 p = (unsigned __int128) a * b;
+            hi = (uint64_t) (p >> 64);
+            lo = (uint64_t) p;
+#else
+            uint64_t aLo = (uint32_t) a, aHi = a >> 32;
+            uint64_t bLo = (uint32_t) b, bHi = b >> 32;
+            uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+            uint64_t mid = (ll >> 32) + (uint32_t) lh + (uint32_t) hl;
+            hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+            lo = (mid << 32) | (uint32_t) ll;
+#endif
+        }
+
+        int leadingZeros(uint64_t v)
+        {
+            int n = 0;
+            for (uint64_t bit = 1ULL << 63; !(v & bit); bit >>= 1)
+                ++n;
+            return n;
+        }
+
+        double fromBits(uint64_t bits)
+        {
+            double v;
+            memcpy(&v, &bits, sizeof(v));
+            return v;
+        }
+
+        // Eisel-Lemire: w x 10^q from one (rarely two) 64x64 products with the
+        // truncated power of ten. Fails, and leaves the literal to the exact
+        // path, when the truncation could decide the rounding. w != 0.
+        bool eiselLemire(uint64_t w, int q, double& out)
+        {
+            if (q < kPow10Min || q > kPow10Max)
+                return false;
+            const uint64_t* pow = kPow10Mantissa[q - kPow10Min];
+            int clz = leadingZeros(w);
+            w <<= clz;
+            // floor(q * log2(10)) + 64 + bias - clz
+            uint64_t exp2 = (uint64_t) (((217706 * q) >> 16) + 64 + 1023 - clz);
+
+            uint64_t hi, lo;
+            mul64(w, pow[0], hi, lo);
+            if ((hi & 0x1FF) == 0x1FF && lo + w < w) {
+                uint64_t hi2, lo2;
+                mul64(w, pow[1], hi2, lo2);
+                uint64_t mergedHi = hi, mergedLo = lo + hi2;
+                if (mergedLo < lo)
+                    ++mergedHi;
+                if ((mergedHi & 0x1FF) == 0x1FF && mergedLo + 1 == 0 && lo2 + w < w)
+                    return false;
+                hi = mergedHi;
+                lo = mergedLo;
+            }
+
+            uint64_t msb = hi >> 63;
+            uint64_t mant = hi >> (msb + 9);
+            exp2 -= 1 ^ msb;
+            if (lo == 0 && (hi & 0x1FF) == 0 && (mant & 3) == 1)
+                return false;   // exactly halfway as far as we can tell
+            mant += mant & 1;
+            mant >>= 1;
+            if (mant >> 53) {
+                mant >>= 1;
+                ++exp2;
+            }
+            if (exp2 - 1 >= 0x7FF - 1)
+                return false;   // subnormal or overflow
+            out = fromBits((exp2 << 52) | (mant & ((1ULL << 52) - 1)));
+            return true;
+        }
+
+        // Decimal digits 0-9 (not ASCII), value 0.d[0]d[1]... x 10^dp. Digits
+        // past kMaxDigits cannot change the rounding except to break an exact
+        // tie, which trunc records.
+        const int kMaxDigits = 800;
+        const unsigned kMaxShift = 60;
+
+        struct Decimal {
+            uint8_t d[kMaxDigits];
+            int nd;
+            int dp;
+            bool trunc;
+
+            void trim()
+            {
+                while (nd > 0 && d[nd - 1] == 0)
+                    --nd;
+                if (nd == 0)
+                    dp = 0;
+            }
+
+            // Multiplies by 2^k, k <= kMaxShift, working from the last digit.
+            void leftShift(unsigned k)
+            {
+                uint8_t out[kMaxDigits + 20];
+                int w = (int) sizeof(out);
+                uint64_t carry = 0;
+                for (int i = nd - 1; i >= 0; --i) {
+                    uint64_t v = ((uint64_t) d[i] << k) + carry;
+                    out[--w] = (uint8_t) (v % 10);
+                    carry = v / 10;
+                }
+                while (carry) {
+                    out[--w] = (uint8_t) (carry % 10);
+                    carry /= 10;
+                }
+                int produced = (int) sizeof(out) - w;
+                dp += produced - nd;
+                int keep = produced < kMaxDigits ? produced : kMaxDigits;
+                for (int i = keep; i < produced; ++i) {
+                    if (out[w + i])
+                        trunc = true;
+                }
+                memcpy(d, out + w, keep);
+                nd = keep;
+                trim();
+            }
+
+            // Divides by 2^k, k <= kMaxShift, as long division from the first digit.
+            void rightShift(unsigned k)
+            {
+                int r = 0, w = 0;
+                uint64_t n = 0;
+                for (; (n >> k) == 0; ++r) {
+                    if (r >= nd) {
+                        if (n == 0) {
+                            nd = 0;
+                            return;
+                        }
+                        while ((n >> k) == 0) {
+                            n *= 10;
+                            ++r;
+                        }
+                        break;
+                    }
+                    n = n * 10 + d[r];
+                }
+                dp -= r - 1;
+
+                const uint64_t mask = (1ULL << k) - 1;
+                for (; r < nd; ++r) {
+                    uint64_t c = d[r];
+                    d[w++] = (uint8_t) (n >> k);
+                    n = (n & mask) * 10 + c;
+                }
+                while (n > 0) {
+                    uint8_t dig = (uint8_t) (n >> k);
+                    n &= mask;
+                    if (w < kMaxDigits)
+                        d[w++] = dig;
+                    else if (dig > 0)
+                        trunc = true;
+                    n *= 10;
+                }
+                nd = w;
+                trim();
+            }
+
+            void shift(int k)
+            {
+                if (nd == 0)
+                    return;
+                for (; k > (int) kMaxShift; k -= (int) kMaxShift)
+                    leftShift(kMaxShift);
+                for (; k < -(int) kMaxShift; k += (int) kMaxShift)
+                    rightShift(kMaxShift);
+                if (k > 0)
+                    leftShift((unsigned) k);
+                else if (k < 0)
+                    rightShift((unsigned) -k);
+            }
+
+            // Round half to even at digit position at, counting the dropped
+            // digits as a nonzero tail.
+            bool shouldRoundUp(int at) const
+            {
+                if (at < 0 || at >= nd)
+                    return false;
+                if (d[at] == 5 && at + 1 == nd) {
+                    if (trunc)
+                        return true;
+                    return at > 0 && (d[at - 1] & 1);
+                }
+                return d[at] >= 5;
+            }
+
+            uint64_t roundedInteger() const
+            {
+                if (dp > 20)
+                    return ~0ULL;
+                int i = 0;
+                uint64_t n = 0;
+                for (; i < dp && i < nd; ++i)
+                    n = n * 10 + d[i];
+                for (; i < dp; ++i)
+                    n *= 10;
+                if (shouldRoundUp(dp))
+                    ++n;
+                return n;
+            }
+        };
+
+        // Scales the decimal by powers of two into [0.5, 1), which yields the
+        // binary exponent, then reads off 53 rounded mantissa bits.
+        double decimalToDouble(Decimal& dec)
+        {
+            static const int powtab[] = { 1, 3, 6, 9, 13, 16, 19, 23, 26 };
+            const int kPowtab = (int) (sizeof(powtab) / sizeof(powtab[0]));
+            const int bias = -1023;
+            const int mantbits = 52;
+
+            if (dec.nd == 0)
+                return 0.0;
+            if (dec.dp > 310)
+                return HUGE_VAL;
+            if (dec.dp < -330)
+                return 0.0;
+
+            int exp = 0;
+            while (dec.dp > 0) {
+                int n = dec.dp >= kPowtab ? 27 : powtab[dec.dp];
+                dec.shift(-n);
+                exp += n;
+            }
+            while (dec.dp < 0 || (dec.dp == 0 && dec.d[0] < 5)) {
+                int n = -dec.dp >= kPowtab ? 27 : powtab[-dec.dp];
+                dec.shift(n);
+                exp -= n;
+            }
+            --exp;
+
+            if (exp < bias + 1) {
+                int n = bias + 1 - exp;
+                dec.shift(-n);
+                exp += n;
+            }
+            if (exp - bias >= 0x7ff)
+                return HUGE_VAL;
+
+            dec.shift(1 + mantbits);
+            uint64_t mant = dec.roundedInteger();
+            if (mant == (2ULL << mantbits)) {
+                mant >>= 1;
+                ++exp;
+                if (exp - bias >= 0x7ff)
+                    return HUGE_VAL;
+            }
+            if (!(mant & (1ULL << mantbits)))
+                exp = bias;     // subnormal
+
+            uint64_t bits = (mant & ((1ULL << mantbits) - 1)) | ((uint64_t) ((exp - bias) & 0x7ff) << mantbits);
+            return fromBits(bits);
+        }
+
+        double parseSlow(const char* s, size_t n)
+        {
+            Decimal dec;
+            dec.nd = 0;
+            dec.dp = 0;
+            dec.trunc = false;
+            bool dot = false;
+            int total = 0;      // significant digits seen, kept or not
+            for (size_t i = 0; i < n; ++i) {
+                char c = s[i];
+                if (c == '.') {
+                    if (dot)
+                        break;
+                    dot = true;
+                    dec.dp = total;
+                    continue;
+                }
+                uint8_t digit = (uint8_t) (c - '0');
+                if (digit == 0 && total == 0) {
+                    if (dot)
+                        --dec.dp;
+                    continue;
+                }
+                if (dec.nd < kMaxDigits)
+                    dec.d[dec.nd++] = digit;
+                else if (digit)
+                    dec.trunc = true;
+                ++total;
+            }
+            if (!dot)
+                dec.dp = total;
+            dec.trim();
+            return decimalToDouble(dec);
+        }
+
+        // ---- Formatting -------------------------------------------------
+
+        // Unsigned big integer, little-endian 32-bit limbs. 40 limbs cover the
+        // largest scaled values digit generation needs for any double.
+        struct Big {
+            uint32_t w[40];
+            int n;
+
+            void set(uint64_t v)
+            {
+                n = 0;
+                while (v) {
+                    w[n++] = (uint32_t) v;
+                    v >>= 32;
+                }
+            }
+
+            void mulSmall(uint32_t m)
+            {
+                uint64_t carry = 0;
+                for (int i = 0; i < n; ++i) {
+                    uint64_t t = (uint64_t) w[i] * m + carry;
+                    w[i] = (uint32_t) t;
+                    carry = t >> 32;
+                }
+                if (carry)
+                    w[n++] = (uint32_t) carry;
+            }
+
+            void mulPow10(int k)
+            {
+                for (; k >= 9; k -= 9)
+                    mulSmall(1000000000u);
+                static const uint32_t small[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+                if (k > 0)
+                    mulSmall(small[k]);
+            }
+
+            void shl(int bits)
+            {
+                if (n == 0)
+                    return;
+                int limbs = bits / 32, rest = bits % 32;
+                if (rest) {
+                    uint32_t carry = 0;
+                    for (int i = 0; i < n; ++i) {
+                        uint32_t t = w[i];
+                        w[i] = (t << rest) | carry;
+                        carry = t >> (32 - rest);
+                    }
+                    if (carry)
+                        w[n++] = carry;
+                }
+                if (limbs) {
+                    for (int i = n - 1; i >= 0; --i)
+                        w[i + limbs] = w[i];
+                    for (int i = 0; i < limbs; ++i)
+                        w[i] = 0;
+                    n += limbs;
+                }
+            }
+
+            void sub(const Big& b)
+            {
+                int64_t borrow = 0;
+                for (int i = 0; i < n; ++i) {
+                    int64_t t = (int64_t) w[i] - (i < b.n ? b.w[i] : 0) - borrow;
+                    borrow = t < 0;
+                    w[i] = (uint32_t) (t + (borrow << 32));
+                }
+                while (n > 0 && w[n - 1] == 0)
+                    --n;
+            }
+
+            int divRem(const Big& s)
+            {
+                int d = 0;
+                while (cmp(*this, s) >= 0) {
+                    sub(s);
+                    ++d;
+                }
+                return d;
+            }
+
+            static int cmp(const Big& a, const Big& b)
+            {
+                if (a.n != b.n)
+                    return a.n < b.n ? -1 : 1;
+                for (int i = a.n - 1; i >= 0; --i) {
+                    if (a.w[i] != b.w[i])
+                        return a.w[i] < b.w[i] ? -1 : 1;
+                }
+                return 0;
+            }
+
+            // Sign of (a + b) - c without materializing the sum.
+            static int cmpSum(const Big& a, const Big& b, const Big& c)
+            {
+                Big s;
+                int len = a.n > b.n ? a.n : b.n;
+                uint64_t carry = 0;
+                for (int i = 0; i < len; ++i) {
+                    uint64_t t = (uint64_t) (i < a.n ? a.w[i] : 0) + (i < b.n ? b.w[i] : 0) + carry;
+                    s.w[i] = (uint32_t) t;
+                    carry = t >> 32;
+                }
+                s.n = len;
+                if (carry)
+                    s.w[s.n++] = (uint32_t) carry;
+                return cmp(s, c);
+            }
+        };
+
+        int bitLength(uint64_t v)
+        {
+            int n = 0;
+            while (v) {
+                ++n;
+                v >>= 1;
+            }
+            return n;
+        }
+
+#if defined(__SIZEOF_INT128__)
+        // Same interface as Big over one 128-bit integer, for the common case
+        // where the scaled values stay small.
+        struct Wide {
+            unsigned __int128 v;
+
+            void mulSmall(uint32_t m) { v *= m; }
+            int divRem(const Wide& s) { int d = (int) (v / s.v); v -= s.v * d; return d; }
+            void sub(const Wide& b) { v -= b.v; }
+
+            static int cmp(const Wide& a, const Wide& b)
+            {
+                return a.v < b.v ? -1 : a.v > b.v ? 1 : 0;
+            }
+
+            static int cmpSum(const Wide& a, const Wide& b, const Wide& c)
+            {
+                Wide s = { a.v + b.v };
+                return cmp(s, c);
+            }
+
+            static Wide from(const Big& b)
+            {
+                Wide w = { 0 };
+                for (int i = b.n - 1; i >= 0; --i)
+                    w.v = (w.v << 32) | b.w[i];
+                return w;
+            }
+        };
+#endif
+
+        // Emits digits of r/s until the remainder is within the margins m-
+        // and m+ of an end of the rounding interval, then rounds the last one.
+        template <typename Num>
+        int generateDigits(Num& r, const Num& s, Num& mp, Num& mm, bool even, char* digits)
+        {
+            int nd = 0;
+            for (;;) {
+                r.mulSmall(10);
+                mp.mulSmall(10);
+                mm.mulSmall(10);
+                int d = r.divRem(s);
+                int low = Num::cmp(r, mm);
+                bool tc1 = even ? low <= 0 : low < 0;
+                int high = Num::cmpSum(r, mp, s);
+                bool tc2 = even ? high >= 0 : high > 0;
+                if (!tc1 && !tc2) {
+                    digits[nd++] = (char) ('0' + d);
+                    continue;
+                }
+                if (tc1 && tc2) {
+                    // Both neighbours are in range; take the nearer, ties to even.
+                    int half = Num::cmpSum(r, r, s);
+                    if (half > 0 || (half == 0 && (d & 1)))
+                        ++d;
+                } else if (tc2) {
+                    ++d;
+                }
+                digits[nd++] = (char) ('0' + d);
+                return nd;
+            }
+        }
+
+        // Burger & Dybvig free-format output: the fewest digits d[0..) such
+        // that 0.d x 10^k lies inside (or, for even mantissas, on the edge of)
+        // the rounding interval of f x 2^e.
+        int shortestDigits(uint64_t f, int e, bool unequalGaps, char* digits, int& k)
+        {
+            const bool even = (f & 1) == 0;
+            Big r, s, mp, mm;
+            if (e >= 0) {
+                r.set(f);
+                mp.set(1);
+                mp.shl(e);
+                mm = mp;
+                if (unequalGaps) {
+                    r.shl(e + 2);
+                    s.set(4);
+                    mp.shl(1);
+                } else {
+                    r.shl(e + 1);
+                    s.set(2);
+                }
+            } else {
+                r.set(f);
+                mm.set(1);
+                if (unequalGaps) {
+                    r.shl(2);
+                    s.set(1);
+                    s.shl(2 - e);
+                    mp.set(2);
+                } else {
+                    r.shl(1);
+                    s.set(1);
+                    s.shl(1 - e);
+                    mp.set(1);
+                }
+            }
+
+            // Estimate of ceil(log10(v)); low by at most one, fixed up below.
+            k = (int) ceil((e + bitLength(f) - 1) * 0.30102999566398114 - 1e-10);
+            if (k >= 0) {
+                s.mulPow10(k);
+            } else {
+                r.mulPow10(-k);
+                mp.mulPow10(-k);
+                mm.mulPow10(-k);
+            }
+            int c = Big::cmpSum(r, mp, s);
+            if (even ? c >= 0 : c > 0) {
+                s.mulSmall(10);
+                ++k;
+            }
+
+#if defined(__SIZEOF_INT128__)
+            // Everything stays below 10 s, so 96 bits of s leave headroom.
+            if (s.n <= 3) {
+                Wide wr = Wide::from(r), ws = Wide::from(s), wp = Wide::from(mp), wm = Wide::from(mm);
+                return generateDigits(wr, ws, wp, wm, even, digits);
+            }
+#endif
+            return generateDigits(r, s, mp, mm, even, digits);
+        }
+
+        size_t writeUnsigned(uint64_t v, char* p)
+        {
+            char tmp[20];
+            int n = 0;
+            do {
+                tmp[n++] = (char) ('0' + v % 10);
+                v /= 10;
+            } while (v);
+            for (int i = 0; i < n; ++i)
+                p[i] = tmp[n - 1 - i];
+            return (size_t) n;
+        }
+
+    }
+
+    double parseLiteral(const char* s, size_t n)
+    {
+        // Up to 19 significant digits fit in a uint64. If they are all there
+        // is and the mantissa is exact in a double, one multiplication or
+        // division by an exact power of ten is correctly rounded (Clinger).
+        uint64_t w = 0;
+        int sig = 0;
+        int exp10 = 0;
+        bool dot = false;
+        bool exact = true;
+        for (size_t i = 0; i < n; ++i) {
+            char c = s[i];
+            if (c == '.') {
+                if (dot)
+                    break;
+                dot = true;
+                continue;
+            }
+            unsigned digit = (unsigned) (c - '0');
+            if (sig == 0 && digit == 0) {
+                if (dot)
+                    --exp10;
+                continue;
+            }
+            if (sig < 19) {
+                w = w * 10 + digit;
+                ++sig;
+                if (dot)
+                    --exp10;
+            } else {
+                if (!dot)
+                    ++exp10;
+                if (digit)
+                    exact = false;
+            }
+        }
+        if (w == 0)
+            return 0.0;
+        if (exact && w <= kExactMantissa) {
+            if (exp10 >= 0 && exp10 <= 22)
+                return (double) w * kExactPow10[exp10];
+            if (exp10 < 0 && exp10 >= -22)
+                return (double) w / kExactPow10[-exp10];
+        }
+
+        // Past 19 digits the value lies in [w, w + 1) x 10^exp10; if both
+        // ends round to the same double, so does the literal.
+        double v, upper;
+        if (eiselLemire(w, exp10, v) && (exact || (eiselLemire(w + 1, exp10, upper) && v == upper)))
+            return v;
+        return parseSlow(s, n);
+    }
+
+    size_t formatShortest(double v, char* buf)
+    {
+        char* p = buf;
+        if (v != v) {
+            memcpy(buf, "nan", 4);
+            return 3;
+        }
+        if (signbit(v)) {
+            *p++ = '-';
+            v = -v;
+        }
+        if (isinf(v)) {
+            memcpy(p, "inf", 4);
+            return (size_t) (p - buf) + 3;
+        }
+
+        // Integers below 2^53 are their own shortest form.
+        if (v < 9007199254740992.0 && v == (double) (uint64_t) v) {
+            p += writeUnsigned((uint64_t) v, p);
+            *p = '\0';
+            return (size_t) (p - buf);
+        }
+
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        uint64_t frac = bits & ((1ULL << 52) - 1);
+        int bexp = (int) (bits >> 52);
+        uint64_t f = bexp ? frac | (1ULL << 52) : frac;
+        int e = bexp ? bexp - 1075 : -1074;
+
+        char digits[20];
+        int k;
+        int nd = shortestDigits(f, e, frac == 0 && bexp > 1, digits, k);
+
+        // digits x 10^(k - nd); plain decimal for 1e-6 <= |v| < 1e21.
+        if (k > -6 && k <= 21) {
+            if (k <= 0) {
+                *p++ = '0';
+                *p++ = '.';
+                for (int i = 0; i < -k; ++i)
+                    *p++ = '0';
+                memcpy(p, digits, nd);
+                p += nd;
+            } else if (k >= nd) {
+                memcpy(p, digits, nd);
+                p += nd;
+                for (int i = nd; i < k; ++i)
+                    *p++ = '0';
+            } else {
+                memcpy(p, digits, k);
+                p += k;
+                *p++ = '.';
+                memcpy(p, digits + k, nd - k);
+                p += nd - k;
+            }
+        } else {
+            *p++ = digits[0];
+            if (nd > 1) {
+                *p++ = '.';
+                memcpy(p, digits + 1, nd - 1);
+                p += nd - 1;
+            }
+            int x = k - 1;
+            *p++ = 'e';
+            *p++ = x < 0 ? '-' : '+';
+            p += writeUnsigned((uint64_t) (x < 0 ? -x : x), p);
+        }
+        *p = '\0';
+        return (size_t) (p - buf);
+    }
+
+}
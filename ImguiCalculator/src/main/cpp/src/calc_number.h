@@ -0,0 +1,37 @@
+//
+// Exact, allocation-free conversions between calculator literals and doubles.
+//
+// Neither direction depends on the C locale or touches the heap. Parsing is
+// correctly rounded: literals one exact multiplication or division away from
+// their value are done in a single step, most others by multiplying the
+// leading 19 digits with a 128-bit power of ten (Eisel-Lemire), and the few
+// that remain ambiguous go through a fixed-size decimal buffer shifted by
+// powers of two until the binary exponent and mantissa fall out. Formatting
+// produces the shortest digit string that parses back to the same double,
+// generating digits with exact integer arithmetic that is 128 bits wide for
+// everyday magnitudes and falls back to bignums for the extremes.
+//
+
+#ifndef IMGUI_ANDROID_CALC_NUMBER_H
+#define IMGUI_ANDROID_CALC_NUMBER_H
+
+#include <cstddef>
+
+namespace calc {
+
+    // Value of a run of digits and dots: the longest valid prefix wins (a
+    // second point ends it) and an empty run is zero.
+    double parseLiteral(const char* s, size_t n);
+
+    // Enough for any double in formatShortest's notation, plus the NUL.
+    static const size_t kFormatBufferSize = 32;
+
+    // Writes the shortest round-trip text for v into buf (kFormatBufferSize
+    // bytes) and returns its length. Magnitudes from 1e-6 up to 1e21 are
+    // written in plain decimal, everything else as d.ddde+NN. NaN and the
+    // infinities come out as "nan", "inf" and "-inf".
+    size_t formatShortest(double v, char* buf);
+
+}
+
+#endif //IMGUI_ANDROID_CALC_NUMBER_H
@@ -0,0 +1,403 @@
+//
+// Tokenize-once bytecode for calculator expressions.
+//
+#include "calc_program.h"
+#include "calc_number.h"
+#include "calc_simd.h"
+#include "calc_trig.h"
+#include <algorithm>
+#include <math.h>
+
+namespace calc {
+
+    double applyUnary(Opcode op, double a)
+    {
+        switch (op) {
+            // From zero, as the old left-to-right evaluator did, so "-0" is 0.
+            case OP_NEG: return 0.0 - a;
+            case OP_SIN: return sinDeg(a);
+            case OP_COS: return cosDeg(a);
+            case OP_TAN: return tanDeg(a);
+            default: return a;
+        }
+    }
+
+    double applyBinary(Opcode op, double a, double b)
+    {
+        switch (op) {
+            case OP_ADD: return a + b;
+            case OP_SUB: return a - b;
+            case OP_MUL: return a * b;
+            case OP_DIV: return a / b;
+            default: return b;
+        }
+    }
+
+    namespace {
+
+        enum TokenKind {
+            TOK_END,
+            TOK_NUM,
+            TOK_VAR,
+            TOK_FUNC,
+            TOK_OP,
+            TOK_LPAREN,
+            TOK_RPAREN,
+            TOK_ERROR
+        };
+
+        struct Token {
+            TokenKind kind;
+            Opcode op;      // TOK_FUNC / TOK_OP
+            uint8_t var;    // TOK_VAR
+            uint32_t pos;
+            double value;   // TOK_NUM
+        };
+
+        class Lexer {
+        public:
+            Lexer(const char* src, size_t len) : s(src), end(src + len), p(src) {}
+
+            void next(Token& t)
+            {
+                while (p < end && (*p == ' ' || *p == '\t'))
+                    ++p;
+                t.pos = (uint32_t) (p - s);
+                if (p == end) {
+                    t.kind = TOK_END;
+                    return;
+                }
+                char ch = *p;
+                if ((ch >= '0' && ch <= '9') || ch == '.') {
+                    const char* start = p;
+                    while (p < end && ((*p >= '0' && *p <= '9') || *p == '.'))
+                        ++p;
+                    t.kind = TOK_NUM;
+                    t.value = parseLiteral(start, p - start);
+                    return;
+                }
+                if (ch >= 'x' && ch <= 'z') {
+                    t.kind = TOK_VAR;
+                    t.var = (uint8_t) (ch - 'x');
+                    ++p;
+                    return;
+                }
+                t.kind = TOK_OP;
+                switch (ch) {
+                    case '+': t.op = OP_ADD; ++p; return;
+                    case '-': t.op = OP_SUB; ++p; return;
+                    case 'X':
+                    case '*': t.op = OP_MUL; ++p; return;
+                    case '/': t.op = OP_DIV; ++p; return;
+                    case '(': t.kind = TOK_LPAREN; ++p; return;
+                    case ')': t.kind = TOK_RPAREN; ++p; return;
+                    default: break;
+                }
+                t.kind = TOK_FUNC;
+                if (matchWord("sin")) { t.op = OP_SIN; return; }
+                if (matchWord("cos")) { t.op = OP_COS; return; }
+                if (matchWord("tan")) { t.op = OP_TAN; return; }
+                t.kind = TOK_ERROR;
+            }
+
+        private:
+            bool matchWord(const char* w)
+            {
+                const char* q = p;
+                for (; *w; ++w, ++q) {
+                    if (q == end || *q != *w)
+                        return false;
+                }
+                p = q;
+                return true;
+            }
+
+            const char* s;
+            const char* end;
+            const char* p;
+        };
+
+        struct PendingOp {
+            Opcode op;
+            bool paren;     // an open parenthesis rather than an operator
+            uint32_t pos;
+        };
+
+        // Shunting-yard state. Operators wait on a fixed-size stack until
+        // something of lower precedence (or the end) releases them into the
+        // program in postfix order.
+        class Compiler {
+        public:
+            explicit Compiler(std::vector<Instr>& out) : code(out), nops(0), depth(0), maxDepth(0) {}
+
+            bool push(Opcode op, bool paren, uint32_t pos)
+            {
+                if (nops == kMaxNesting)
+                    return false;
+                PendingOp p = { op, paren, pos };
+                ops[nops++] = p;
+                return true;
+            }
+
+            bool emitValue(Opcode op, uint8_t arg, uint32_t pos, double value)
+            {
+                if (depth == kMaxStack)
+                    return false;
+                Instr in = { op, arg, pos, value };
+                code.push_back(in);
+                maxDepth = std::max(maxDepth, ++depth);
+                return true;
+            }
+
+            // Releases pending operators that bind at least as tight as prec;
+            // prec 0 releases everything down to the innermost open paren.
+            void reduce(int prec)
+            {
+                while (nops && !ops[nops - 1].paren && precedence(ops[nops - 1].op) >= prec) {
+                    const PendingOp& p = ops[--nops];
+                    Instr in = { p.op, 0, p.pos, 0.0 };
+                    code.push_back(in);
+                    if (!isUnary(p.op))
+                        --depth;
+                }
+            }
+
+            bool closeParen()
+            {
+                reduce(0);
+                if (!nops)
+                    return false;
+                --nops;
+                return true;
+            }
+
+            void finish()
+            {
+                // Parentheses still open at the end close themselves.
+                for (;;) {
+                    reduce(0);
+                    if (!nops)
+                        break;
+                    --nops;
+                }
+            }
+
+            std::vector<Instr>& code;
+            PendingOp ops[kMaxNesting];
+            int nops;
+            int depth;
+            int maxDepth;
+        };
+
+    }
+
+    bool Program::compile(const char* src, size_t len)
+    {
+        code_.clear();
+        // Most tokens yield one instruction; the vector only grows past this
+        // for inputs full of implicit zeros, and keeps its capacity after.
+        code_.reserve(len + 1);
+        maxDepth_ = 0;
+        errorPos_ = 0;
+        varMask_ = 0;
+
+        Lexer lex(src, len);
+        Token t;
+        lex.next(t);
+        Compiler c(code_);
+        bool afterOperand = false;
+        bool ok = true;
+
+        for (;;) {
+            const uint32_t at = t.pos;
+            if (!afterOperand) {
+                // Expecting an operand. A missing one counts as zero, as it
+                // always has, so "X5", "5+" and "()" all evaluate.
+                switch (t.kind) {
+                    case TOK_NUM:
+                        ok = c.emitValue(OP_CONST, 0, t.pos, t.value);
+                        afterOperand = true;
+                        lex.next(t);
+                        break;
+                    case TOK_VAR:
+                        ok = c.emitValue(OP_VAR, t.var, t.pos, 0.0);
+                        varMask_ |= 1u << t.var;
+                        afterOperand = true;
+                        lex.next(t);
+                        break;
+                    case TOK_FUNC:
+                        ok = c.push(t.op, false, t.pos);
+                        lex.next(t);
+                        break;
+                    case TOK_LPAREN:
+                        ok = c.push(OP_ADD, true, t.pos);
+                        lex.next(t);
+                        break;
+                    case TOK_OP:
+                        if (t.op == OP_SUB) {
+                            ok = c.push(OP_NEG, false, t.pos);
+                            lex.next(t);
+                        } else if (t.op == OP_ADD) {
+                            lex.next(t);
+                        } else {
+                            ok = c.emitValue(OP_CONST, 0, t.pos, 0.0);
+                            afterOperand = true;
+                        }
+                        break;
+                    case TOK_RPAREN:
+                    case TOK_END:
+                        ok = c.emitValue(OP_CONST, 0, t.pos, 0.0);
+                        afterOperand = true;
+                        break;
+                    default:
+                        ok = false;
+                        break;
+                }
+            } else {
+                if (t.kind == TOK_END) {
+                    c.finish();
+                    break;
+                }
+                switch (t.kind) {
+                    case TOK_OP:
+                        c.reduce(precedence(t.op));
+                        ok = c.push(t.op, false, t.pos);
+                        afterOperand = false;
+                        lex.next(t);
+                        break;
+                    case TOK_RPAREN:
+                        ok = c.closeParen();
+                        lex.next(t);
+                        break;
+                    default:
+                        ok = false;
+                        break;
+                }
+            }
+            if (!ok) {
+                errorPos_ = at;
+                code_.clear();
+                return false;
+            }
+        }
+        maxDepth_ = c.maxDepth;
+        return true;
+    }
+
+    double Program::run(const double* vars) const
+    {
+        if (code_.empty())
+            return NAN;
+
+        double stack[kMaxStack];
+        int sp = 0;
+        for (std::vector<Instr>::const_iterator it = code_.begin(); it != code_.end(); ++it) {
+            switch (it->op) {
+                case OP_CONST: stack[sp++] = it->value; break;
+                case OP_VAR: stack[sp++] = vars ? vars[it->arg] : 0.0; break;
+                case OP_ADD: --sp; stack[sp - 1] += stack[sp]; break;
+                case OP_SUB: --sp; stack[sp - 1] -= stack[sp]; break;
+                case OP_MUL: --sp; stack[sp - 1] *= stack[sp]; break;
+                case OP_DIV: --sp; stack[sp - 1] /= stack[sp]; break;
+                case OP_NEG:
+                case OP_SIN:
+                case OP_COS:
+                case OP_TAN: stack[sp - 1] = applyUnary(it->op, stack[sp - 1]); break;
+            }
+        }
+        return stack[0];
+    }
+
+    void Program::evaluate(const double* x, double* out, size_t n) const
+    {
+        const double* columns[kMaxVars] = { x, NULL, NULL };
+        evaluate(columns, out, n);
+    }
+
+    namespace {
+
+        // Points evaluated per pass over the program. Large enough to amortize
+        // instruction dispatch, small enough that the operand stack for a
+        // typical program stays in L1.
+        const size_t kBlock = 256;
+
+        void applyUnaryColumn(Opcode op, double* a, size_t n)
+        {
+            const TrigKernels& trig = trigKernels();
+            switch (op) {
+                case OP_SIN: trig.sinDeg(a, n); break;
+                case OP_COS: trig.cosDeg(a, n); break;
+                case OP_TAN: trig.tanDeg(a, n); break;
+                default:
+                    for (size_t i = 0; i < n; ++i)
+                        a[i] = applyUnary(op, a[i]);
+                    break;
+            }
+        }
+
+        bool isBinary(Opcode op)
+        {
+            return op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV;
+        }
+
+    }
+
+    void Program::evaluate(const double* const* columns, double* out, size_t n) const
+    {
+        if (code_.empty()) {
+            std::fill(out, out + n, (double) NAN);
+            return;
+        }
+
+        const ColumnKernels& k = columnKernels();
+        // One column of kBlock doubles per stack slot; the only allocation of
+        // the sweep, however many points it covers.
+        std::vector<double> scratch(maxDepth_ * kBlock);
+        const Instr* code = &code_[0];
+        const size_t count = code_.size();
+
+        for (size_t base = 0; base < n; base += kBlock) {
+            const size_t m = std::min(kBlock, n - base);
+            double* stack = &scratch[0];
+            size_t sp = 0;      // stack slots in use; the top one is stack + (sp - 1) * kBlock
+            for (size_t pc = 0; pc < count; ++pc) {
+                const Instr& in = code[pc];
+                double* top = sp ? stack + (sp - 1) * kBlock : stack;
+                switch (in.op) {
+                    case OP_CONST:
+                        // A literal feeding a binary operator becomes a
+                        // broadcast operand instead of a filled column.
+                        if (pc + 1 < count && isBinary(code[pc + 1].op)) {
+                            ++pc;
+                            switch (code[pc].op) {
+                                case OP_ADD: k.addScalar(top, in.value, m); break;
+                                case OP_SUB: k.subScalar(top, in.value, m); break;
+                                case OP_MUL: k.mulScalar(top, in.value, m); break;
+                                default:     k.divScalar(top, in.value, m); break;
+                            }
+                        } else {
+                            k.fill(stack + sp++ * kBlock, in.value, m);
+                        }
+                        break;
+                    case OP_VAR:
+                        if (columns[in.arg])
+                            std::copy(columns[in.arg] + base, columns[in.arg] + base + m, stack + sp * kBlock);
+                        else
+                            k.fill(stack + sp * kBlock, 0.0, m);
+                        ++sp;
+                        break;
+                    case OP_ADD: --sp; k.add(top - kBlock, top, m); break;
+                    case OP_SUB: --sp; k.sub(top - kBlock, top, m); break;
+                    case OP_MUL: --sp; k.mul(top - kBlock, top, m); break;
+                    case OP_DIV: --sp; k.div(top - kBlock, top, m); break;
+                    case OP_NEG:
+                    case OP_SIN:
+                    case OP_COS:
+                    case OP_TAN: applyUnaryColumn(in.op, top, m); break;
+                }
+            }
+            std::copy(&scratch[0], &scratch[0] + m, out + base);
+        }
+    }
+
+}
@@ -0,0 +1,121 @@
+//
+// Tokenize-once bytecode for calculator expressions.
+//
+// An expression is lexed in a single pass over a (pointer, length) pair and
+// compiled into a flat stack-machine program. Evaluating the program touches
+// no heap memory, so the cost of calEverything is linear in the input length.
+//
+// Operators follow the usual precedence: functions and unary minus bind
+// tightest, then X and /, then + and -. Parentheses group, and any left open
+// at the end are closed implicitly. sin, cos and tan take degrees (see
+// calc_trig.h). The parser is shunting-yard over a
+// fixed-capacity operator stack, so nesting depth is bounded and never
+// recurses or allocates.
+//
+// Expressions may refer to the variables x, y and z. A compiled program can be
+// swept over columns of variable values, one instruction at a time over a
+// block of points, which keeps the interpreter out of the inner loop and lets
+// the arithmetic and the trigonometric functions run in SIMD lanes.
+//
+
+#ifndef IMGUI_ANDROID_CALC_PROGRAM_H
+#define IMGUI_ANDROID_CALC_PROGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace calc {
+
+    enum Opcode : uint8_t {
+        OP_CONST = 0,   // push Instr::value
+        OP_VAR,         // push variable Instr::arg
+        OP_ADD,
+        OP_SUB,
+        OP_MUL,
+        OP_DIV,
+        OP_NEG,         // unary minus
+        OP_SIN,         // unary, argument in degrees
+        OP_COS,
+        OP_TAN
+    };
+
+    struct Instr {
+        Opcode op;
+        uint8_t arg;    // variable index of OP_VAR
+        uint32_t pos;   // source offset of the token that produced this instruction
+        double value;   // operand of OP_CONST
+    };
+
+    // Largest operand stack a program may need. The compiler rejects anything
+    // deeper, so run() can keep its stack in a fixed-size local array.
+    static const int kMaxStack = 256;
+
+    // Most operators and open parentheses that may be pending at once.
+    static const int kMaxNesting = 256;
+
+    // Variables are x, y, z in that order.
+    static const int kMaxVars = 3;
+
+    // Scalar semantics of the operators, shared by every evaluator so they
+    // all agree to the last bit.
+    double applyUnary(Opcode op, double a);
+    double applyBinary(Opcode op, double a, double b);
+
+    inline bool isUnary(Opcode op) { return op >= OP_NEG; }
+
+    // Binding strength of an operator; higher binds tighter. Operators of
+    // equal strength associate to the left.
+    inline int precedence(Opcode op)
+    {
+        switch (op) {
+            case OP_ADD:
+            case OP_SUB: return 1;
+            case OP_MUL:
+            case OP_DIV: return 2;
+            case OP_NEG: return 3;
+            default: return 4;
+        }
+    }
+
+    class Program {
+    public:
+        Program() : errorPos_(0), maxDepth_(0), varMask_(0) {}
+
+        // Lexes and compiles len bytes of src. On failure returns false and
+        // errorPos() points at the offending character. The instruction buffer
+        // is reused between calls, so recompiling allocates nothing once it has
+        // grown to fit the longest expression seen.
+        bool compile(const char* src, size_t len);
+
+        // Evaluates the last successfully compiled program at one point; vars
+        // holds x, y, z, or is NULL to read them all as zero. NaN if the
+        // compile failed.
+        double run(const double* vars = NULL) const;
+
+        // Evaluates the program at n points with x taken from x[i]; y and z
+        // read as zero.
+        void evaluate(const double* x, double* out, size_t n) const;
+
+        // Evaluates the program at n points. columns[v] is the column for
+        // variable v; a NULL column reads as zero, and columns for variables
+        // the program does not use (see usesVar) are never touched. Results
+        // are bit-identical to calling run per point.
+        void evaluate(const double* const* columns, double* out, size_t n) const;
+
+        const std::vector<Instr>& code() const { return code_; }
+        bool ok() const { return !code_.empty(); }
+        size_t errorPos() const { return errorPos_; }
+        int maxDepth() const { return maxDepth_; }
+        bool usesVar(int v) const { return (varMask_ >> v) & 1; }
+
+    private:
+        std::vector<Instr> code_;
+        size_t errorPos_;
+        int maxDepth_;
+        unsigned varMask_;
+    };
+
+}
+
+#endif //IMGUI_ANDROID_CALC_PROGRAM_H
@@ -0,0 +1,165 @@
+//
+// Column kernels used by the vectorized program evaluator.
+//
+#include "calc_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CALC_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace calc {
+
+    namespace {
+
+        // Scalar versions double as the tail loop of the wide ones.
+
+        void addScalarLoop(double* a, const double* b, size_t n) { for (size_t i = 0; i < n; ++i) a[i] += b[i]; }
+        void subScalarLoop(double* a, const double* b, size_t n) { for (size_t i = 0; i < n; ++i) a[i] -= b[i]; }
+        void mulScalarLoop(double* a, const double* b, size_t n) { for (size_t i = 0; i < n; ++i) a[i] *= b[i]; }
+        void divScalarLoop(double* a, const double* b, size_t n) { for (size_t i = 0; i < n; ++i) a[i] /= b[i]; }
+
+        void addsScalarLoop(double* a, double c, size_t n) { for (size_t i = 0; i < n; ++i) a[i] += c; }
+        void subsScalarLoop(double* a, double c, size_t n) { for (size_t i = 0; i < n; ++i) a[i] -= c; }
+        void mulsScalarLoop(double* a, double c, size_t n) { for (size_t i = 0; i < n; ++i) a[i] *= c; }
+        void divsScalarLoop(double* a, double c, size_t n) { for (size_t i = 0; i < n; ++i) a[i] /= c; }
+
+        void fillScalarLoop(double* a, double c, size_t n) { for (size_t i = 0; i < n; ++i) a[i] = c; }
+
+        const ColumnKernels kScalar = {
+            "scalar",
+            addScalarLoop, subScalarLoop, mulScalarLoop, divScalarLoop,
+            addsScalarLoop, subsScalarLoop, mulsScalarLoop, divsScalarLoop,
+            fillScalarLoop
+        };
+
+#ifdef CALC_SIMD_X86
+
+#define CALC_SSE2_BINARY(NAME, INTRIN, OP)                                  \
+        __attribute__((target("sse2")))                                     \
+        void NAME(double* a, const double* b, size_t n)                     \
+        {                                                                   \
+            size_t i = 0;                                                   \
+            for (; i + 2 <= n; i += 2)                                      \
+                _mm_storeu_pd(a + i, INTRIN(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))); \
+            for (; i < n; ++i)                                              \
+                a[i] OP b[i];                                               \
+        }
+
+#define CALC_SSE2_SCALAR(NAME, INTRIN, OP)                                  \
+        __attribute__((target("sse2")))                                     \
+        void NAME(double* a, double c, size_t n)                            \
+        {                                                                   \
+            __m128d vc = _mm_set1_pd(c);                                    \
+            size_t i = 0;                                                   \
+            for (; i + 2 <= n; i += 2)                                      \
+                _mm_storeu_pd(a + i, INTRIN(_mm_loadu_pd(a + i), vc));      \
+            for (; i < n; ++i)                                              \
+                a[i] OP c;                                                  \
+        }
+
+        CALC_SSE2_BINARY(addSse2, _mm_add_pd, +=)
+        CALC_SSE2_BINARY(subSse2, _mm_sub_pd, -=)
+        CALC_SSE2_BINARY(mulSse2, _mm_mul_pd, *=)
+        CALC_SSE2_BINARY(divSse2, _mm_div_pd, /=)
+        CALC_SSE2_SCALAR(addsSse2, _mm_add_pd, +=)
+        CALC_SSE2_SCALAR(subsSse2, _mm_sub_pd, -=)
+        CALC_SSE2_SCALAR(mulsSse2, _mm_mul_pd, *=)
+        CALC_SSE2_SCALAR(divsSse2, _mm_div_pd, /=)
+
+        __attribute__((target("sse2")))
+        void fillSse2(double* a, double c, size_t n)
+        {
+            __m128d vc = _mm_set1_pd(c);
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2)
+                _mm_storeu_pd(a + i, vc);
+            for (; i < n; ++i)
+                a[i] = c;
+        }
+
+#define CALC_AVX2_BINARY(NAME, INTRIN, OP)                                  \
+        __attribute__((target("avx2")))                                     \
+        void NAME(double* a, const double* b, size_t n)                     \
+        {                                                                   \
+            size_t i = 0;                                                   \
+            for (; i + 4 <= n; i += 4)                                      \
+                _mm256_storeu_pd(a + i, INTRIN(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); \
+            for (; i < n; ++i)                                              \
+                a[i] OP b[i];                                               \
+        }
+
+#define CALC_AVX2_SCALAR(NAME, INTRIN, OP)                                  \
+        __attribute__((target("avx2")))                                     \
+        void NAME(double* a, double c, size_t n)                            \
+        {                                                                   \
+            __m256d vc = _mm256_set1_pd(c);                                 \
+            size_t i = 0;                                                   \
+            for (; i + 4 <= n; i += 4)                                      \
+                _mm256_storeu_pd(a + i, INTRIN(_mm256_loadu_pd(a + i), vc)); \
+            for (; i < n; ++i)                                              \
+                a[i] OP c;                                                  \
+        }
+
+        CALC_AVX2_BINARY(addAvx2, _mm256_add_pd, +=)
+        CALC_AVX2_BINARY(subAvx2, _mm256_sub_pd, -=)
+        CALC_AVX2_BINARY(mulAvx2, _mm256_mul_pd, *=)
+        CALC_AVX2_BINARY(divAvx2, _mm256_div_pd, /=)
+        CALC_AVX2_SCALAR(addsAvx2, _mm256_add_pd, +=)
+        CALC_AVX2_SCALAR(subsAvx2, _mm256_sub_pd, -=)
+        CALC_AVX2_SCALAR(mulsAvx2, _mm256_mul_pd, *=)
+        CALC_AVX2_SCALAR(divsAvx2, _mm256_div_pd, /=)
+
+        __attribute__((target("avx2")))
+        void fillAvx2(double* a, double c, size_t n)
+        {
+            __m256d vc = _mm256_set1_pd(c);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+                _mm256_storeu_pd(a + i, vc);
+            for (; i < n; ++i)
+                a[i] = c;
+        }
+
+        const ColumnKernels kSse2 = {
+            "sse2",
+            addSse2, subSse2, mulSse2, divSse2,
+            addsSse2, subsSse2, mulsSse2, divsSse2,
+            fillSse2
+        };
+
+        const ColumnKernels kAvx2 = {
+            "avx2",
+            addAvx2, subAvx2, mulAvx2, divAvx2,
+            addsAvx2, subsAvx2, mulsAvx2, divsAvx2,
+            fillAvx2
+        };
+
+        const ColumnKernels& pickKernels()
+        {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return kAvx2;
+            if (__builtin_cpu_supports("sse2"))
+                return kSse2;
+            return kScalar;
+        }
+
+#else
+
+        const ColumnKernels& pickKernels()
+        {
+            return kScalar;
+        }
+
+#endif
+
+    }
+
+    const ColumnKernels& columnKernels()
+    {
+        static const ColumnKernels& kernels = pickKernels();
+        return kernels;
+    }
+
+}
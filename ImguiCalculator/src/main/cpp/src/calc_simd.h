@@ -0,0 +1,40 @@
+//
+// Column kernels used by the vectorized program evaluator.
+//
+// Every kernel performs exactly the IEEE operation the scalar interpreter
+// would (no FMA contraction, no reassociation), so a column evaluated here is
+// bit-identical to evaluating each point with Program::run.
+//
+
+#ifndef IMGUI_ANDROID_CALC_SIMD_H
+#define IMGUI_ANDROID_CALC_SIMD_H
+
+#include <cstddef>
+
+namespace calc {
+
+    struct ColumnKernels {
+        const char* name;   // "avx2", "sse2" or "scalar"
+
+        // a[i] = a[i] op b[i]
+        void (*add)(double* a, const double* b, size_t n);
+        void (*sub)(double* a, const double* b, size_t n);
+        void (*mul)(double* a, const double* b, size_t n);
+        void (*div)(double* a, const double* b, size_t n);
+
+        // a[i] = a[i] op c
+        void (*addScalar)(double* a, double c, size_t n);
+        void (*subScalar)(double* a, double c, size_t n);
+        void (*mulScalar)(double* a, double c, size_t n);
+        void (*divScalar)(double* a, double c, size_t n);
+
+        // a[i] = c
+        void (*fill)(double* a, double c, size_t n);
+    };
+
+    // The widest kernel set this CPU supports, picked once on first use.
+    const ColumnKernels& columnKernels();
+
+}
+
+#endif //IMGUI_ANDROID_CALC_SIMD_H
@@ -0,0 +1,81 @@
+//
+// Bounded single-producer, single-consumer queue.
+//
+// One thread pushes, one thread pops, and neither ever blocks or takes a
+// lock: each side owns one index and publishes it with a release store that
+// the other side reads with an acquire load. The indices sit on their own
+// cache lines, next to the owner's cached copy of the other side's index,
+// so a push or pop touches the shared line only when the cached copy says
+// the queue looks full or empty. Slots are constructed once and reused;
+// items are moved in and out of them.
+//
+
+#ifndef IMGUI_ANDROID_CALC_SPSC_H
+#define IMGUI_ANDROID_CALC_SPSC_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace calc {
+
+    template <typename T, size_t N>
+    class SpscQueue {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    public:
+        SpscQueue() : tail_(0), headCache_(0), head_(0), tailCache_(0) {}
+
+        // Producer only. Moves from item and returns true, or returns false
+        // and leaves item alone if the queue is full.
+        bool push(T& item)
+        {
+            size_t t = tail_.load(std::memory_order_relaxed);
+            if (t - headCache_ == N) {
+                headCache_ = head_.load(std::memory_order_acquire);
+                if (t - headCache_ == N)
+                    return false;
+            }
+            slots_[t & (N - 1)] = std::move(item);
+            tail_.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only. False if the queue is empty.
+        bool pop(T& item)
+        {
+            size_t h = head_.load(std::memory_order_relaxed);
+            if (h == tailCache_) {
+                tailCache_ = tail_.load(std::memory_order_acquire);
+                if (h == tailCache_)
+                    return false;
+            }
+            item = std::move(slots_[h & (N - 1)]);
+            head_.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Either side; a snapshot that may be stale by the time it returns.
+        bool empty() const
+        {
+            return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+        }
+
+        static size_t capacity() { return N; }
+
+    private:
+        // Producer's line.
+        std::atomic<size_t> tail_;
+        size_t headCache_;
+        char pad0_[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+        // Consumer's line.
+        std::atomic<size_t> head_;
+        size_t tailCache_;
+        char pad1_[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+        T slots_[N];
+    };
+
+}
+
+#endif //IMGUI_ANDROID_CALC_SPSC_H
@@ -0,0 +1,411 @@
+//
+// Trigonometric functions of angles in degrees.
+//
+#include "calc_trig.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CALC_TRIG_X86 1
+#include <immintrin.h>
+#endif
+
+namespace calc {
+
+    namespace {
+
+        enum TrigFn { TRIG_SIN, TRIG_COS, TRIG_TAN };
+
+        // Below this magnitude x / 90 rounds to an integer with the 1.5 * 2^52
+        // trick and x - 90q is exact. Larger arguments (all of them integers)
+        // are first taken modulo 360, which fmod does exactly.
+        const double kReduceLimit = 4503599627370496.0;      // 2^52
+        const double kRoundMagic = 6755399441055744.0;       // 1.5 * 2^52
+        const double kInv90 = 1.0 / 90.0;
+
+        // pi / 180 = kDegHi + kDegLo, and kDegHi = kDegHiHi + kDegHiLo with
+        // 26 significant bits in each part, for the exact product r * kDegHi.
+        const double kDegHi = 0.017453292519943295;
+        const double kDegLo = 2.9486522708701687e-19;
+        const double kDegHiHi = 0.01745329238474369;
+        const double kDegHiLo = 1.3519960498364902e-10;
+        const double kSplit = 134217729.0;                   // 2^27 + 1
+
+        // Taylor coefficients; on |x| <= pi/4 the first omitted terms are
+        // far below half an ulp.
+        const double kS1 = -1.0 / 6.0;
+        const double kS2 = 1.0 / 120.0;
+        const double kS3 = -1.0 / 5040.0;
+        const double kS4 = 1.0 / 362880.0;
+        const double kS5 = -1.0 / 39916800.0;
+        const double kS6 = 1.0 / 6227020800.0;
+        const double kS7 = -1.0 / 1307674368000.0;
+        const double kS8 = 1.0 / 355687428096000.0;
+        const double kC1 = 1.0 / 24.0;
+        const double kC2 = -1.0 / 720.0;
+        const double kC3 = 1.0 / 40320.0;
+        const double kC4 = -1.0 / 3628800.0;
+        const double kC5 = 1.0 / 479001600.0;
+        const double kC6 = -1.0 / 87178291200.0;
+        const double kC7 = 1.0 / 20922789888000.0;
+        const double kC8 = -1.0 / 6402373705728000.0;
+
+        // Correctly rounded values at the remainders the table answers.
+        const double kCos30 = 0.8660254037844386;            // sqrt(3) / 2
+        const double kCos45 = 0.7071067811865476;            // sqrt(2) / 2
+        const double kTan30 = 0.5773502691896257;            // 1 / sqrt(3)
+        const double kCot30 = 1.7320508075688772;            // sqrt(3)
+
+        // sin and cos of hi + lo radians, |hi + lo| <= pi/4 and |lo| tiny
+        // next to hi; the tail enters through the first-order terms.
+        inline void sinCosKernel(double hi, double lo, double& s, double& c)
+        {
+            double z = hi * hi;
+            double v = z * hi;
+            double ps = kS2 + z * (kS3 + z * (kS4 + z * (kS5 + z * (kS6 + z * (kS7 + z * kS8)))));
+            s = hi - ((z * (0.5 * lo - v * ps) - lo) - v * kS1);
+            double pc = z * (kC1 + z * (kC2 + z * (kC3 + z * (kC4 + z * (kC5 + z * (kC6 + z * (kC7 + z * kC8)))))));
+            double hz = 0.5 * z;
+            double w = 1.0 - hz;
+            c = w + (((1.0 - w) - hz) + (z * pc - hi * lo));
+        }
+
+        template <TrigFn F>
+        double trigScalar(double x)
+        {
+            if (!(fabs(x) < kReduceLimit))
+                x = fmod(x, 360.0);     // NaN for NaN and the infinities
+            double t = x * kInv90 + kRoundMagic;
+            uint64_t bits;
+            memcpy(&bits, &t, sizeof bits);
+            unsigned quadrant = (unsigned) bits & 3;
+            double q = t - kRoundMagic;
+            double r = x - q * 90.0;
+
+            // r * pi/180 as hi + lo: Dekker's product with kDegHi plus the
+            // low part of the constant.
+            double hi = r * kDegHi;
+            double rt = r * kSplit;
+            double rHi = rt - (rt - r);
+            double rLo = r - rHi;
+            double err = ((rHi * kDegHiHi - hi) + rHi * kDegHiLo + rLo * kDegHiHi) + rLo * kDegHiLo;
+            double lo = err + r * kDegLo;
+
+            double s, c;
+            sinCosKernel(hi, lo, s, c);
+            double ar = fabs(r);
+            if (ar == 30.0) {
+                s = r < 0 ? -0.5 : 0.5;
+                c = kCos30;
+            } else if (ar == 45.0) {
+                s = r < 0 ? -kCos45 : kCos45;
+                c = kCos45;
+            }
+
+            bool odd = (quadrant & 1) != 0;
+            double v;
+            if (F == TRIG_SIN) {
+                v = odd ? c : s;
+                if (quadrant & 2)
+                    v = -v;
+            } else if (F == TRIG_COS) {
+                v = odd ? s : c;
+                if ((quadrant + 1) & 2)
+                    v = -v;
+            } else {
+                // tan(90q + r) is -cot(r) for odd q; 0 - s keeps the pole +inf.
+                v = (odd ? c : s) / (odd ? 0.0 - s : c);
+                if (ar == 30.0) {
+                    v = odd ? -kCot30 : kTan30;
+                    if (r < 0)
+                        v = -v;
+                }
+            }
+            return v + 0.0;
+        }
+
+        template <TrigFn F>
+        void trigScalarLoop(double* a, size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+                a[i] = trigScalar<F>(a[i]);
+        }
+
+        const TrigKernels kScalar = {
+            "scalar",
+            trigScalarLoop<TRIG_SIN>, trigScalarLoop<TRIG_COS>, trigScalarLoop<TRIG_TAN>
+        };
+
+#ifdef CALC_TRIG_X86
+
+        // The vector kernels below are trigScalar line for line, with the
+        // branches turned into selects. A lane that needs fmod sends its
+        // whole vector down the scalar path.
+
+        __attribute__((target("sse2")))
+        inline __m128d selectSse2(__m128d mask, __m128d a, __m128d b)
+        {
+            return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+        }
+
+        template <TrigFn F>
+        __attribute__((target("sse2")))
+        __m128d trigSse2(__m128d x)
+        {
+            const __m128d sign = _mm_set1_pd(-0.0);
+            const __m128i one = _mm_set1_epi64x(1);
+
+            __m128d t = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(kInv90)), _mm_set1_pd(kRoundMagic));
+            __m128i bits = _mm_castpd_si128(t);
+            __m128d q = _mm_sub_pd(t, _mm_set1_pd(kRoundMagic));
+            __m128d r = _mm_sub_pd(x, _mm_mul_pd(q, _mm_set1_pd(90.0)));
+
+            __m128d hi = _mm_mul_pd(r, _mm_set1_pd(kDegHi));
+            __m128d rt = _mm_mul_pd(r, _mm_set1_pd(kSplit));
+            __m128d rHi = _mm_sub_pd(rt, _mm_sub_pd(rt, r));
+            __m128d rLo = _mm_sub_pd(r, rHi);
+            __m128d dHi = _mm_set1_pd(kDegHiHi);
+            __m128d dLo = _mm_set1_pd(kDegHiLo);
+            __m128d err = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_sub_pd(_mm_mul_pd(rHi, dHi), hi),
+                                                           _mm_mul_pd(rHi, dLo)),
+                                                _mm_mul_pd(rLo, dHi)),
+                                     _mm_mul_pd(rLo, dLo));
+            __m128d lo = _mm_add_pd(err, _mm_mul_pd(r, _mm_set1_pd(kDegLo)));
+
+            __m128d z = _mm_mul_pd(hi, hi);
+            __m128d v = _mm_mul_pd(z, hi);
+            __m128d ps = _mm_set1_pd(kS8);
+            ps = _mm_add_pd(_mm_set1_pd(kS7), _mm_mul_pd(z, ps));
+            ps = _mm_add_pd(_mm_set1_pd(kS6), _mm_mul_pd(z, ps));
+            ps = _mm_add_pd(_mm_set1_pd(kS5), _mm_mul_pd(z, ps));
+            ps = _mm_add_pd(_mm_set1_pd(kS4), _mm_mul_pd(z, ps));
+            ps = _mm_add_pd(_mm_set1_pd(kS3), _mm_mul_pd(z, ps));
+            ps = _mm_add_pd(_mm_set1_pd(kS2), _mm_mul_pd(z, ps));
+            __m128d s = _mm_sub_pd(hi, _mm_sub_pd(_mm_sub_pd(_mm_mul_pd(z, _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(0.5), lo),
+                                                                                      _mm_mul_pd(v, ps))),
+                                                             lo),
+                                                  _mm_mul_pd(v, _mm_set1_pd(kS1))));
+            __m128d pc = _mm_set1_pd(kC8);
+            pc = _mm_add_pd(_mm_set1_pd(kC7), _mm_mul_pd(z, pc));
+            pc = _mm_add_pd(_mm_set1_pd(kC6), _mm_mul_pd(z, pc));
+            pc = _mm_add_pd(_mm_set1_pd(kC5), _mm_mul_pd(z, pc));
+            pc = _mm_add_pd(_mm_set1_pd(kC4), _mm_mul_pd(z, pc));
+            pc = _mm_add_pd(_mm_set1_pd(kC3), _mm_mul_pd(z, pc));
+            pc = _mm_add_pd(_mm_set1_pd(kC2), _mm_mul_pd(z, pc));
+            pc = _mm_add_pd(_mm_set1_pd(kC1), _mm_mul_pd(z, pc));
+            pc = _mm_mul_pd(z, pc);
+            __m128d hz = _mm_mul_pd(_mm_set1_pd(0.5), z);
+            __m128d w = _mm_sub_pd(_mm_set1_pd(1.0), hz);
+            __m128d c = _mm_add_pd(w, _mm_add_pd(_mm_sub_pd(_mm_sub_pd(_mm_set1_pd(1.0), w), hz),
+                                                 _mm_sub_pd(_mm_mul_pd(z, pc), _mm_mul_pd(hi, lo))));
+
+            __m128d rSign = _mm_and_pd(r, sign);
+            __m128d ar = _mm_andnot_pd(sign, r);
+            __m128d is30 = _mm_cmpeq_pd(ar, _mm_set1_pd(30.0));
+            __m128d is45 = _mm_cmpeq_pd(ar, _mm_set1_pd(45.0));
+            s = selectSse2(is30, _mm_or_pd(_mm_set1_pd(0.5), rSign), s);
+            c = selectSse2(is30, _mm_set1_pd(kCos30), c);
+            s = selectSse2(is45, _mm_or_pd(_mm_set1_pd(kCos45), rSign), s);
+            c = selectSse2(is45, _mm_set1_pd(kCos45), c);
+
+            // SSE2 has no 64-bit compare: test the low dword and copy it up.
+            __m128i oddBits = _mm_cmpeq_epi32(_mm_and_si128(bits, one), one);
+            __m128d odd = _mm_castsi128_pd(_mm_shuffle_epi32(oddBits, _MM_SHUFFLE(2, 2, 0, 0)));
+            __m128d result;
+            if (F == TRIG_SIN) {
+                __m128d flip = _mm_and_pd(_mm_castsi128_pd(_mm_slli_epi64(bits, 62)), sign);
+                result = _mm_xor_pd(selectSse2(odd, c, s), flip);
+            } else if (F == TRIG_COS) {
+                __m128d flip = _mm_and_pd(_mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64(bits, one), 62)), sign);
+                result = _mm_xor_pd(selectSse2(odd, s, c), flip);
+            } else {
+                result = _mm_div_pd(selectSse2(odd, c, s), selectSse2(odd, _mm_sub_pd(_mm_setzero_pd(), s), c));
+                __m128d t30 = _mm_xor_pd(selectSse2(odd, _mm_set1_pd(-kCot30), _mm_set1_pd(kTan30)), rSign);
+                result = selectSse2(is30, t30, result);
+            }
+            return _mm_add_pd(result, _mm_setzero_pd());
+        }
+
+        template <TrigFn F>
+        __attribute__((target("sse2")))
+        void trigSse2Loop(double* a, size_t n)
+        {
+            const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+            const __m128d limit = _mm_set1_pd(kReduceLimit);
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2) {
+                __m128d x = _mm_loadu_pd(a + i);
+                if (_mm_movemask_pd(_mm_cmpnlt_pd(_mm_and_pd(x, absMask), limit))) {
+                    a[i] = trigScalar<F>(a[i]);
+                    a[i + 1] = trigScalar<F>(a[i + 1]);
+                } else {
+                    _mm_storeu_pd(a + i, trigSse2<F>(x));
+                }
+            }
+            for (; i < n; ++i)
+                a[i] = trigScalar<F>(a[i]);
+        }
+
+        __attribute__((target("avx2")))
+        inline __m256d selectAvx2(__m256d mask, __m256d a, __m256d b)
+        {
+            return _mm256_blendv_pd(b, a, mask);
+        }
+
+        template <TrigFn F>
+        __attribute__((target("avx2")))
+        __m256d trigAvx2(__m256d x)
+        {
+            const __m256d sign = _mm256_set1_pd(-0.0);
+            const __m256i one = _mm256_set1_epi64x(1);
+
+            __m256d t = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(kInv90)), _mm256_set1_pd(kRoundMagic));
+            __m256i bits = _mm256_castpd_si256(t);
+            __m256d q = _mm256_sub_pd(t, _mm256_set1_pd(kRoundMagic));
+            __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(q, _mm256_set1_pd(90.0)));
+
+            __m256d hi = _mm256_mul_pd(r, _mm256_set1_pd(kDegHi));
+            __m256d rt = _mm256_mul_pd(r, _mm256_set1_pd(kSplit));
+            __m256d rHi = _mm256_sub_pd(rt, _mm256_sub_pd(rt, r));
+            __m256d rLo = _mm256_sub_pd(r, rHi);
+            __m256d dHi = _mm256_set1_pd(kDegHiHi);
+            __m256d dLo = _mm256_set1_pd(kDegHiLo);
+            __m256d err = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(rHi, dHi), hi),
+                                                                    _mm256_mul_pd(rHi, dLo)),
+                                                      _mm256_mul_pd(rLo, dHi)),
+                                        _mm256_mul_pd(rLo, dLo));
+            __m256d lo = _mm256_add_pd(err, _mm256_mul_pd(r, _mm256_set1_pd(kDegLo)));
+
+            __m256d z = _mm256_mul_pd(hi, hi);
+            __m256d v = _mm256_mul_pd(z, hi);
+            __m256d ps = _mm256_set1_pd(kS8);
+            ps = _mm256_add_pd(_mm256_set1_pd(kS7), _mm256_mul_pd(z, ps));
+            ps = _mm256_add_pd(_mm256_set1_pd(kS6), _mm256_mul_pd(z, ps));
+            ps = _mm256_add_pd(_mm256_set1_pd(kS5), _mm256_mul_pd(z, ps));
+            ps = _mm256_add_pd(_mm256_set1_pd(kS4), _mm256_mul_pd(z, ps));
+            ps = _mm256_add_pd(_mm256_set1_pd(kS3), _mm256_mul_pd(z, ps));
+            ps = _mm256_add_pd(_mm256_set1_pd(kS2), _mm256_mul_pd(z, ps));
+            __m256d s = _mm256_sub_pd(hi, _mm256_sub_pd(_mm256_sub_pd(_mm256_mul_pd(z, _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), lo),
+                                                                                                     _mm256_mul_pd(v, ps))),
+                                                                      lo),
+                                                        _mm256_mul_pd(v, _mm256_set1_pd(kS1))));
+            __m256d pc = _mm256_set1_pd(kC8);
+            pc = _mm256_add_pd(_mm256_set1_pd(kC7), _mm256_mul_pd(z, pc));
+            pc = _mm256_add_pd(_mm256_set1_pd(kC6), _mm256_mul_pd(z, pc));
+            pc = _mm256_add_pd(_mm256_set1_pd(kC5), _mm256_mul_pd(z, pc));
+            pc = _mm256_add_pd(_mm256_set1_pd(kC4), _mm256_mul_pd(z, pc));
+            pc = _mm256_add_pd(_mm256_set1_pd(kC3), _mm256_mul_pd(z, pc));
+            pc = _mm256_add_pd(_mm256_set1_pd(kC2), _mm256_mul_pd(z, pc));
+            pc = _mm256_add_pd(_mm256_set1_pd(kC1), _mm256_mul_pd(z, pc));
+            pc = _mm256_mul_pd(z, pc);
+            __m256d hz = _mm256_mul_pd(_mm256_set1_pd(0.5), z);
+            __m256d w = _mm256_sub_pd(_mm256_set1_pd(1.0), hz);
+            __m256d c = _mm256_add_pd(w, _mm256_add_pd(_mm256_sub_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), w), hz),
+                                                       _mm256_sub_pd(_mm256_mul_pd(z, pc), _mm256_mul_pd(hi, lo))));
+
+            __m256d rSign = _mm256_and_pd(r, sign);
+            __m256d ar = _mm256_andnot_pd(sign, r);
+            __m256d is30 = _mm256_cmp_pd(ar, _mm256_set1_pd(30.0), _CMP_EQ_OQ);
+            __m256d is45 = _mm256_cmp_pd(ar, _mm256_set1_pd(45.0), _CMP_EQ_OQ);
+            s = selectAvx2(is30, _mm256_or_pd(_mm256_set1_pd(0.5), rSign), s);
+            c = selectAvx2(is30, _mm256_set1_pd(kCos30), c);
+            s = selectAvx2(is45, _mm256_or_pd(_mm256_set1_pd(kCos45), rSign), s);
+            c = selectAvx2(is45, _mm256_set1_pd(kCos45), c);
+
+            __m256d odd = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(bits, one), one));
+            __m256d result;
+            if (F == TRIG_SIN) {
+                __m256d flip = _mm256_and_pd(_mm256_castsi256_pd(_mm256_slli_epi64(bits, 62)), sign);
+                result = _mm256_xor_pd(selectAvx2(odd, c, s), flip);
+            } else if (F == TRIG_COS) {
+                __m256d flip = _mm256_and_pd(_mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(bits, one), 62)), sign);
+                result = _mm256_xor_pd(selectAvx2(odd, s, c), flip);
+            } else {
+                result = _mm256_div_pd(selectAvx2(odd, c, s), selectAvx2(odd, _mm256_sub_pd(_mm256_setzero_pd(), s), c));
+                __m256d t30 = _mm256_xor_pd(selectAvx2(odd, _mm256_set1_pd(-kCot30), _mm256_set1_pd(kTan30)), rSign);
+                result = selectAvx2(is30, t30, result);
+            }
+            return _mm256_add_pd(result, _mm256_setzero_pd());
+        }
+
+        template <TrigFn F>
+        __attribute__((target("avx2")))
+        void trigAvx2Loop(double* a, size_t n)
+        {
+            const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+            const __m256d limit = _mm256_set1_pd(kReduceLimit);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256d x = _mm256_loadu_pd(a + i);
+                if (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_and_pd(x, absMask), limit, _CMP_NLT_UQ))) {
+                    for (size_t j = i; j < i + 4; ++j)
+                        a[j] = trigScalar<F>(a[j]);
+                } else {
+                    _mm256_storeu_pd(a + i, trigAvx2<F>(x));
+                }
+            }
+            for (; i < n; ++i)
+                a[i] = trigScalar<F>(a[i]);
+        }
+
+        const TrigKernels kSse2 = {
+            "sse2",
+            trigSse2Loop<TRIG_SIN>, trigSse2Loop<TRIG_COS>, trigSse2Loop<TRIG_TAN>
+        };
+
+        const TrigKernels kAvx2 = {
+            "avx2",
+            trigAvx2Loop<TRIG_SIN>, trigAvx2Loop<TRIG_COS>, trigAvx2Loop<TRIG_TAN>
+        };
+
+        size_t supportedKernels(const TrigKernels** out, size_t max)
+        {
+            __builtin_cpu_init();
+            size_t n = 0;
+            if (n < max)
+                out[n++] = &kScalar;
+            if (n < max && __builtin_cpu_supports("sse2"))
+                out[n++] = &kSse2;
+            if (n < max && __builtin_cpu_supports("avx2"))
+                out[n++] = &kAvx2;
+            return n;
+        }
+
+#else
+
+        size_t supportedKernels(const TrigKernels** out, size_t max)
+        {
+            if (max == 0)
+                return 0;
+            out[0] = &kScalar;
+            return 1;
+        }
+
+#endif
+
+        const TrigKernels& pickKernels()
+        {
+            const TrigKernels* sets[3];
+            size_t n = supportedKernels(sets, 3);
+            return *sets[n - 1];
+        }
+
+    }
+
+    double sinDeg(double x) { return trigScalar<TRIG_SIN>(x); }
+    double cosDeg(double x) { return trigScalar<TRIG_COS>(x); }
+    double tanDeg(double x) { return trigScalar<TRIG_TAN>(x); }
+
+    const TrigKernels& trigKernels()
+    {
+        static const TrigKernels& kernels = pickKernels();
+        return kernels;
+    }
+
+    size_t allTrigKernels(const TrigKernels** out, size_t max)
+    {
+        return supportedKernels(out, max);
+    }
+
+}
@@ -0,0 +1,48 @@
+//
+// Trigonometric functions of angles in degrees.
+//
+// The argument is reduced in degrees, where the reduction is exact: x is
+// split into a multiple of 90 and a remainder in [-45, 45] with no rounding
+// at all, and only the remainder is converted to radians, carrying the
+// product with pi/180 to twice double precision. Short polynomials evaluate
+// sin and cos on that small range. Remainders of 0, 30 and 45 degrees are
+// answered from a table, so every multiple of 30 and 45 degrees gives the
+// correctly rounded value (sin 30 is exactly 0.5, cos 90 exactly 0), and
+// tan at an odd multiple of 90 degrees is +inf rather than a huge finite
+// number. Zero results are never negative.
+//
+// The column kernels apply the same operation sequence two or four lanes at
+// a time, so a column evaluated here is bit-identical to calling the scalar
+// function on every point.
+//
+
+#ifndef IMGUI_ANDROID_CALC_TRIG_H
+#define IMGUI_ANDROID_CALC_TRIG_H
+
+#include <cstddef>
+
+namespace calc {
+
+    double sinDeg(double x);
+    double cosDeg(double x);
+    double tanDeg(double x);
+
+    struct TrigKernels {
+        const char* name;   // "avx2", "sse2" or "scalar"
+
+        // a[i] = f(a[i])
+        void (*sinDeg)(double* a, size_t n);
+        void (*cosDeg)(double* a, size_t n);
+        void (*tanDeg)(double* a, size_t n);
+    };
+
+    // The widest kernel set this CPU supports, picked once on first use.
+    const TrigKernels& trigKernels();
+
+    // Every kernel set this build has, scalar first, for comparing them.
+    // Sets the CPU cannot run are left out.
+    size_t allTrigKernels(const TrigKernels** out, size_t max);
+
+}
+
+#endif //IMGUI_ANDROID_CALC_TRIG_H
@@ -5,130 +5,84 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include "calc_batch.h"
+#include "calc_cache.h"
+#include "calc_decimal.h"
+#include "calc_number.h"
+#include "calc_program.h"
 #include "logger.h"
-#include <math.h>       /* sin */
-#define PI 3.14159265
+#include <mutex>
 
 using namespace std;
 
 
-int static nextOper(std::string& s)
-{
-    char ch;
-    int n;
-
-    for (int i=0; i<s.length(); ++i) {
-        ch = s[i];
-
-        if (ch == '+') {
-            cin.putback(ch);
-            n = 1;
-            break;
-        }
-        else if (ch == '-') {
-            cin.putback(ch);
-            n = 2;
-            break;
-        }
-        else if (ch == 'X') {
-            cin.putback(ch);
-            n = 3;
-            break;
-        }
-        else if (ch == '/') {
-            cin.putback(ch);
-            n = 4;
-            break;
-        }
-
-    }
-    s.erase(0, 1);
-
-    return n;
+double calculator::calEverything(const std::string& strToCalculate){
+    return calEverything(strToCalculate.data(), strToCalculate.size());
 }
 
-double static getInt(std::string& s)
-{
-    char ch;
-    int i=0;
-    std::string output = "0";
-    char temp;
-
-    if(s[0] == 's' || s[0] == 'c' || s[0] == 't'){
-
-
-        temp = s[0];
-        s.erase(0, 3);
-
+double calculator::calEverything(const char* str, size_t len){
+    calc::Program program;
+    if (!program.compile(str, len)) {
+        Log(LOG_WARN) << "Could not parse expression at offset " << program.errorPos();
     }
+    double sum = program.run();
+    LogEvent(LOG_INFO, "Got sum: {}", sum);
 
-    for (i; i<s.length(); ++i)
-    {
-
-        ch = s[i];
-
+    return sum;
 
+}
 
-        if((ch>='0' && ch<='9') || ch == '.'){
+static void stringAt(const void* exprs, size_t i, const char** str, size_t* len){
+    const std::string& s = static_cast<const std::string*>(exprs)[i];
+    *str = s.data();
+    *len = s.size();
+}
 
+void calculator::calBatch(const std::string* exprs, size_t count, double* out){
+    calc::evaluateBatch(exprs, stringAt, count, out);
+}
 
-            std::ostringstream strs;
-            strs << ch ;
-            output += strs.str();
+// Shared by every caller of calToString; the lock is uncontended in the app.
+static std::mutex cacheLock;
+static calc::ResultCache resultCache(256);
 
-        } else {
-            break;
+std::string calculator::calToString(const std::string& strToCalculate, CalcMode mode){
+    return calToString(strToCalculate, mode, NULL, NULL);
+}
 
-        }
+std::string calculator::calToString(const std::string& strToCalculate, CalcMode mode,
+                                    bool (*stop)(void*), void* context){
+    calc::Program program;
+    if (!program.compile(strToCalculate.data(), strToCalculate.size())) {
+        Log(LOG_WARN) << "Could not parse expression at offset " << program.errorPos();
     }
-    s.erase(0, i);
-    double outDouble = std::stod (output);
-
-
-    switch(temp){
-        case 's':
-            return sin ( outDouble * PI / 180.0 );
-        case 'c':
-            return cos ( outDouble * PI / 180.0 );
-        case 't':
-            return tan ( outDouble * PI / 180.0 );
-        default:
-            return outDouble;
+    if (mode == CALC_MODE_DECIMAL) {
+        std::string text = calc::evaluateDecimal(program, strToCalculate.data(), strToCalculate.size(),
+                                                 stop, context).toString();
+        LogEvent(LOG_INFO, "Got sum: {}", text);
+        return text;
     }
+    uint64_t key = calc::ResultCache::keyOf(program);
 
-    return outDouble;
-}
-
-
-double static calculate(double num,double sum, int op)
-{
-    switch(op)
+    calc::CachedResult result;
     {
-        case 1: {sum+=num; break;}
-        case 2: {sum-=num; break;}
-        case 3: {sum*=num; break;}
-        case 4: {sum/=num; break;}
-        default: sum+=num;
+        std::lock_guard<std::mutex> lock(cacheLock);
+        if (resultCache.lookup(key, result))
+            return result.text;
     }
 
-    return  sum;
-}
-
+    result.value = program.run();
+    calc::formatShortest(result.value, result.text);
+    LogEvent(LOG_INFO, "Got sum: {}", result.text);
 
-double calculator::calEverything(std:: string strToCalculate){
-    double sum = getInt(strToCalculate);
-    while (strToCalculate != "") {
-
-        Log(LOG_INFO) << "Got strToCalculate: " << strToCalculate;
-        int opt = nextOper(strToCalculate);
-
-        double temp = getInt(strToCalculate);
-
-        sum = calculate(temp,sum,opt);
-
-    }
-    Log(LOG_INFO) << "Got sum: " << sum;
-
-    return sum;
+    std::lock_guard<std::mutex> lock(cacheLock);
+    resultCache.insert(key, result);
+    return result.text;
+}
 
+CalcCacheStats calculator::cacheStats(){
+    std::lock_guard<std::mutex> lock(cacheLock);
+    CalcCacheStats stats = { resultCache.hits(), resultCache.misses(), resultCache.evictions(),
+                             resultCache.size(), resultCache.capacity() };
+    return stats;
 }
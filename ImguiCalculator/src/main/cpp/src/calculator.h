@@ -3,6 +3,7 @@
 //
 
 #include <iostream>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -10,9 +11,36 @@
 #define IMGUI_ANDROID_CALCULATOR_H
 
 
+struct CalcCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t size;
+    size_t capacity;
+};
+
+// How calToString does its arithmetic: binary double precision, or exact
+// decimal with division rounded to calc::kDecimalDigits digits.
+enum CalcMode {
+    CALC_MODE_DOUBLE,
+    CALC_MODE_DECIMAL
+};
+
 class calculator{
     public:
-        double static calEverything(std::string );
+        double static calEverything(const std::string& );
+        double static calEverything(const char* str, size_t len);
+        // Scores exprs[0..count) into out on every core, without logging.
+        void static calBatch(const std::string* exprs, size_t count, double* out);
+        // Evaluates and formats for display. In double mode both the value
+        // and the text are memoized, keyed by the compiled form of the
+        // expression; decimal results can be any length and are not cached.
+        std::string static calToString(const std::string& , CalcMode mode = CALC_MODE_DOUBLE);
+        // As above, for callers off the UI thread that may need to give up:
+        // stop(context) is polled while a decimal evaluation runs, and once it
+        // returns true the evaluation is abandoned and the text is "nan".
+        std::string static calToString(const std::string& , CalcMode mode, bool (*stop)(void*), void* context);
+        CalcCacheStats static cacheStats();
 
 
 };
@@ -0,0 +1,131 @@
+//
+// Recorded input for replaying the demo without a user.
+//
+#include "event_script.h"
+#include "logger.h"
+#include <algorithm>
+#include <string.h>
+
+bool EventScript::load(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        Log(LOG_ERROR) << "Could not open event script " << path;
+        return false;
+    }
+    events_.clear();
+    next_ = 0;
+
+    char line[256];
+    int lineNo = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        ++lineNo;
+        const char* s = line + strspn(line, " \t");
+        if (*s == '#' || *s == '\n' || *s == '\r' || *s == '\0')
+            continue;
+
+        Scheduled ev;
+        memset(&ev.event, 0, sizeof(ev.event));
+        unsigned long long frame;
+        char kind[16];
+        int x = 0, y = 0, state = 0, fields;
+        if (sscanf(s, "size %d %d", &x, &y) == 2) {
+            ok = x > 0 && y > 0;
+            width_ = x;
+            height_ = y;
+            continue;
+        }
+        fields = sscanf(s, "%llu %15s %d %d %d", &frame, kind, &x, &y, &state);
+        ev.frame = frame;
+        if (fields >= 4 && !strcmp(kind, "motion")) {
+            ev.event.type = SDL_MOUSEMOTION;
+            ev.event.motion.x = x;
+            ev.event.motion.y = y;
+            ev.event.motion.state = (Uint32) state;
+        } else if (fields >= 4 && (!strcmp(kind, "down") || !strcmp(kind, "up"))) {
+            bool down = kind[0] == 'd';
+            ev.event.type = down ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+            ev.event.button.button = SDL_BUTTON_LEFT;
+            ev.event.button.state = down ? SDL_PRESSED : SDL_RELEASED;
+            ev.event.button.clicks = 1;
+            ev.event.button.x = x;
+            ev.event.button.y = y;
+        } else if (fields >= 3 && !strcmp(kind, "wheel")) {
+            ev.event.type = SDL_MOUSEWHEEL;
+            ev.event.wheel.y = x;
+        } else if (fields >= 2 && !strcmp(kind, "quit")) {
+            ev.event.type = SDL_QUIT;
+        } else {
+            ok = false;
+            continue;
+        }
+        events_.push_back(ev);
+    }
+    fclose(f);
+    if (!ok) {
+        Log(LOG_ERROR) << path << ":" << lineNo << ": not a script line";
+        events_.clear();
+        return false;
+    }
+
+    // Recordings are in order already; hand-edited scripts need not be.
+    std::stable_sort(events_.begin(), events_.end(),
+                     [](const Scheduled& a, const Scheduled& b) { return a.frame < b.frame; });
+    return true;
+}
+
+void EventScript::push(uint64_t frame)
+{
+    while (next_ < events_.size() && events_[next_].frame <= frame) {
+        SDL_Event e = events_[next_].event;
+        SDL_PushEvent(&e);
+        ++next_;
+    }
+}
+
+bool EventRecorder::open(const char* path, int width, int height)
+{
+    close();
+    file_ = fopen(path, "w");
+    if (!file_) {
+        Log(LOG_ERROR) << "Could not create event script " << path;
+        return false;
+    }
+    fprintf(file_, "size %d %d\n", width, height);
+    return true;
+}
+
+void EventRecorder::close()
+{
+    if (file_) {
+        fclose(file_);
+        file_ = NULL;
+    }
+}
+
+void EventRecorder::record(uint64_t frame, const SDL_Event& e)
+{
+    if (!file_)
+        return;
+    unsigned long long f = frame;
+    switch (e.type) {
+        case SDL_MOUSEMOTION:
+            fprintf(file_, "%llu motion %d %d %u\n", f, e.motion.x, e.motion.y, (unsigned) e.motion.state);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            if (e.button.button == SDL_BUTTON_LEFT)
+                fprintf(file_, "%llu %s %d %d\n", f, e.type == SDL_MOUSEBUTTONDOWN ? "down" : "up",
+                        e.button.x, e.button.y);
+            break;
+        case SDL_MOUSEWHEEL:
+            fprintf(file_, "%llu wheel %d\n", f, e.wheel.y);
+            break;
+        case SDL_QUIT:
+            fprintf(file_, "%llu quit\n", f);
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,76 @@
+//
+// Recorded input for replaying the demo without a user.
+//
+// A script is text, one event per line, each tagged with the frame whose
+// event poll should see it:
+//
+//     size 1280 800           window size the events were recorded at
+//     12 motion 400 650 0     frame, kind, x, y, button mask held
+//     12 down 400 650         left button
+//     14 up 400 650
+//     30 wheel -1
+//     90 quit
+//
+// Blank lines and lines starting with '#' are skipped. Frames count the
+// frames the demo drew, so a replay lands every event on the same frame
+// it was recorded on no matter how long the recording sat idle.
+//
+
+#ifndef IMGUI_ANDROID_EVENT_SCRIPT_H
+#define IMGUI_ANDROID_EVENT_SCRIPT_H
+
+#include <SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+class EventScript {
+public:
+    EventScript() : width_(1280), height_(800), next_(0) {}
+
+    // False, with the offending line logged, if the file cannot be read or
+    // parsed.
+    bool load(const char* path);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t size() const { return events_.size(); }
+
+    // Pushes every event for frame onto SDL's queue. Frames must be asked
+    // for in increasing order.
+    void push(uint64_t frame);
+    // True once every event has been pushed.
+    bool finished() const { return next_ == events_.size(); }
+
+private:
+    struct Scheduled {
+        uint64_t frame;
+        SDL_Event event;
+    };
+
+    int width_;
+    int height_;
+    std::vector<Scheduled> events_;
+    size_t next_;
+};
+
+class EventRecorder {
+public:
+    EventRecorder() : file_(NULL) {}
+    ~EventRecorder() { close(); }
+
+    bool open(const char* path, int width, int height);
+    void close();
+    bool isOpen() const { return file_ != NULL; }
+
+    // Writes e if it is an event a script can hold; others are ignored.
+    void record(uint64_t frame, const SDL_Event& e);
+
+private:
+    EventRecorder(const EventRecorder&);
+    EventRecorder& operator=(const EventRecorder&);
+
+    FILE* file_;
+};
+
+#endif //IMGUI_ANDROID_EVENT_SCRIPT_H
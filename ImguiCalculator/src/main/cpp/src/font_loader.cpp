@@ -0,0 +1,74 @@
+//
+// Builds the font atlas on a thread of its own during startup.
+//
+#include "font_loader.h"
+#include "logger.h"
+#include "profiler.h"
+#include <chrono>
+#include <stdio.h>
+
+namespace {
+
+    double msSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The whole file in a buffer from ImGui::MemAlloc, which the atlas frees
+    // once built. NULL if it cannot be read.
+    void* readFile(const char* path, int* size)
+    {
+        FILE* f = fopen(path, "rb");
+        if (!f)
+            return NULL;
+        void* data = NULL;
+        long n = -1;
+        if (fseek(f, 0, SEEK_END) == 0 && (n = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+            data = ImGui::MemAlloc((size_t) n);
+            if (fread(data, 1, (size_t) n, f) != (size_t) n) {
+                ImGui::MemFree(data);
+                data = NULL;
+            }
+        }
+        fclose(f);
+        *size = (int) n;
+        return data;
+    }
+
+}
+
+void FontLoader::start(ImFontAtlas* atlas, const char* path, float sizePixels)
+{
+    finish();
+    thread_ = std::thread(&FontLoader::loadMain, this, atlas, path, sizePixels);
+}
+
+bool FontLoader::finish()
+{
+    if (thread_.joinable()) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        thread_.join();
+        waitMs_ = msSince(start);
+    }
+    return ok_;
+}
+
+void FontLoader::loadMain(ImFontAtlas* atlas, const char* path, float sizePixels)
+{
+    prof::setThreadName("font loader");
+    PROFILE_ZONE("font atlas");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int size = 0;
+    void* data = readFile(path, &size);
+    ok_ = data && atlas->AddFontFromMemoryTTF(data, size, sizePixels);
+    if (!ok_) {
+        Log(LOG_ERROR) << "Could not load font " << path << ", using the default font";
+        atlas->AddFontDefault();
+    }
+    // Rasterizes the glyphs; the backend's GetTexData call then only has
+    // to convert the pixels.
+    atlas->Build();
+
+    loadMs_ = msSince(start);
+}
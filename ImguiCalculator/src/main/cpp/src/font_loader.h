@@ -0,0 +1,45 @@
+//
+// Builds the font atlas on a thread of its own during startup.
+//
+// Reading the TTF and rasterizing its glyphs take about as long as creating
+// the window and GL context, and neither needs the other, so main() starts
+// the loader first and waits for it only once the context exists. ImGui's
+// allocator is not thread-safe: between start() and finish() nothing else
+// may call into ImGui.
+//
+
+#ifndef IMGUI_ANDROID_FONT_LOADER_H
+#define IMGUI_ANDROID_FONT_LOADER_H
+
+#include "imgui.h"
+#include <thread>
+
+class FontLoader {
+public:
+    FontLoader() : ok_(false), loadMs_(0), waitMs_(0) {}
+    // Waits for a load still running.
+    ~FontLoader() { finish(); }
+
+    // Reads the TTF at path and builds atlas with it at sizePixels. A file
+    // that cannot be read is logged and ImGui's default font built instead.
+    void start(ImFontAtlas* atlas, const char* path, float sizePixels);
+    // Waits for the thread. False if the default font stood in.
+    bool finish();
+
+    // Time the thread took, and time finish() spent waiting for it.
+    double loadMs() const { return loadMs_; }
+    double waitMs() const { return waitMs_; }
+
+private:
+    FontLoader(const FontLoader&);
+    FontLoader& operator=(const FontLoader&);
+
+    void loadMain(ImFontAtlas* atlas, const char* path, float sizePixels);
+
+    std::thread thread_;
+    bool ok_;
+    double loadMs_;
+    double waitMs_;
+};
+
+#endif //IMGUI_ANDROID_FONT_LOADER_H
@@ -0,0 +1,55 @@
+// Shared by the SDL OpenGL bindings (GL3, ES2, ES3): what they count of the GL calls a frame makes, and a
+// shadow of the state that changes between draw commands, so that setting it again to the same value is skipped.
+// Needs no GL header; GLuint and GLint are taken as unsigned int and int.
+
+#ifndef IMGUI_IMPL_GL_STATE
+#define IMGUI_IMPL_GL_STATE
+
+// GL calls made by one RenderDrawLists, i.e. one ImGui::Render().
+struct ImGui_ImplGLFrameStats
+{
+    int     Queries;        // glGet* and glIsEnabled; each is a round trip to the driver on most mobile GPUs
+    int     StateChanges;   // enables, binds, blend setup, uniforms, viewport and scissor
+    int     Uploads;        // buffer data, maps and fences
+    int     Draws;
+    int     Skipped;        // texture binds and scissors left out because they would have changed nothing
+
+    ImGui_ImplGLFrameStats() { Clear(); }
+    void    Clear()          { Queries = StateChanges = Uploads = Draws = Skipped = 0; }
+    int     Total() const    { return Queries + StateChanges + Uploads + Draws; }
+};
+
+// The texture binding and scissor box as RenderDrawLists last set them. Forget() after anything else may have
+// changed them: a user callback, the start of a frame.
+struct ImGui_ImplGLShadowState
+{
+    bool            TextureKnown;
+    unsigned int    Texture;
+    bool            ScissorKnown;
+    int             Scissor[4];
+
+    ImGui_ImplGLShadowState() { Texture = 0; Scissor[0] = Scissor[1] = Scissor[2] = Scissor[3] = 0; Forget(); }
+    void    Forget()         { TextureKnown = ScissorKnown = false; }
+
+    // True if the texture must be bound, i.e. it is not known to be already.
+    bool    SetTexture(unsigned int texture)
+    {
+        if (TextureKnown && Texture == texture)
+            return false;
+        TextureKnown = true;
+        Texture = texture;
+        return true;
+    }
+
+    // True if glScissor must be called.
+    bool    SetScissor(int x, int y, int w, int h)
+    {
+        if (ScissorKnown && Scissor[0] == x && Scissor[1] == y && Scissor[2] == w && Scissor[3] == h)
+            return false;
+        ScissorKnown = true;
+        Scissor[0] = x; Scissor[1] = y; Scissor[2] = w; Scissor[3] = h;
+        return true;
+    }
+};
+
+#endif // IMGUI_IMPL_GL_STATE
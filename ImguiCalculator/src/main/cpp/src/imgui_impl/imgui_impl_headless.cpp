@@ -0,0 +1,345 @@
+// ImGui SDL2 binding with no GPU, for offscreen runs under SDL's dummy video driver.
+// See imgui_impl_headless.h.
+
+#include "imgui.h"
+#include "imgui_impl_headless.h"
+#include "profiler.h"
+
+#include <SDL.h>
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+// Data
+static std::vector<uint32_t> g_Framebuffer;
+static int          g_Width = 0, g_Height = 0;
+static unsigned char* g_FontPixels = NULL;
+static int          g_FontWidth = 0, g_FontHeight = 0;
+static ImVec2       g_MousePos(-1.0f, -1.0f);
+static bool         g_MouseDown[3] = { false, false, false };
+static bool         g_MousePressed[3] = { false, false, false };
+static float        g_MouseWheel = 0.0f;
+
+// Same as the GL backends' clear colour in main.cpp.
+static const uint32_t kClearColor = IM_COL32(114, 144, 154, 255);
+
+static inline float Edge(const ImVec2& a, const ImVec2& b, float px, float py)
+{
+    return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+
+// Pixels exactly on an edge belong to only one of the two triangles sharing it, so the diagonal of a
+// translucent quad is not blended twice. Traversing the edge the other way flips the answer.
+static inline bool OwnsEdge(const ImVec2& a, const ImVec2& b)
+{
+    return b.y < a.y || (b.y == a.y && b.x > a.x);
+}
+
+static inline uint32_t Blend(uint32_t dst, uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+{
+    uint32_t ia = 255 - a;
+    uint32_t dr = dst & 0xff, dg = (dst >> 8) & 0xff, db = (dst >> 16) & 0xff;
+    dr = (r * a + dr * ia + 127) / 255;
+    dg = (g * a + dg * ia + 127) / 255;
+    db = (b * a + db * ia + 127) / 255;
+    return dr | (dg << 8) | (db << 16) | 0xff000000u;
+}
+
+static inline uint32_t SampleFont(float u, float v)
+{
+    int x = (int)(u * g_FontWidth), y = (int)(v * g_FontHeight);
+    x = x < 0 ? 0 : x >= g_FontWidth ? g_FontWidth - 1 : x;
+    y = y < 0 ? 0 : y >= g_FontHeight ? g_FontHeight - 1 : y;
+    return g_FontPixels[y * g_FontWidth + x];
+}
+
+// Writes one colour over row[x0, x1): a plain fill when it is opaque.
+static inline void FillSpan(uint32_t* row, int x0, int x1, uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+{
+    if (a == 255)
+        std::fill(row + x0, row + std::max(x0, x1), r | (g << 8) | (b << 16) | 0xff000000u);
+    else if (a)
+        for (int x = x0; x < x1; x++)
+            row[x] = Blend(row[x], r, g, b, a);
+}
+
+// Fills a triangle, sampling pixel centres, with colour and uv interpolated across it.
+static void DrawTriangle(const ImDrawVert* v0, const ImDrawVert* v1, const ImDrawVert* v2, const ImVec4& clip, bool textured)
+{
+    float area = Edge(v0->pos, v1->pos, v2->pos.x, v2->pos.y);
+    if (area == 0.0f)
+        return;
+    // ImGui winds its triangles both ways; make the edge functions positive inside.
+    if (area < 0.0f) { std::swap(v1, v2); area = -area; }
+
+    const ImVec2 &p0 = v0->pos, &p1 = v1->pos, &p2 = v2->pos;
+    int x0 = std::max((int)clip.x, (int)floorf(std::min(p0.x, std::min(p1.x, p2.x))));
+    int y0 = std::max((int)clip.y, (int)floorf(std::min(p0.y, std::min(p1.y, p2.y))));
+    int x1 = std::min((int)ceilf(clip.z), (int)ceilf(std::max(p0.x, std::max(p1.x, p2.x))));
+    int y1 = std::min((int)ceilf(clip.w), (int)ceilf(std::max(p0.y, std::max(p1.y, p2.y))));
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    const bool own[3] = { OwnsEdge(p1, p2), OwnsEdge(p2, p0), OwnsEdge(p0, p1) };
+    // Edge functions are linear, so they change by a constant per pixel.
+    const float dx[3] = { p1.y - p2.y, p2.y - p0.y, p0.y - p1.y };
+
+    // Solid fills sample the atlas' white texel with one colour at all three corners, and most of
+    // ImGui's geometry is like that; text quads vary only in uv.
+    bool flatColor = v0->col == v1->col && v1->col == v2->col;
+    bool flatUv = v0->uv.x == v1->uv.x && v1->uv.x == v2->uv.x && v0->uv.y == v1->uv.y && v1->uv.y == v2->uv.y;
+    const ImU32 c0 = v0->col, c1 = v1->col, c2 = v2->col;
+    uint32_t flatTexel = textured && flatUv ? SampleFont(v0->uv.x, v0->uv.y) : 255;
+    uint32_t flatAlpha = ((c0 >> 24) * flatTexel + 127) / 255;
+
+    float inv = 1.0f / area;
+    for (int y = y0; y < y1; y++)
+    {
+        float py = y + 0.5f, px = x0 + 0.5f;
+        const float w[3] = { Edge(p1, p2, px, py), Edge(p2, p0, px, py), Edge(p0, p1, px, py) };
+
+        // A triangle covers one run of each row. Solve each edge for where it crosses the row,
+        // widened a pixel for rounding, then trim the ends with the exact test: the thin slivers of
+        // a rounded window's triangle fan span its whole bounding box, so walking that would
+        // dominate the frame.
+        float lo = 0.0f, hi = (float)(x1 - x0);
+        for (int e = 0; e < 3; e++)
+        {
+            if (dx[e] > 0.0f)
+                lo = std::max(lo, -w[e] / dx[e] - 1.0f);
+            else if (dx[e] < 0.0f)
+                hi = std::min(hi, -w[e] / dx[e] + 1.0f);
+            else if (w[e] < 0.0f)
+                hi = -1.0f;
+        }
+        if (lo > hi)
+            continue;
+        int sx = (int)lo, ex = std::min(x1 - x0, (int)hi + 1);
+        for (; sx < ex; sx++)
+        {
+            int e = 0;
+            for (; e < 3; e++)
+            {
+                float we = w[e] + dx[e] * sx;
+                if (we < 0.0f || (we == 0.0f && !own[e]))
+                    break;
+            }
+            if (e == 3)
+                break;
+        }
+        for (; ex > sx; ex--)
+        {
+            int e = 0;
+            for (; e < 3; e++)
+            {
+                float we = w[e] + dx[e] * (ex - 1);
+                if (we < 0.0f || (we == 0.0f && !own[e]))
+                    break;
+            }
+            if (e == 3)
+                break;
+        }
+        if (sx >= ex)
+            continue;
+
+        uint32_t* row = &g_Framebuffer[(size_t)y * g_Width] + x0;
+        if (flatColor && (flatUv || !textured))
+        {
+            FillSpan(row, sx, ex, c0 & 0xff, (c0 >> 8) & 0xff, (c0 >> 16) & 0xff, flatAlpha);
+            continue;
+        }
+        for (int x = sx; x < ex; x++)
+        {
+            float l0 = (w[0] + dx[0] * x) * inv, l1 = (w[1] + dx[1] * x) * inv, l2 = 1.0f - l0 - l1;
+            uint32_t r, g, b, a;
+            if (flatColor)
+            {
+                r = c0 & 0xff; g = (c0 >> 8) & 0xff; b = (c0 >> 16) & 0xff; a = c0 >> 24;
+            }
+            else
+            {
+                r = (uint32_t)(l0 * (c0 & 0xff) + l1 * (c1 & 0xff) + l2 * (c2 & 0xff) + 0.5f);
+                g = (uint32_t)(l0 * ((c0 >> 8) & 0xff) + l1 * ((c1 >> 8) & 0xff) + l2 * ((c2 >> 8) & 0xff) + 0.5f);
+                b = (uint32_t)(l0 * ((c0 >> 16) & 0xff) + l1 * ((c1 >> 16) & 0xff) + l2 * ((c2 >> 16) & 0xff) + 0.5f);
+                a = (uint32_t)(l0 * (c0 >> 24) + l1 * (c1 >> 24) + l2 * (c2 >> 24) + 0.5f);
+            }
+            uint32_t texel = flatTexel;
+            if (textured && !flatUv)
+                texel = SampleFont(l0 * v0->uv.x + l1 * v1->uv.x + l2 * v2->uv.x,
+                                   l0 * v0->uv.y + l1 * v1->uv.y + l2 * v2->uv.y);
+            a = (std::min(a, 255u) * texel + 127) / 255;
+            if (a)
+                row[x] = Blend(row[x], std::min(r, 255u), std::min(g, 255u), std::min(b, 255u), a);
+        }
+    }
+}
+
+// Window backgrounds, buttons and most other filled shapes are single-coloured axis-aligned rectangles,
+// which ImGui emits as triangles (a, b, c) and (a, c, d) going round the corners. Those are filled a
+// span at a time with no edge tests, which leaves the per-pixel path to text and anti-aliased fringes.
+// Returns false if the six indices are not such a rectangle.
+static bool FillRect(const ImDrawVert* vtx, const ImDrawIdx* idx, const ImVec4& clip, bool textured)
+{
+    if (idx[3] != idx[0] || idx[4] != idx[2])
+        return false;
+    const ImDrawVert &a = vtx[idx[0]], &b = vtx[idx[1]], &c = vtx[idx[2]], &d = vtx[idx[5]];
+    if (a.pos.y != b.pos.y || b.pos.x != c.pos.x || c.pos.y != d.pos.y || d.pos.x != a.pos.x)
+        return false;
+    if (a.col != b.col || a.col != c.col || a.col != d.col)
+        return false;
+    if (textured && (a.uv.x != c.uv.x || a.uv.y != c.uv.y || a.uv.x != b.uv.x || a.uv.y != b.uv.y || a.uv.x != d.uv.x || a.uv.y != d.uv.y))
+        return false;
+
+    // Pixels whose centres are inside, as for the triangles.
+    int x0 = std::max((int)clip.x, (int)ceilf(std::min(a.pos.x, c.pos.x) - 0.5f));
+    int x1 = std::min((int)ceilf(clip.z), (int)ceilf(std::max(a.pos.x, c.pos.x) - 0.5f));
+    int y0 = std::max((int)clip.y, (int)ceilf(std::min(a.pos.y, c.pos.y) - 0.5f));
+    int y1 = std::min((int)ceilf(clip.w), (int)ceilf(std::max(a.pos.y, c.pos.y) - 0.5f));
+    uint32_t texel = textured ? SampleFont(a.uv.x, a.uv.y) : 255;
+    uint32_t r = a.col & 0xff, g = (a.col >> 8) & 0xff, bl = (a.col >> 16) & 0xff;
+    uint32_t alpha = ((a.col >> 24) * texel + 127) / 255;
+    for (int y = y0; y < y1; y++)
+        FillSpan(&g_Framebuffer[(size_t)y * g_Width], x0, x1, r, g, bl, alpha);
+    return true;
+}
+
+static void ImGui_ImplHeadless_RenderDrawLists(ImDrawData* draw_data)
+{
+    PROFILE_ZONE("backend draw");
+
+    ImGuiIO& io = ImGui::GetIO();
+    g_Width = (int)io.DisplaySize.x;
+    g_Height = (int)io.DisplaySize.y;
+    if (g_Width <= 0 || g_Height <= 0)
+        return;
+    g_Framebuffer.assign((size_t)g_Width * g_Height, kClearColor);
+
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        const ImDrawVert* vtx_buffer = cmd_list->VtxBuffer.Data;
+        const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
+
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (pcmd->UserCallback)
+            {
+                pcmd->UserCallback(cmd_list, pcmd);
+            }
+            else
+            {
+                ImVec4 clip(std::max(pcmd->ClipRect.x, 0.0f), std::max(pcmd->ClipRect.y, 0.0f),
+                            std::min(pcmd->ClipRect.z, (float)g_Width), std::min(pcmd->ClipRect.w, (float)g_Height));
+                bool textured = pcmd->TextureId == (ImTextureID)g_FontPixels;
+                for (unsigned int i = 0; i + 2 < pcmd->ElemCount; i += 3)
+                {
+                    if (i + 5 < pcmd->ElemCount && FillRect(vtx_buffer, idx_buffer + i, clip, textured))
+                    {
+                        i += 3;
+                        continue;
+                    }
+                    DrawTriangle(&vtx_buffer[idx_buffer[i]], &vtx_buffer[idx_buffer[i + 1]], &vtx_buffer[idx_buffer[i + 2]], clip, textured);
+                }
+            }
+            idx_buffer += pcmd->ElemCount;
+        }
+    }
+}
+
+bool ImGui_ImplHeadless_ProcessEvent(SDL_Event* event)
+{
+    switch (event->type)
+    {
+    case SDL_MOUSEWHEEL:
+        {
+            if (event->wheel.y > 0)
+                g_MouseWheel = 1;
+            if (event->wheel.y < 0)
+                g_MouseWheel = -1;
+            return true;
+        }
+    case SDL_MOUSEMOTION:
+        {
+            g_MousePos = ImVec2((float)event->motion.x, (float)event->motion.y);
+            return true;
+        }
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+        {
+            int b = event->button.button == SDL_BUTTON_LEFT ? 0 : event->button.button == SDL_BUTTON_RIGHT ? 1 : event->button.button == SDL_BUTTON_MIDDLE ? 2 : -1;
+            g_MousePos = ImVec2((float)event->button.x, (float)event->button.y);
+            if (b >= 0)
+            {
+                g_MouseDown[b] = event->type == SDL_MOUSEBUTTONDOWN;
+                if (g_MouseDown[b])
+                    g_MousePressed[b] = true;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ImGui_ImplHeadless_Init(SDL_Window* window)
+{
+    (void)window;
+    ImGuiIO& io = ImGui::GetIO();
+    io.RenderDrawListsFn = ImGui_ImplHeadless_RenderDrawLists;
+    io.IniFilename = NULL;          // a replay must not depend on, or change, saved window state
+    return true;
+}
+
+void ImGui_ImplHeadless_Shutdown()
+{
+    ImGui::Shutdown();
+    g_FontPixels = NULL;
+    std::vector<uint32_t>().swap(g_Framebuffer);
+}
+
+void ImGui_ImplHeadless_NewFrame(SDL_Window* window)
+{
+    ImGuiIO& io = ImGui::GetIO();
+    if (!g_FontPixels)
+    {
+        io.Fonts->GetTexDataAsAlpha8(&g_FontPixels, &g_FontWidth, &g_FontHeight);
+        io.Fonts->TexID = (ImTextureID)g_FontPixels;
+    }
+
+    int w, h;
+    SDL_GetWindowSize(window, &w, &h);
+    io.DisplaySize = ImVec2((float)w, (float)h);
+    io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
+    io.DeltaTime = 1.0f / 60.0f;
+
+    // A press always counts as held for one frame, as in the SDL backends, so a tap whose down and up
+    // arrive together still clicks.
+    io.MousePos = g_MousePos;
+    for (int i = 0; i < 3; i++)
+    {
+        io.MouseDown[i] = g_MousePressed[i] || g_MouseDown[i];
+        g_MousePressed[i] = false;
+    }
+    io.MouseWheel = g_MouseWheel;
+    g_MouseWheel = 0.0f;
+
+    ImGui::NewFrame();
+}
+
+const uint32_t* ImGui_ImplHeadless_Framebuffer(int* width, int* height)
+{
+    *width = g_Width;
+    *height = g_Height;
+    return g_Framebuffer.empty() ? NULL : &g_Framebuffer[0];
+}
+
+uint64_t ImGui_ImplHeadless_FramebufferHash()
+{
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < g_Framebuffer.size(); i++)
+    {
+        h ^= g_Framebuffer[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
@@ -0,0 +1,24 @@
+// ImGui SDL2 binding with no GPU, for offscreen runs under SDL's dummy video driver.
+// Draw lists are rasterized in software into a framebuffer in memory. ImTextureID is a pointer to the
+// font atlas' alpha8 pixels. Input comes from SDL events only, since a replay's pushed events never reach
+// SDL's mouse state, and time advances a fixed 1/60 s per frame so that runs are repeatable.
+
+#ifndef IMGUI_IMPL_HEADLESS
+#define IMGUI_IMPL_HEADLESS
+
+#include <stdint.h>
+
+struct SDL_Window;
+typedef union SDL_Event SDL_Event;
+
+IMGUI_API bool        ImGui_ImplHeadless_Init(SDL_Window* window);
+IMGUI_API void        ImGui_ImplHeadless_Shutdown();
+IMGUI_API void        ImGui_ImplHeadless_NewFrame(SDL_Window* window);
+IMGUI_API bool        ImGui_ImplHeadless_ProcessEvent(SDL_Event* event);
+
+// RGBA8 pixels of the last frame drawn, row by row from the top.
+IMGUI_API const uint32_t* ImGui_ImplHeadless_Framebuffer(int* width, int* height);
+// 64-bit FNV-1a over the last frame, a pixel at a time, for checking that two runs drew the same thing.
+IMGUI_API uint64_t    ImGui_ImplHeadless_FramebufferHash();
+
+#endif // IMGUI_IMPL_HEADLESS
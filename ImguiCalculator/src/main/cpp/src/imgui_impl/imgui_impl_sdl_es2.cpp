@@ -8,6 +8,8 @@
 #ifdef GL_PROFILE_GLES2
 #include "imgui.h"
 #include "imgui_impl_sdl_es2.h"
+#include "profiler.h"
+#include "imgui_impl_gl_state.h"
 
 // SDL,GL3W
 #include <SDL.h>
@@ -23,12 +25,73 @@ static int          g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0;
 static int          g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
 static int          g_AttribLocationPosition = 0, g_AttribLocationUV = 0, g_AttribLocationColor = 0;
 static unsigned int g_VboHandle = 0, /*g_VaoHandle = 0,*/ g_ElementsHandle = 0;
+static bool         g_AppOwnsGLState = false;
+static ImGui_ImplGLFrameStats g_FrameStats;
+
+// Every GL call RenderDrawLists makes goes through one of these, so that g_FrameStats counts it.
+#define GL_QUERY(call)  (g_FrameStats.Queries++, call)
+#define GL_STATE(call)  (g_FrameStats.StateChanges++, call)
+#define GL_UPLOAD(call) (g_FrameStats.Uploads++, call)
+#define GL_DRAW(call)   (g_FrameStats.Draws++, call)
+
+// The GL state RenderDrawLists changes, saved before drawing and restored after unless the app owns GL state.
+struct ImGui_ImplSdlGLES2_SavedState
+{
+    GLint       ActiveTexture, Program, Texture, ArrayBuffer, ElementArrayBuffer;
+    GLint       BlendSrcRgb, BlendDstRgb, BlendSrcAlpha, BlendDstAlpha, BlendEquationRgb, BlendEquationAlpha;
+    GLint       Viewport[4], ScissorBox[4];
+    GLboolean   EnableBlend, EnableCullFace, EnableDepthTest, EnableScissorTest;
+};
+
+// Leaves texture unit 0 active, since the texture binding saved is unit 0's.
+static void ImGui_ImplSdlGLES2_SaveState(ImGui_ImplSdlGLES2_SavedState* s)
+{
+    GL_QUERY(glGetIntegerv(GL_ACTIVE_TEXTURE, &s->ActiveTexture));
+    GL_STATE(glActiveTexture(GL_TEXTURE0));
+    GL_QUERY(glGetIntegerv(GL_CURRENT_PROGRAM, &s->Program));
+    GL_QUERY(glGetIntegerv(GL_TEXTURE_BINDING_2D, &s->Texture));
+    GL_QUERY(glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &s->ArrayBuffer));
+    GL_QUERY(glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &s->ElementArrayBuffer));
+    // Note that your vertex buffer state is NOT saved, since es2 has no vertex array objects
+    GL_QUERY(glGetIntegerv(GL_BLEND_SRC_RGB, &s->BlendSrcRgb));
+    GL_QUERY(glGetIntegerv(GL_BLEND_DST_RGB, &s->BlendDstRgb));
+    GL_QUERY(glGetIntegerv(GL_BLEND_SRC_ALPHA, &s->BlendSrcAlpha));
+    GL_QUERY(glGetIntegerv(GL_BLEND_DST_ALPHA, &s->BlendDstAlpha));
+    GL_QUERY(glGetIntegerv(GL_BLEND_EQUATION_RGB, &s->BlendEquationRgb));
+    GL_QUERY(glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &s->BlendEquationAlpha));
+    GL_QUERY(glGetIntegerv(GL_VIEWPORT, s->Viewport));
+    GL_QUERY(glGetIntegerv(GL_SCISSOR_BOX, s->ScissorBox));
+    s->EnableBlend = GL_QUERY(glIsEnabled(GL_BLEND));
+    s->EnableCullFace = GL_QUERY(glIsEnabled(GL_CULL_FACE));
+    s->EnableDepthTest = GL_QUERY(glIsEnabled(GL_DEPTH_TEST));
+    s->EnableScissorTest = GL_QUERY(glIsEnabled(GL_SCISSOR_TEST));
+}
+
+static void ImGui_ImplSdlGLES2_RestoreState(const ImGui_ImplSdlGLES2_SavedState* s)
+{
+    GL_STATE(glUseProgram(s->Program));
+    GL_STATE(glBindTexture(GL_TEXTURE_2D, s->Texture));
+    GL_STATE(glActiveTexture(s->ActiveTexture));
+    GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, s->ArrayBuffer));
+    GL_STATE(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->ElementArrayBuffer));
+    GL_STATE(glBlendEquationSeparate(s->BlendEquationRgb, s->BlendEquationAlpha));
+    GL_STATE(glBlendFuncSeparate(s->BlendSrcRgb, s->BlendDstRgb, s->BlendSrcAlpha, s->BlendDstAlpha));
+    if (s->EnableBlend) GL_STATE(glEnable(GL_BLEND)); else GL_STATE(glDisable(GL_BLEND));
+    if (s->EnableCullFace) GL_STATE(glEnable(GL_CULL_FACE)); else GL_STATE(glDisable(GL_CULL_FACE));
+    if (s->EnableDepthTest) GL_STATE(glEnable(GL_DEPTH_TEST)); else GL_STATE(glDisable(GL_DEPTH_TEST));
+    if (s->EnableScissorTest) GL_STATE(glEnable(GL_SCISSOR_TEST)); else GL_STATE(glDisable(GL_SCISSOR_TEST));
+    GL_STATE(glViewport(s->Viewport[0], s->Viewport[1], (GLsizei)s->Viewport[2], (GLsizei)s->Viewport[3]));
+    GL_STATE(glScissor(s->ScissorBox[0], s->ScissorBox[1], (GLsizei)s->ScissorBox[2], (GLsizei)s->ScissorBox[3]));
+}
 
 // This is the main rendering function that you have to implement and provide to ImGui (via setting up 'RenderDrawListsFn' in the ImGuiIO structure)
 // If text or lines are blurry when integrating ImGui in your engine:
 // - in your Render function, try translating your projection matrix by (0.5f,0.5f) or (0.375f,0.375f)
 void ImGui_ImplSdlGLES2_RenderDrawLists(ImDrawData* draw_data)
 {
+    PROFILE_ZONE("backend draw");
+    g_FrameStats.Clear();
+
     // Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
     ImGuiIO& io = ImGui::GetIO();
     // Because of some weird handling of Android's virtual keyboard, we have to check if the Backspace button is pressed
@@ -43,38 +106,23 @@ void ImGui_ImplSdlGLES2_RenderDrawLists(ImDrawData* draw_data)
         return;
     draw_data->ScaleClipRects(io.DisplayFramebufferScale);
 
-    // Backup GL state
-    GLint last_active_texture; glGetIntegerv(GL_ACTIVE_TEXTURE, &last_active_texture);
-    glActiveTexture(GL_TEXTURE0);
-    GLint last_program; glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
-    GLint last_texture; glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
-    GLint last_array_buffer; glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &last_array_buffer);
-    GLint last_element_array_buffer; glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &last_element_array_buffer);
-    // Note that your vertex buffer state is NOT saved, since es2 has no vertex array objects
-    //GLint last_vertex_array; glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
-    GLint last_blend_src_rgb; glGetIntegerv(GL_BLEND_SRC_RGB, &last_blend_src_rgb);
-    GLint last_blend_dst_rgb; glGetIntegerv(GL_BLEND_DST_RGB, &last_blend_dst_rgb);
-    GLint last_blend_src_alpha; glGetIntegerv(GL_BLEND_SRC_ALPHA, &last_blend_src_alpha);
-    GLint last_blend_dst_alpha; glGetIntegerv(GL_BLEND_DST_ALPHA, &last_blend_dst_alpha);
-    GLint last_blend_equation_rgb; glGetIntegerv(GL_BLEND_EQUATION_RGB, &last_blend_equation_rgb);
-    GLint last_blend_equation_alpha; glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &last_blend_equation_alpha);
-    GLint last_viewport[4]; glGetIntegerv(GL_VIEWPORT, last_viewport);
-    GLint last_scissor_box[4]; glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
-    GLboolean last_enable_blend = glIsEnabled(GL_BLEND);
-    GLboolean last_enable_cull_face = glIsEnabled(GL_CULL_FACE);
-    GLboolean last_enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean last_enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+    // Backup GL state, unless the app owns it and wants none of it back
+    ImGui_ImplSdlGLES2_SavedState saved;
+    if (g_AppOwnsGLState)
+        GL_STATE(glActiveTexture(GL_TEXTURE0));
+    else
+        ImGui_ImplSdlGLES2_SaveState(&saved);
 
     // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled
-    glEnable(GL_BLEND);
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_SCISSOR_TEST);
+    GL_STATE(glEnable(GL_BLEND));
+    GL_STATE(glBlendEquation(GL_FUNC_ADD));
+    GL_STATE(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    GL_STATE(glDisable(GL_CULL_FACE));
+    GL_STATE(glDisable(GL_DEPTH_TEST));
+    GL_STATE(glEnable(GL_SCISSOR_TEST));
 
     // Setup viewport, orthographic projection matrix
-    glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
+    GL_STATE(glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height));
     const float ortho_projection[4][4] =
     {
         { 2.0f/io.DisplaySize.x, 0.0f,                   0.0f, 0.0f },
@@ -82,32 +130,34 @@ void ImGui_ImplSdlGLES2_RenderDrawLists(ImDrawData* draw_data)
         { 0.0f,                  0.0f,                  -1.0f, 0.0f },
         {-1.0f,                  1.0f,                   0.0f, 1.0f },
     };
-    glUseProgram(g_ShaderHandle);
-    glUniform1i(g_AttribLocationTex, 0);
-    glUniformMatrix4fv(g_AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
+    GL_STATE(glUseProgram(g_ShaderHandle));
+    GL_STATE(glUniform1i(g_AttribLocationTex, 0));
+    GL_STATE(glUniformMatrix4fv(g_AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]));
     //glBindVertexArray(g_VaoHandle);
 
-    glEnableVertexAttribArray(g_AttribLocationPosition);
-    glEnableVertexAttribArray(g_AttribLocationUV);
-    glEnableVertexAttribArray(g_AttribLocationColor);
+    GL_STATE(glEnableVertexAttribArray(g_AttribLocationPosition));
+    GL_STATE(glEnableVertexAttribArray(g_AttribLocationUV));
+    GL_STATE(glEnableVertexAttribArray(g_AttribLocationColor));
 
-    glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
+    GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle));
 #define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
-    glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, pos));
-    glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, uv));
-    glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, col));
+    GL_STATE(glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, pos)));
+    GL_STATE(glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, uv)));
+    GL_STATE(glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, col)));
 #undef OFFSETOF
 
+    // Consecutive commands mostly share a texture, and often a clip rect.
+    ImGui_ImplGLShadowState shadow;
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
         const ImDrawIdx* idx_buffer_offset = 0;
 
-        glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+        GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle));
+        GL_UPLOAD(glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW));
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        GL_STATE(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle));
+        GL_UPLOAD(glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW));
 
 
 
@@ -117,32 +167,30 @@ void ImGui_ImplSdlGLES2_RenderDrawLists(ImDrawData* draw_data)
             if (pcmd->UserCallback)
             {
                 pcmd->UserCallback(cmd_list, pcmd);
+                shadow.Forget();    // it may have bound another texture or set the scissor box
             }
             else
             {
-                glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
-                glScissor((int)pcmd->ClipRect.x, (int)(fb_height - pcmd->ClipRect.w), (int)(pcmd->ClipRect.z - pcmd->ClipRect.x), (int)(pcmd->ClipRect.w - pcmd->ClipRect.y));
-                glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset);
+                GLuint texture = (GLuint)(intptr_t)pcmd->TextureId;
+                int clip_x = (int)pcmd->ClipRect.x, clip_y = (int)(fb_height - pcmd->ClipRect.w);
+                int clip_w = (int)(pcmd->ClipRect.z - pcmd->ClipRect.x), clip_h = (int)(pcmd->ClipRect.w - pcmd->ClipRect.y);
+                if (shadow.SetTexture(texture))
+                    GL_STATE(glBindTexture(GL_TEXTURE_2D, texture));
+                else
+                    g_FrameStats.Skipped++;
+                if (shadow.SetScissor(clip_x, clip_y, clip_w, clip_h))
+                    GL_STATE(glScissor(clip_x, clip_y, clip_w, clip_h));
+                else
+                    g_FrameStats.Skipped++;
+                GL_DRAW(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset));
             }
             idx_buffer_offset += pcmd->ElemCount;
         }
     }
 
     // Restore modified GL state
-    glUseProgram(last_program);
-    glBindTexture(GL_TEXTURE_2D, last_texture);
-    glActiveTexture(last_active_texture);
-    //glBindVertexArray(last_vertex_array);
-    glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, last_element_array_buffer);
-    glBlendEquationSeparate(last_blend_equation_rgb, last_blend_equation_alpha);
-    glBlendFuncSeparate(last_blend_src_rgb, last_blend_dst_rgb, last_blend_src_alpha, last_blend_dst_alpha);
-    if (last_enable_blend) glEnable(GL_BLEND); else glDisable(GL_BLEND);
-    if (last_enable_cull_face) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
-    if (last_enable_depth_test) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
-    if (last_enable_scissor_test) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST);
-    glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
-    glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+    if (!g_AppOwnsGLState)
+        ImGui_ImplSdlGLES2_RestoreState(&saved);
 }
 
 static const char* ImGui_ImplSdlGLES2_GetClipboardText(void*)
@@ -300,7 +348,6 @@ bool ImGui_ImplSdlGLES2_CreateDeviceObjects()
     // Restore modified GL state
     glBindTexture(GL_TEXTURE_2D, last_texture);
     glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-    //glBindVertexArray(last_vertex_array);
 
     return true;
 }
@@ -377,6 +424,16 @@ void ImGui_ImplSdlGLES2_Shutdown()
     ImGui::Shutdown();
 }
 
+void ImGui_ImplSdlGLES2_SetAppOwnsGLState(bool app_owns_state)
+{
+    g_AppOwnsGLState = app_owns_state;
+}
+
+const ImGui_ImplGLFrameStats& ImGui_ImplSdlGLES2_GetFrameStats()
+{
+    return g_FrameStats;
+}
+
 void ImGui_ImplSdlGLES2_NewFrame(SDL_Window* window)
 {
     if (!g_FontTexture)
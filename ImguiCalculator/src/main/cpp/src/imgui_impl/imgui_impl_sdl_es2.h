@@ -13,6 +13,7 @@
 
 struct SDL_Window;
 typedef union SDL_Event SDL_Event;
+struct ImGui_ImplGLFrameStats;
 
 IMGUI_API bool        ImGui_ImplSdlGLES2_Init(SDL_Window* window);
 IMGUI_API void        ImGui_ImplSdlGLES2_Shutdown();
@@ -23,6 +24,12 @@ IMGUI_API bool        ImGui_ImplSdlGLES2_ProcessEvent(SDL_Event* event);
 IMGUI_API void        ImGui_ImplSdlGLES2_InvalidateDeviceObjects();
 IMGUI_API bool        ImGui_ImplSdlGLES2_CreateDeviceObjects();
 
+// RenderDrawLists saves the GL state it changes and restores it afterwards, which takes some 20 glGet calls a frame.
+// An app that sets the state it needs itself before drawing can own GL state instead: nothing is saved or restored.
+IMGUI_API void        ImGui_ImplSdlGLES2_SetAppOwnsGLState(bool app_owns_state);
+// GL calls made by the last ImGui::Render().
+IMGUI_API const ImGui_ImplGLFrameStats& ImGui_ImplSdlGLES2_GetFrameStats();
+
 #endif // IMGUI_IMPL_SDL_ES2
 
 #endif // GL_PROFILE_GLES2
\ No newline at end of file
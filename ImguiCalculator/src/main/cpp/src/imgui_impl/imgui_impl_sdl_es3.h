@@ -13,6 +13,7 @@
 
 struct SDL_Window;
 typedef union SDL_Event SDL_Event;
+struct ImGui_ImplGLFrameStats;
 
 IMGUI_API bool        ImGui_ImplSdlGLES3_Init(SDL_Window* window);
 IMGUI_API void        ImGui_ImplSdlGLES3_Shutdown();
@@ -23,5 +24,11 @@ IMGUI_API bool        ImGui_ImplSdlGLES3_ProcessEvent(SDL_Event* event);
 IMGUI_API void        ImGui_ImplSdlGLES3_InvalidateDeviceObjects();
 IMGUI_API bool        ImGui_ImplSdlGLES3_CreateDeviceObjects();
 
+// RenderDrawLists saves the GL state it changes and restores it afterwards, which takes some 20 glGet calls a frame.
+// An app that sets the state it needs itself before drawing can own GL state instead: nothing is saved or restored.
+IMGUI_API void        ImGui_ImplSdlGLES3_SetAppOwnsGLState(bool app_owns_state);
+// GL calls made by the last ImGui::Render().
+IMGUI_API const ImGui_ImplGLFrameStats& ImGui_ImplSdlGLES3_GetFrameStats();
+
 #endif // IMGUI_IMPL_SDL_ES3
 #endif // GL_PROFILE_GLES3
\ No newline at end of file
@@ -9,6 +9,8 @@
 
 #include "imgui.h"
 #include "imgui_impl_sdl_gl3.h"
+#include "profiler.h"
+#include "imgui_impl_gl_state.h"
 
 // SDL,GL3W
 #include <SDL.h>
@@ -25,12 +27,153 @@ static int          g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0;
 static int          g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
 static int          g_AttribLocationPosition = 0, g_AttribLocationUV = 0, g_AttribLocationColor = 0;
 static unsigned int g_VboHandle = 0, g_VaoHandle = 0, g_ElementsHandle = 0;
+static bool         g_AppOwnsGLState = false;
+static ImGui_ImplGLFrameStats g_FrameStats;
+
+// Every GL call RenderDrawLists makes goes through one of these, so that g_FrameStats counts it.
+#define GL_QUERY(call)  (g_FrameStats.Queries++, call)
+#define GL_STATE(call)  (g_FrameStats.StateChanges++, call)
+#define GL_UPLOAD(call) (g_FrameStats.Uploads++, call)
+#define GL_DRAW(call)   (g_FrameStats.Draws++, call)
+
+// Every draw list of a frame is copied into one region of g_VboHandle and one of g_ElementsHandle, so a frame
+// costs one upload per buffer however many lists it has. Each buffer holds g_FramesInFlight regions used in
+// turn; the fence set after a frame's draws says when the GPU has finished reading its regions, so they are
+// mapped unsynchronized and the driver never has to stall or orphan storage. Regions grow by doubling when
+// a frame does not fit, which is the only time storage is reallocated.
+static const int    g_FramesInFlight = 3;
+static int          g_VtxRegionCount = 0, g_IdxRegionCount = 0;    // vertices / indices per region
+static int          g_Region = 0;
+static GLsync       g_RegionFence[g_FramesInFlight] = { 0, 0, 0 };
+
+static void ImGui_ImplSdlGL3_DeleteFences()
+{
+    for (int i = 0; i < g_FramesInFlight; i++)
+    {
+        if (g_RegionFence[i])
+            GL_UPLOAD(glDeleteSync(g_RegionFence[i]));
+        g_RegionFence[i] = 0;
+    }
+}
+
+// Copies every list's vertices and indices, back to back, into the next region, growing the buffers first if
+// need be. Draws then take the region's first vertex and first index byte offset. Expects g_VaoHandle bound.
+static bool ImGui_ImplSdlGL3_UploadDrawData(ImDrawData* draw_data, GLint* first_vtx, GLsizeiptr* first_idx_offset)
+{
+    PROFILE_ZONE("backend upload");
+    GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle));
+    GL_STATE(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle));
+    if (draw_data->TotalVtxCount > g_VtxRegionCount || draw_data->TotalIdxCount > g_IdxRegionCount)
+    {
+        // The old storage is orphaned; the driver keeps it until the GPU is done with it, so fences on it
+        // no longer matter.
+        while (g_VtxRegionCount < draw_data->TotalVtxCount)
+            g_VtxRegionCount = g_VtxRegionCount ? g_VtxRegionCount * 2 : 16384;
+        while (g_IdxRegionCount < draw_data->TotalIdxCount)
+            g_IdxRegionCount = g_IdxRegionCount ? g_IdxRegionCount * 2 : 32768;
+        GL_UPLOAD(glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)g_VtxRegionCount * g_FramesInFlight * sizeof(ImDrawVert), NULL, GL_STREAM_DRAW));
+        GL_UPLOAD(glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)g_IdxRegionCount * g_FramesInFlight * sizeof(ImDrawIdx), NULL, GL_STREAM_DRAW));
+        ImGui_ImplSdlGL3_DeleteFences();
+        g_Region = 0;
+    }
+
+    // The region was last drawn from g_FramesInFlight frames ago, so this rarely waits.
+    if (GLsync fence = g_RegionFence[g_Region])
+    {
+        GLenum status;
+        do
+            status = GL_UPLOAD(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000));
+        while (status == GL_TIMEOUT_EXPIRED);
+        GL_UPLOAD(glDeleteSync(fence));
+        g_RegionFence[g_Region] = 0;
+    }
+
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    *first_vtx = g_Region * g_VtxRegionCount;
+    *first_idx_offset = (GLsizeiptr)g_Region * g_IdxRegionCount * sizeof(ImDrawIdx);
+    ImDrawVert* vtx_dst = (ImDrawVert*)GL_UPLOAD(glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)*first_vtx * sizeof(ImDrawVert),
+                                                                  (GLsizeiptr)draw_data->TotalVtxCount * sizeof(ImDrawVert), access));
+    ImDrawIdx* idx_dst = (ImDrawIdx*)GL_UPLOAD(glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)*first_idx_offset,
+                                                                (GLsizeiptr)draw_data->TotalIdxCount * sizeof(ImDrawIdx), access));
+    if (vtx_dst && idx_dst)
+    {
+        for (int n = 0; n < draw_data->CmdListsCount; n++)
+        {
+            const ImDrawList* cmd_list = draw_data->CmdLists[n];
+            memcpy(vtx_dst, cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+            memcpy(idx_dst, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+            vtx_dst += cmd_list->VtxBuffer.Size;
+            idx_dst += cmd_list->IdxBuffer.Size;
+        }
+    }
+    // Unmapping fails if the contents were lost meanwhile, e.g. to a mode switch; the frame is skipped.
+    bool ok = vtx_dst && idx_dst;
+    if (vtx_dst && !GL_UPLOAD(glUnmapBuffer(GL_ARRAY_BUFFER)))
+        ok = false;
+    if (idx_dst && !GL_UPLOAD(glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER)))
+        ok = false;
+    return ok;
+}
+
+// The GL state RenderDrawLists changes, saved before drawing and restored after unless the app owns GL state.
+struct ImGui_ImplSdlGL3_SavedState
+{
+    GLint       ActiveTexture, Program, Texture, ArrayBuffer, ElementArrayBuffer, VertexArray;
+    GLint       BlendSrcRgb, BlendDstRgb, BlendSrcAlpha, BlendDstAlpha, BlendEquationRgb, BlendEquationAlpha;
+    GLint       Viewport[4], ScissorBox[4];
+    GLboolean   EnableBlend, EnableCullFace, EnableDepthTest, EnableScissorTest;
+};
+
+// Leaves texture unit 0 active, since the texture binding saved is unit 0's.
+static void ImGui_ImplSdlGL3_SaveState(ImGui_ImplSdlGL3_SavedState* s)
+{
+    GL_QUERY(glGetIntegerv(GL_ACTIVE_TEXTURE, &s->ActiveTexture));
+    GL_STATE(glActiveTexture(GL_TEXTURE0));
+    GL_QUERY(glGetIntegerv(GL_CURRENT_PROGRAM, &s->Program));
+    GL_QUERY(glGetIntegerv(GL_TEXTURE_BINDING_2D, &s->Texture));
+    GL_QUERY(glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &s->ArrayBuffer));
+    GL_QUERY(glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &s->ElementArrayBuffer));
+    GL_QUERY(glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &s->VertexArray));
+    GL_QUERY(glGetIntegerv(GL_BLEND_SRC_RGB, &s->BlendSrcRgb));
+    GL_QUERY(glGetIntegerv(GL_BLEND_DST_RGB, &s->BlendDstRgb));
+    GL_QUERY(glGetIntegerv(GL_BLEND_SRC_ALPHA, &s->BlendSrcAlpha));
+    GL_QUERY(glGetIntegerv(GL_BLEND_DST_ALPHA, &s->BlendDstAlpha));
+    GL_QUERY(glGetIntegerv(GL_BLEND_EQUATION_RGB, &s->BlendEquationRgb));
+    GL_QUERY(glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &s->BlendEquationAlpha));
+    GL_QUERY(glGetIntegerv(GL_VIEWPORT, s->Viewport));
+    GL_QUERY(glGetIntegerv(GL_SCISSOR_BOX, s->ScissorBox));
+    s->EnableBlend = GL_QUERY(glIsEnabled(GL_BLEND));
+    s->EnableCullFace = GL_QUERY(glIsEnabled(GL_CULL_FACE));
+    s->EnableDepthTest = GL_QUERY(glIsEnabled(GL_DEPTH_TEST));
+    s->EnableScissorTest = GL_QUERY(glIsEnabled(GL_SCISSOR_TEST));
+}
+
+static void ImGui_ImplSdlGL3_RestoreState(const ImGui_ImplSdlGL3_SavedState* s)
+{
+    GL_STATE(glUseProgram(s->Program));
+    GL_STATE(glBindTexture(GL_TEXTURE_2D, s->Texture));
+    GL_STATE(glActiveTexture(s->ActiveTexture));
+    GL_STATE(glBindVertexArray(s->VertexArray));
+    GL_STATE(glBindBuffer(GL_ARRAY_BUFFER, s->ArrayBuffer));
+    GL_STATE(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->ElementArrayBuffer));
+    GL_STATE(glBlendEquationSeparate(s->BlendEquationRgb, s->BlendEquationAlpha));
+    GL_STATE(glBlendFuncSeparate(s->BlendSrcRgb, s->BlendDstRgb, s->BlendSrcAlpha, s->BlendDstAlpha));
+    if (s->EnableBlend) GL_STATE(glEnable(GL_BLEND)); else GL_STATE(glDisable(GL_BLEND));
+    if (s->EnableCullFace) GL_STATE(glEnable(GL_CULL_FACE)); else GL_STATE(glDisable(GL_CULL_FACE));
+    if (s->EnableDepthTest) GL_STATE(glEnable(GL_DEPTH_TEST)); else GL_STATE(glDisable(GL_DEPTH_TEST));
+    if (s->EnableScissorTest) GL_STATE(glEnable(GL_SCISSOR_TEST)); else GL_STATE(glDisable(GL_SCISSOR_TEST));
+    GL_STATE(glViewport(s->Viewport[0], s->Viewport[1], (GLsizei)s->Viewport[2], (GLsizei)s->Viewport[3]));
+    GL_STATE(glScissor(s->ScissorBox[0], s->ScissorBox[1], (GLsizei)s->ScissorBox[2], (GLsizei)s->ScissorBox[3]));
+}
 
 // This is the main rendering function that you have to implement and provide to ImGui (via setting up 'RenderDrawListsFn' in the ImGuiIO structure)
 // If text or lines are blurry when integrating ImGui in your engine:
 // - in your Render function, try translating your projection matrix by (0.5f,0.5f) or (0.375f,0.375f)
 void ImGui_ImplSdlGL3_RenderDrawLists(ImDrawData* draw_data)
 {
+    PROFILE_ZONE("backend draw");
+    g_FrameStats.Clear();
+
     // Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
     ImGuiIO& io = ImGui::GetIO();
     int fb_width = (int)(io.DisplaySize.x * io.DisplayFramebufferScale.x);
@@ -39,37 +182,23 @@ void ImGui_ImplSdlGL3_RenderDrawLists(ImDrawData* draw_data)
         return;
     draw_data->ScaleClipRects(io.DisplayFramebufferScale);
 
-    // Backup GL state
-    GLint last_active_texture; glGetIntegerv(GL_ACTIVE_TEXTURE, &last_active_texture);
-    glActiveTexture(GL_TEXTURE0);
-    GLint last_program; glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
-    GLint last_texture; glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
-    GLint last_array_buffer; glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &last_array_buffer);
-    GLint last_element_array_buffer; glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &last_element_array_buffer);
-    GLint last_vertex_array; glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
-    GLint last_blend_src_rgb; glGetIntegerv(GL_BLEND_SRC_RGB, &last_blend_src_rgb);
-    GLint last_blend_dst_rgb; glGetIntegerv(GL_BLEND_DST_RGB, &last_blend_dst_rgb);
-    GLint last_blend_src_alpha; glGetIntegerv(GL_BLEND_SRC_ALPHA, &last_blend_src_alpha);
-    GLint last_blend_dst_alpha; glGetIntegerv(GL_BLEND_DST_ALPHA, &last_blend_dst_alpha);
-    GLint last_blend_equation_rgb; glGetIntegerv(GL_BLEND_EQUATION_RGB, &last_blend_equation_rgb);
-    GLint last_blend_equation_alpha; glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &last_blend_equation_alpha);
-    GLint last_viewport[4]; glGetIntegerv(GL_VIEWPORT, last_viewport);
-    GLint last_scissor_box[4]; glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
-    GLboolean last_enable_blend = glIsEnabled(GL_BLEND);
-    GLboolean last_enable_cull_face = glIsEnabled(GL_CULL_FACE);
-    GLboolean last_enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean last_enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+    // Backup GL state, unless the app owns it and wants none of it back
+    ImGui_ImplSdlGL3_SavedState saved;
+    if (g_AppOwnsGLState)
+        GL_STATE(glActiveTexture(GL_TEXTURE0));
+    else
+        ImGui_ImplSdlGL3_SaveState(&saved);
 
     // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled
-    glEnable(GL_BLEND);
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_SCISSOR_TEST);
+    GL_STATE(glEnable(GL_BLEND));
+    GL_STATE(glBlendEquation(GL_FUNC_ADD));
+    GL_STATE(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    GL_STATE(glDisable(GL_CULL_FACE));
+    GL_STATE(glDisable(GL_DEPTH_TEST));
+    GL_STATE(glEnable(GL_SCISSOR_TEST));
 
     // Setup viewport, orthographic projection matrix
-    glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
+    GL_STATE(glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height));
     const float ortho_projection[4][4] =
     {
         { 2.0f/io.DisplaySize.x, 0.0f,                   0.0f, 0.0f },
@@ -77,21 +206,20 @@ void ImGui_ImplSdlGL3_RenderDrawLists(ImDrawData* draw_data)
         { 0.0f,                  0.0f,                  -1.0f, 0.0f },
         {-1.0f,                  1.0f,                   0.0f, 1.0f },
     };
-    glUseProgram(g_ShaderHandle);
-    glUniform1i(g_AttribLocationTex, 0);
-    glUniformMatrix4fv(g_AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
-    glBindVertexArray(g_VaoHandle);
-
-    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    GL_STATE(glUseProgram(g_ShaderHandle));
+    GL_STATE(glUniform1i(g_AttribLocationTex, 0));
+    GL_STATE(glUniformMatrix4fv(g_AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]));
+    GL_STATE(glBindVertexArray(g_VaoHandle));
+
+    // Consecutive commands mostly share a texture, and often a clip rect.
+    ImGui_ImplGLShadowState shadow;
+    GLint first_vtx = 0;
+    GLsizeiptr first_idx_offset = 0;
+    bool uploaded = draw_data->TotalVtxCount > 0 && ImGui_ImplSdlGL3_UploadDrawData(draw_data, &first_vtx, &first_idx_offset);
+    for (int n = 0; uploaded && n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
-        const ImDrawIdx* idx_buffer_offset = 0;
-
-        glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        const ImDrawIdx* idx_buffer_offset = (const ImDrawIdx*)first_idx_offset;
 
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
@@ -99,32 +227,37 @@ void ImGui_ImplSdlGL3_RenderDrawLists(ImDrawData* draw_data)
             if (pcmd->UserCallback)
             {
                 pcmd->UserCallback(cmd_list, pcmd);
+                shadow.Forget();    // it may have bound another texture or set the scissor box
             }
             else
             {
-                glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
-                glScissor((int)pcmd->ClipRect.x, (int)(fb_height - pcmd->ClipRect.w), (int)(pcmd->ClipRect.z - pcmd->ClipRect.x), (int)(pcmd->ClipRect.w - pcmd->ClipRect.y));
-                glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset);
+                GLuint texture = (GLuint)(intptr_t)pcmd->TextureId;
+                int clip_x = (int)pcmd->ClipRect.x, clip_y = (int)(fb_height - pcmd->ClipRect.w);
+                int clip_w = (int)(pcmd->ClipRect.z - pcmd->ClipRect.x), clip_h = (int)(pcmd->ClipRect.w - pcmd->ClipRect.y);
+                if (shadow.SetTexture(texture))
+                    GL_STATE(glBindTexture(GL_TEXTURE_2D, texture));
+                else
+                    g_FrameStats.Skipped++;
+                if (shadow.SetScissor(clip_x, clip_y, clip_w, clip_h))
+                    GL_STATE(glScissor(clip_x, clip_y, clip_w, clip_h));
+                else
+                    g_FrameStats.Skipped++;
+                GL_DRAW(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset, first_vtx));
             }
             idx_buffer_offset += pcmd->ElemCount;
         }
+        first_vtx += cmd_list->VtxBuffer.Size;
+        first_idx_offset += (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+    }
+    if (uploaded)
+    {
+        g_RegionFence[g_Region] = GL_UPLOAD(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+        g_Region = (g_Region + 1) % g_FramesInFlight;
     }
 
     // Restore modified GL state
-    glUseProgram(last_program);
-    glBindTexture(GL_TEXTURE_2D, last_texture);
-    glActiveTexture(last_active_texture);
-    glBindVertexArray(last_vertex_array);
-    glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, last_element_array_buffer);
-    glBlendEquationSeparate(last_blend_equation_rgb, last_blend_equation_alpha);
-    glBlendFuncSeparate(last_blend_src_rgb, last_blend_dst_rgb, last_blend_src_alpha, last_blend_dst_alpha);
-    if (last_enable_blend) glEnable(GL_BLEND); else glDisable(GL_BLEND);
-    if (last_enable_cull_face) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
-    if (last_enable_depth_test) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
-    if (last_enable_scissor_test) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST);
-    glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
-    glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+    if (!g_AppOwnsGLState)
+        ImGui_ImplSdlGL3_RestoreState(&saved);
 }
 
 static const char* ImGui_ImplSdlGL3_GetClipboardText(void*)
@@ -281,6 +414,9 @@ bool ImGui_ImplSdlGL3_CreateDeviceObjects()
 
 void    ImGui_ImplSdlGL3_InvalidateDeviceObjects()
 {
+    ImGui_ImplSdlGL3_DeleteFences();
+    g_VtxRegionCount = g_IdxRegionCount = 0;
+    g_Region = 0;
     if (g_VaoHandle) glDeleteVertexArrays(1, &g_VaoHandle);
     if (g_VboHandle) glDeleteBuffers(1, &g_VboHandle);
     if (g_ElementsHandle) glDeleteBuffers(1, &g_ElementsHandle);
@@ -351,6 +487,16 @@ void ImGui_ImplSdlGL3_Shutdown()
     ImGui::Shutdown();
 }
 
+void ImGui_ImplSdlGL3_SetAppOwnsGLState(bool app_owns_state)
+{
+    g_AppOwnsGLState = app_owns_state;
+}
+
+const ImGui_ImplGLFrameStats& ImGui_ImplSdlGL3_GetFrameStats()
+{
+    return g_FrameStats;
+}
+
 void ImGui_ImplSdlGL3_NewFrame(SDL_Window* window)
 {
     if (!g_FontTexture)
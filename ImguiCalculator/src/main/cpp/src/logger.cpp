@@ -0,0 +1,637 @@
+//
+// Asynchronous backend for logger.h: per-thread rings drained by a writer
+// thread.
+//
+#include "logger.h"
+#include "calc_spsc.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOG_TAG "NativeApp"
+#endif
+
+namespace _Logger {
+
+    namespace {
+
+        struct Record {
+            uint64_t seq;           // order across threads
+            uint32_t severity;
+            const Site* site;       // a LogEvent's, whose arguments are in line
+            uint64_t timeNs;        // LogEvent only
+            Line line;
+        };
+
+        struct Ring {
+            calc::SpscQueue<Record, Logger::kRingLines> lines;
+            // Set by the owning thread as it exits, after its last push.
+            std::atomic<bool> retired;
+        };
+
+#ifdef __ANDROID__
+        int getPrio(uint32_t severity)
+        {
+            switch (severity) {
+                case LOG_DEBUG:
+                    return ANDROID_LOG_DEBUG;
+                case LOG_INFO:
+                    return ANDROID_LOG_INFO;
+                case LOG_WARN:
+                    return ANDROID_LOG_WARN;
+                case LOG_ERROR:
+                    return ANDROID_LOG_ERROR;
+                default:
+                    return ANDROID_LOG_FATAL;
+            }
+        }
+#endif
+
+        std::atomic<uint64_t> nextSeq(0);
+        // True while the writer thread runs.
+        std::atomic<bool> running(false);
+
+        // Allocated on first use and never freed, so lines logged from
+        // static destructors still find it.
+        struct Backend {
+            std::mutex registryLock;
+            std::vector<Ring*> rings;
+            bool started;
+
+            std::thread writer;
+            std::mutex sleepLock;
+            std::condition_variable wake;
+            bool wakeRequested;
+            bool stopping;
+
+            // Held while draining, so rings have one consumer at a time.
+            // Guards everything below.
+            std::mutex drainLock;
+            FILE* file;
+            std::vector<Ring*> snapshot;
+            std::vector<Record> batch;
+            std::vector<const Record*> order;
+            std::string out;
+            std::string err;
+            std::string line;
+            // Set by setEventFile, with the ids its sites were given.
+            FILE* events;
+            std::string eventOut;
+            std::unordered_map<const Site*, uint32_t> siteIds;
+
+            Backend() : started(false), wakeRequested(false), stopping(false), file(NULL), events(NULL) {}
+        };
+
+        Backend& backend()
+        {
+            static Backend* b = new Backend;
+            return *b;
+        }
+
+        thread_local Ring* threadRing = NULL;
+        // Set once the thread's ring is retired; its later lines are written
+        // synchronously.
+        thread_local bool threadDetached = false;
+
+        struct RingRetirer {
+            Ring* ring;
+            RingRetirer() : ring(NULL) {}
+            ~RingRetirer()
+            {
+                if (ring)
+                    ring->retired.store(true, std::memory_order_release);
+                threadRing = NULL;
+                threadDetached = true;
+            }
+        };
+
+        uint64_t nowNs()
+        {
+            static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+            return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - epoch).count();
+        }
+
+        // Writes v's digits to the bytes just before end; returns how many.
+        size_t formatUnsigned(char* end, unsigned long long v)
+        {
+            size_t n = 0;
+            do {
+                *(end - ++n) = (char) ('0' + v % 10);
+                v /= 10;
+            } while (v);
+            return n;
+        }
+
+        // What an ostream with default flags prints.
+        size_t formatDouble(char* s, size_t size, double v)
+        {
+            int n = snprintf(s, size, "%g", v);
+            return n > 0 ? (size_t) n : 0;
+        }
+
+        // Appends the argument packed at args[pos] and moves pos past it.
+        // False at ARG_CUT, or at anything that is not a whole argument.
+        bool formatArg(const char* args, size_t size, size_t& pos, std::string& out)
+        {
+            unsigned char tag = (unsigned char) args[pos];
+            size_t left = size - pos - 1;
+            const char* value = args + pos + 1;
+            char s[32];
+            if (tag == ARG_INT && left >= sizeof(int64_t)) {
+                int64_t v;
+                memcpy(&v, value, sizeof(v));
+                if (v < 0)
+                    out += '-';
+                size_t n = formatUnsigned(s + sizeof(s), v < 0 ? 0ull - (uint64_t) v : (uint64_t) v);
+                out.append(s + sizeof(s) - n, n);
+                pos += 1 + sizeof(v);
+            } else if (tag == ARG_UINT && left >= sizeof(uint64_t)) {
+                uint64_t v;
+                memcpy(&v, value, sizeof(v));
+                size_t n = formatUnsigned(s + sizeof(s), v);
+                out.append(s + sizeof(s) - n, n);
+                pos += 1 + sizeof(v);
+            } else if (tag == ARG_DOUBLE && left >= sizeof(double)) {
+                double v;
+                memcpy(&v, value, sizeof(v));
+                out.append(s, formatDouble(s, sizeof(s), v));
+                pos += 1 + sizeof(v);
+            } else if (tag == ARG_STRING && left >= sizeof(uint16_t)) {
+                uint16_t n;
+                memcpy(&n, value, sizeof(n));
+                if (left - sizeof(n) < n)
+                    return false;
+                out.append(value + sizeof(n), n);
+                pos += 1 + sizeof(n) + n;
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        bool byOrder(const Record* a, const Record* b)
+        {
+            return a->seq < b->seq;
+        }
+
+        // Appends r's text, less its severity tag.
+        void formatRecord(const Record& r, std::string& out)
+        {
+            if (r.site)
+                formatEvent(r.site->format, r.line.data(), r.line.size(), out);
+            else
+                r.line.format(out);
+        }
+
+        template <typename T>
+        void put(std::string& out, T v)
+        {
+            out.append((const char*) &v, sizeof(v));
+        }
+
+        void putSized(std::string& out, const char* s, size_t n)
+        {
+            n = std::min<size_t>(n, 0xffff);
+            put<uint16_t>(out, (uint16_t) n);
+            out.append(s, n);
+        }
+
+        // Appends r to the event file's batch, after a record of its site if
+        // this is the site's first event in the file.
+        void encodeEvent(Backend& b, const Record& r)
+        {
+            std::unordered_map<const Site*, uint32_t>::iterator it = b.siteIds.find(r.site);
+            uint32_t id;
+            if (it == b.siteIds.end()) {
+                id = (uint32_t) b.siteIds.size();
+                b.siteIds[r.site] = id;
+                b.eventOut += 'S';
+                put<uint32_t>(b.eventOut, id);
+                put<uint8_t>(b.eventOut, (uint8_t) r.site->severity);
+                put<uint32_t>(b.eventOut, (uint32_t) r.site->line);
+                putSized(b.eventOut, r.site->file, strlen(r.site->file));
+                putSized(b.eventOut, r.site->format, strlen(r.site->format));
+            } else {
+                id = it->second;
+            }
+            b.eventOut += 'E';
+            put<uint32_t>(b.eventOut, id);
+            put<uint64_t>(b.eventOut, r.timeNs);
+            putSized(b.eventOut, r.line.data(), r.line.size());
+        }
+
+        void emit(Backend& b, const Record* const* lines, size_t count)
+        {
+            b.out.clear();
+            b.err.clear();
+            b.eventOut.clear();
+            for (size_t i = 0; i < count; ++i) {
+                const Record& r = *lines[i];
+                if (r.site && b.events) {
+                    encodeEvent(b, r);
+                    continue;
+                }
+#ifdef __ANDROID__
+                if (!b.file) {
+                    b.line.clear();
+                    formatRecord(r, b.line);
+                    __android_log_print(getPrio(r.severity), LOG_TAG, "%s", b.line.c_str());
+                    continue;
+                }
+#endif
+                std::string& s = !b.file && r.severity >= LOG_ERROR ? b.err : b.out;
+                s += severityTag(r.severity);
+                formatRecord(r, s);
+                s += '\n';
+            }
+            FILE* out = b.file ? b.file : stdout;
+            if (!b.out.empty()) {
+                fwrite(b.out.data(), 1, b.out.size(), out);
+                fflush(out);
+            }
+            if (!b.err.empty()) {
+                fwrite(b.err.data(), 1, b.err.size(), stderr);
+                fflush(stderr);
+            }
+            if (!b.eventOut.empty()) {
+                fwrite(b.eventOut.data(), 1, b.eventOut.size(), b.events);
+                fflush(b.events);
+            }
+        }
+
+        // Writes every line waiting in a ring, in the order logged, and frees
+        // the rings of threads that have exited. Needs drainLock.
+        void drainLocked(Backend& b)
+        {
+            {
+                std::lock_guard<std::mutex> lock(b.registryLock);
+                b.snapshot = b.rings;
+            }
+            b.batch.clear();
+            for (size_t i = 0; i < b.snapshot.size(); ++i) {
+                Ring* ring = b.snapshot[i];
+                bool retired = ring->retired.load(std::memory_order_acquire);
+                Record r;
+                while (ring->lines.pop(r))
+                    b.batch.push_back(r);
+                if (retired) {
+                    std::lock_guard<std::mutex> lock(b.registryLock);
+                    b.rings.erase(std::find(b.rings.begin(), b.rings.end(), ring));
+                    delete ring;
+                }
+            }
+            if (b.batch.empty())
+                return;
+            b.order.clear();
+            for (size_t i = 0; i < b.batch.size(); ++i)
+                b.order.push_back(&b.batch[i]);
+            std::sort(b.order.begin(), b.order.end(), byOrder);
+            emit(b, b.order.data(), b.order.size());
+        }
+
+        void writeNow(const Record& r)
+        {
+            Backend& b = backend();
+            std::lock_guard<std::mutex> lock(b.drainLock);
+            drainLocked(b);
+            const Record* record = &r;
+            emit(b, &record, 1);
+        }
+
+        void requestWake()
+        {
+            Backend& b = backend();
+            {
+                std::lock_guard<std::mutex> lock(b.sleepLock);
+                b.wakeRequested = true;
+            }
+            b.wake.notify_one();
+        }
+
+        void writerMain()
+        {
+            Backend& b = backend();
+            std::unique_lock<std::mutex> lock(b.sleepLock);
+            while (!b.stopping) {
+                b.wake.wait_for(lock, std::chrono::milliseconds(kFlushMs),
+                                [&b] { return b.wakeRequested || b.stopping; });
+                b.wakeRequested = false;
+                lock.unlock();
+                {
+                    std::lock_guard<std::mutex> drain(b.drainLock);
+                    drainLocked(b);
+                }
+                lock.lock();
+            }
+        }
+
+        // At exit: stops the writer and writes what is left. Lines logged
+        // after this are written as they come.
+        void stopWriter()
+        {
+            Backend& b = backend();
+            running.store(false, std::memory_order_release);
+            {
+                std::lock_guard<std::mutex> lock(b.sleepLock);
+                b.stopping = true;
+            }
+            b.wake.notify_one();
+            b.writer.join();
+            std::lock_guard<std::mutex> lock(b.drainLock);
+            drainLocked(b);
+        }
+
+        // Gives the calling thread a ring, starting the writer with the
+        // first one.
+        Ring* attach()
+        {
+            Backend& b = backend();
+            Ring* ring = new Ring;
+            ring->retired.store(false, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(b.registryLock);
+                b.rings.push_back(ring);
+                if (!b.started) {
+                    b.started = true;
+                    b.writer = std::thread(writerMain);
+                    running.store(true, std::memory_order_release);
+                    atexit(stopWriter);
+                }
+            }
+            static thread_local RingRetirer retirer;
+            retirer.ring = ring;
+            threadRing = ring;
+            return ring;
+        }
+
+        // Queues r, or writes it at once once the writer has stopped.
+        void submit(Record& r)
+        {
+            Ring* ring = threadRing;
+            if (!ring && !threadDetached)
+                ring = attach();
+            r.seq = nextSeq.fetch_add(1, std::memory_order_relaxed);
+            if (!ring || !running.load(std::memory_order_acquire)) {
+                writeNow(r);
+                return;
+            }
+
+            uint32_t severity = r.severity;
+            while (!ring->lines.push(r)) {
+                if (!running.load(std::memory_order_acquire)) {
+                    writeNow(r);
+                    return;
+                }
+                requestWake();
+                std::this_thread::yield();
+            }
+
+            if (severity == LOG_FATAL)
+                Logger::flush();
+            else if (severity >= LOG_ERROR)
+                requestWake();
+        }
+
+    }
+
+    const char* severityTag(int severity)
+    {
+        switch (severity) {
+            case LOG_DEBUG:
+                return "[DEBUG] ";
+            case LOG_INFO:
+                return "[INFO] ";
+            case LOG_WARN:
+                return "[WARN] ";
+            case LOG_ERROR:
+                return "[ERROR] ";
+            default:
+                return "[FATAL] ";
+        }
+    }
+
+    void write(Severity severity, const Line& line)
+    {
+        Record r;
+        r.severity = (uint32_t) severity;
+        r.site = NULL;
+        r.timeNs = 0;
+        r.line = line;
+        submit(r);
+    }
+
+    void write(const Event& event)
+    {
+        Record r;
+        r.severity = (uint32_t) event.site().severity;
+        r.site = &event.site();
+        r.timeNs = nowNs();
+        r.line = event.args();
+        submit(r);
+    }
+
+    Line& Line::append(const char* s)
+    {
+        return append(s, strlen(s));
+    }
+
+    Line& Line::append(const char* s, size_t n)
+    {
+        size_t room = kLineMax - size_;
+        if (n > room) {
+            memcpy(text_ + size_, s, room);
+            size_ = kLineMax;
+            memcpy(text_ + kLineMax - 3, "...", 3);
+            while (valueCount_ > 0 && valueAt_[valueCount_ - 1] > kLineMax - 3)
+                --valueCount_;
+            return *this;
+        }
+        memcpy(text_ + size_, s, n);
+        size_ += n;
+        return *this;
+    }
+
+    Line& Line::appendSigned(long long v)
+    {
+        if (v >= 0)
+            return appendUnsigned((unsigned long long) v);
+        append("-", 1);
+        return appendUnsigned(0ull - (unsigned long long) v);
+    }
+
+    Line& Line::appendUnsigned(unsigned long long v)
+    {
+        char digits[20];
+        size_t n = formatUnsigned(digits + sizeof(digits), v);
+        return append(digits + sizeof(digits) - n, n);
+    }
+
+    Line& Line::operator<<(double v)
+    {
+        if (valueCount_ < kDeferredValues && size_ < kLineMax) {
+            values_[valueCount_] = v;
+            valueAt_[valueCount_] = (unsigned char) size_;
+            ++valueCount_;
+            return *this;
+        }
+        char s[32];
+        return append(s, formatDouble(s, sizeof(s), v));
+    }
+
+    void Line::format(std::string& out) const
+    {
+        size_t pos = 0;
+        for (size_t i = 0; i < valueCount_; ++i) {
+            out.append(text_ + pos, valueAt_[i] - pos);
+            char s[32];
+            out.append(s, formatDouble(s, sizeof(s), values_[i]));
+            pos = valueAt_[i];
+        }
+        out.append(text_ + pos, size_ - pos);
+    }
+
+    void Event::add(double v)
+    {
+        if (fits(1 + sizeof(v))) {
+            args_.text_[args_.size_] = (char) ARG_DOUBLE;
+            memcpy(args_.text_ + args_.size_ + 1, &v, sizeof(v));
+            args_.size_ += 1 + sizeof(v);
+        }
+    }
+
+    void Event::add(const char* s)
+    {
+        if (!s)
+            s = "(null)";
+        addString(s, strlen(s));
+    }
+
+    void Event::addInt(long long v)
+    {
+        int64_t i = v;
+        if (fits(1 + sizeof(i))) {
+            args_.text_[args_.size_] = (char) ARG_INT;
+            memcpy(args_.text_ + args_.size_ + 1, &i, sizeof(i));
+            args_.size_ += 1 + sizeof(i);
+        }
+    }
+
+    void Event::addUint(unsigned long long v)
+    {
+        uint64_t u = v;
+        if (fits(1 + sizeof(u))) {
+            args_.text_[args_.size_] = (char) ARG_UINT;
+            memcpy(args_.text_ + args_.size_ + 1, &u, sizeof(u));
+            args_.size_ += 1 + sizeof(u);
+        }
+    }
+
+    void Event::addString(const char* s, size_t n)
+    {
+        // A string too long for the room left is cut, rather than dropped.
+        if (cut_ || kLineMax - 1 - args_.size_ <= 3) {
+            fits(kLineMax);
+            return;
+        }
+        uint16_t keep = (uint16_t) std::min<size_t>(std::min<size_t>(n, 0xffff), kLineMax - 1 - args_.size_ - 3);
+        args_.text_[args_.size_] = (char) ARG_STRING;
+        memcpy(args_.text_ + args_.size_ + 1, &keep, sizeof(keep));
+        memcpy(args_.text_ + args_.size_ + 3, s, keep);
+        args_.size_ += 3 + keep;
+        if (keep < n)
+            fits(kLineMax);
+    }
+
+    bool Event::fits(size_t n)
+    {
+        // The last byte is kept for the ARG_CUT tag.
+        if (!cut_ && args_.size_ + n <= kLineMax - 1)
+            return true;
+        if (!cut_) {
+            args_.text_[args_.size_++] = (char) ARG_CUT;
+            cut_ = true;
+        }
+        return false;
+    }
+
+    void formatEvent(const char* format, const char* args, size_t size, std::string& out)
+    {
+        size_t pos = 0;
+        bool cut = false;
+        for (const char* f = format; *f; ++f) {
+            if (f[0] != '{' || f[1] != '}') {
+                out += *f;
+                continue;
+            }
+            ++f;
+            if (cut)
+                continue;
+            if (pos >= size)
+                out += "{}";
+            else if (!formatArg(args, size, pos, out)) {
+                out += "...";
+                cut = true;
+            }
+        }
+        // Cut after the last argument a placeholder took, e.g. a last string
+        // shortened to fit: mark the end of the line, as Log does.
+        if (!cut && pos < size && (unsigned char) args[pos] == ARG_CUT)
+            out += "...";
+    }
+
+    bool Logger::setFile(const char* path)
+    {
+        Backend& b = backend();
+        std::lock_guard<std::mutex> lock(b.drainLock);
+        FILE* f = NULL;
+        if (path && !(f = fopen(path, "a")))
+            return false;
+        drainLocked(b);
+        if (b.file)
+            fclose(b.file);
+        b.file = f;
+        return true;
+    }
+
+    bool Logger::setEventFile(const char* path)
+    {
+        Backend& b = backend();
+        std::lock_guard<std::mutex> lock(b.drainLock);
+        FILE* f = NULL;
+        if (path) {
+            if (!(f = fopen(path, "wb")))
+                return false;
+            uint32_t byteOrder = 0x01020304;
+            fwrite("CALCEVT1", 1, 8, f);
+            fwrite(&byteOrder, sizeof(byteOrder), 1, f);
+        }
+        drainLocked(b);
+        if (b.events)
+            fclose(b.events);
+        b.events = f;
+        b.siteIds.clear();
+        return true;
+    }
+
+    void Logger::flush()
+    {
+        Backend& b = backend();
+        std::lock_guard<std::mutex> lock(b.drainLock);
+        drainLocked(b);
+        if (b.file)
+            fflush(b.file);
+    }
+
+}
@@ -13,9 +13,23 @@
 #include "imgui_impl_sdl_gl3.h"
 #endif
 #include "calculator.h"
-
+#include "calc_async.h"
+#include "calc_decimal.h"
+#include "calc_history.h"
+#include "calc_history_log.h"
+#include "calc_incremental.h"
+#include "calc_number.h"
+#include "event_script.h"
+#include "font_loader.h"
+#include "imgui_impl_gl_state.h"
+#include "imgui_impl_headless.h"
+#include "profiler.h"
+
+#include <string.h>
 #include <unistd.h>
-#include <dirent.h>
+#include <algorithm>
+#include <stdio.h>
+#include <vector>
 
 /**
  * A convenience function to create a context for the specified window
@@ -27,39 +41,269 @@ typedef bool(initImgui_t)(SDL_Window*);
 typedef bool(processEvent_t)(SDL_Event*);
 typedef void(newFrame_t)(SDL_Window*);
 typedef void(shutdown_t)();
+typedef void(setAppOwnsGLState_t)(bool);
+typedef const ImGui_ImplGLFrameStats&(frameStats_t)();
 
 static initImgui_t *initImgui;
 static processEvent_t *processEvent;
 static newFrame_t *newFrame;
 static shutdown_t *shutdown;
-
-
-static int historySize = 0;
-static std::string result[100];
+// NULL for the headless backend, which makes no GL calls.
+static setAppOwnsGLState_t *setAppOwnsGLState;
+static frameStats_t *glFrameStats;
+
+
+// Past calculations, oldest first. Retention is bounded by both limits, so
+// a session that never ends still holds a fixed amount of memory.
+static const size_t kHistoryEntries = 1000;
+static const size_t kHistoryBytes = 64 * 1024;
+static calc::HistoryStore history(kHistoryEntries, kHistoryBytes);
+// Every entry is also logged to this file in the data dir, and the newest
+// are read back from it at startup.
+static const char* const kHistoryLogFile = "history.log";
+static calc::HistoryLog historyLog(kHistoryEntries);
 static bool scrollToBottom = false;
 static bool scrollToBottomDouble = false;
 
-static std::string equation[100];
+// Text widths of history entries, slot n % kHistoryEntries for entry number
+// n, measured at the font and size in measuredFont/measuredFontSize. An
+// entry is measured the first time it scrolls into view and never again.
+struct HistoryWidths {
+    float equation;
+    float result;
+    uint64_t entry;     // entry number + 1; 0 if the slot is empty
+};
+static std::vector<HistoryWidths> historyWidths(kHistoryEntries);
+static ImFont* measuredFont = NULL;
+static float measuredFontSize = 0.0f;
+
+static void measureHistoryEntry(size_t i, const calc::HistoryStore::Entry& entry,
+                                float& equationWidth, float& resultWidth){
+    if (ImGui::GetFont() != measuredFont || ImGui::GetFontSize() != measuredFontSize) {
+        for (size_t s = 0; s < historyWidths.size(); s++)
+            historyWidths[s].entry = 0;
+        measuredFont = ImGui::GetFont();
+        measuredFontSize = ImGui::GetFontSize();
+    }
+    uint64_t number = history.appended() - history.size() + i;
+    HistoryWidths& w = historyWidths[number % historyWidths.size()];
+    if (w.entry != number + 1) {
+        const calc::HistoryStore::Slice& eq = entry.equation;
+        const calc::HistoryStore::Slice& res = entry.result;
+        w.equation = ImGui::CalcTextSize(eq.data, eq.data + eq.size).x;
+        w.result = ImGui::CalcTextSize(res.data, res.data + res.size).x;
+        w.entry = number + 1;
+    }
+    equationWidth = w.equation;
+    resultWidth = w.result;
+}
 
 static std::string currentEquation = "";
 static std::string currentResult = "";
 
+// Live value of currentEquation, shown until = is pressed. Kept in step with
+// every edit so a frame never re-parses the equation.
+static calc::IncrementalEvaluator preview;
+static std::string previewResult = "";
+
+// Toggled by the dec/flt key; decides how = and the preview do arithmetic.
+static CalcMode calcMode = CALC_MODE_DOUBLE;
+
+// Idle mode. Input reaches ImGui one frame after it is polled, and clicks,
+// hovers and scroll requests take another frame or two to show, so the loop
+// draws this many frames after the last event before it sleeps in
+// SDL_WaitEvent.
+static const int kSettleFrames = 3;
+
+// = evaluates on a worker thread, so a slow expression leaves the UI drawing.
+// pendingEval is the job whose answer the result line is waiting for; its
+// result arrives as evalDoneEvent, which also wakes the loop from idle.
+static const uint32_t kEvalDeadlineMs = 2000;
+static calc::EvaluationWorker* evaluator = NULL;
+static uint64_t pendingEval = 0;
+// A decimal preview re-evaluates the whole equation, which can take as long
+// as =, so it goes to the same worker; pendingPreview is its job. Since a
+// submission supersedes the ones before it, none is made while = is pending.
+static uint64_t pendingPreview = 0;
+static Uint32 evalDoneEvent = (Uint32) -1;
+
+static void wakeMainLoop(void*){
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = evalDoneEvent;
+    SDL_PushEvent(&e);
+}
+
+static void cancelEvaluation(){
+    if (pendingEval) {
+        evaluator->cancel(pendingEval);
+        pendingEval = 0;
+    }
+}
+
+static void cancelPreview(){
+    if (pendingPreview) {
+        evaluator->cancel(pendingPreview);
+        pendingPreview = 0;
+    }
+}
+
+static void evaluateEquation(){
+    cancelEvaluation();
+    pendingPreview = 0;     // superseded by this submission
+    pendingEval = evaluator ? evaluator->submit(currentEquation, calcMode, kEvalDeadlineMs) : 0;
+    if (!pendingEval) {
+        // No worker, or too many answers not yet collected.
+        currentResult = calculator::calToString(currentEquation, calcMode);
+        scrollToBottom = true;
+    }
+}
+
+static void collectEvaluations(){
+    calc::EvaluationWorker::Result result;
+    while (evaluator && evaluator->poll(result)) {
+        if (result.id == pendingPreview) {
+            pendingPreview = 0;
+            if (result.status == calc::EvaluationWorker::EVAL_DONE)
+                previewResult = result.text;
+            continue;
+        }
+        if (result.id != pendingEval)
+            continue;       // superseded or cancelled
+        pendingEval = 0;
+        if (result.status == calc::EvaluationWorker::EVAL_DONE)
+            currentResult = result.text;
+        else if (result.status == calc::EvaluationWorker::EVAL_TIMED_OUT)
+            currentResult = "timed out";
+        scrollToBottom = true;
+    }
+}
+
+// Profiling, off unless asked for on the command line: --profile shows the
+// overlay, --trace FILE writes a Chrome trace of the session on exit.
+static bool showProfiler = false;
+static const char* tracePath = NULL;
+
+// --own-gl-state stops the backend saving and restoring the GL state it
+// changes around ImGui::Render(); the frame loop sets what it needs itself.
+// The profiler overlay shows how many GL calls each frame's Render makes.
+static bool ownGLState = false;
+
+// --record FILE writes the session's input as an event script. --replay FILE
+// runs headless instead: SDL's dummy video driver, the software-rasterizing
+// backend, the script's events at full speed with a fixed time step, and =
+// evaluated in place so that every run draws the same frames. It then prints
+// frame rate and frame time percentiles.
+static const int kWindowWidth = 1280;
+static const int kWindowHeight = 800;
+static EventScript replay;
+static EventRecorder recorder;
+static bool headless = false;
+
+// Startup reads the font on a thread of its own while the window and context
+// are created, and logs how long the first frame took to reach the screen.
+// Past the budget that is a warning.
+static const char* const kFontFile = "Roboto-Medium.ttf";
+static const float kFontSize = 32.0f;
+static const double kStartupBudgetMs = 250.0;
+static FontLoader fontLoader;
+static Uint64 startupBegin;
+
+static double msSince(Uint64 start){
+    return (double) (SDL_GetPerformanceCounter() - start) * 1e3 / SDL_GetPerformanceFrequency();
+}
+
+static void drawGLStats(bool* open){
+    const ImGui_ImplGLFrameStats& stats = glFrameStats();
+    ImGui::SetNextWindowSize(ImVec2(500, 200), ImGuiSetCond_FirstUseEver);
+    if (ImGui::Begin("GL calls", open)) {
+        ImGui::Text("Last frame: %d GL calls%s", stats.Total(), ownGLState ? ", GL state owned by the app" : "");
+        ImGui::Text("queries %d, state %d, uploads %d, draws %d", stats.Queries, stats.StateChanges, stats.Uploads, stats.Draws);
+        ImGui::Text("redundant binds and scissors skipped %d", stats.Skipped);
+    }
+    ImGui::End();
+}
+
+static void reportStartup(double windowMs){
+    double firstFrameMs = msSince(startupBegin);
+    std::ostringstream breakdown;
+    breakdown << "window and context " << windowMs << " ms, font atlas " << fontLoader.loadMs()
+              << " ms on its own thread, " << fontLoader.waitMs() << " ms waited for it";
+    if (firstFrameMs > kStartupBudgetMs)
+        LogReport(LOG_WARN) << "First frame after " << firstFrameMs << " ms, over the " << kStartupBudgetMs
+                            << " ms budget: " << breakdown.str();
+    else
+        LogReport(LOG_INFO) << "First frame after " << firstFrameMs << " ms: " << breakdown.str();
+}
+
+static void updatePreview(){
+    previewResult = "";
+    cancelPreview();
+    if (!preview.valid() || preview.empty())
+        return;
+    if (calcMode == CALC_MODE_DECIMAL) {
+        // The incremental evaluator works in doubles, so a decimal preview
+        // evaluates the whole equation off the UI thread, deadline and all.
+        // A replay has no worker and evaluates it in place, as it does =.
+        // If the worker is busy with = or full, there is no preview.
+        if (!evaluator)
+            previewResult = calculator::calToString(currentEquation, calcMode);
+        else if (!pendingEval)
+            pendingPreview = evaluator->submit(currentEquation, calcMode, kEvalDeadlineMs);
+        return;
+    }
+    char buf[calc::kFormatBufferSize];
+    calc::formatShortest(preview.value(), buf);
+    previewResult = buf;
+}
+
+// Moves a finished calculation into the history. One too long for the
+// history arena is shown cut short but logged whole; loading it back cuts it
+// the same way, so the two agree after a restart.
+static void commitResult(){
+    if (!history.append(currentEquation.data(), currentEquation.size(),
+                        currentResult.data(), currentResult.size())) {
+        Log(LOG_ERROR) << "History arena of " << history.arenaBytes() << " bytes cannot hold an entry";
+        return;
+    }
+    historyLog.append(currentEquation.data(), currentEquation.size(),
+                      currentResult.data(), currentResult.size());
+}
+
 static void addStrToEquation(std::string toAdd){
 
+    cancelEvaluation();
     if (!currentResult.empty()){
-        equation[historySize] = currentEquation;
+        commitResult();
         currentEquation = "";
-        result[historySize] = currentResult;
         currentResult = "";
-        historySize++;
+        preview.clear();
 
     }
 
     currentEquation += toAdd;
+    preview.append(toAdd);
+    updatePreview();
     scrollToBottom = true;
 
 }
 
+static void popEquation(){
+    cancelEvaluation();
+    if (currentEquation.empty())
+        return;
+    currentEquation.pop_back();
+    preview.pop();
+    updatePreview();
+}
+
+static void clearEquation(){
+    cancelEvaluation();
+    currentEquation = "";
+    preview.clear();
+    updatePreview();
+}
+
 
 static SDL_GLContext createCtx(SDL_Window *w)
 {
@@ -127,6 +371,8 @@ static SDL_GLContext createCtx(SDL_Window *w)
         processEvent = ImGui_ImplSdlGLES3_ProcessEvent;
         newFrame = ImGui_ImplSdlGLES3_NewFrame;
         shutdown = ImGui_ImplSdlGLES3_Shutdown;
+        setAppOwnsGLState = ImGui_ImplSdlGLES3_SetAppOwnsGLState;
+        glFrameStats = ImGui_ImplSdlGLES3_GetFrameStats;
     }
     else
     {
@@ -136,62 +382,129 @@ static SDL_GLContext createCtx(SDL_Window *w)
         processEvent = ImGui_ImplSdlGLES2_ProcessEvent;
         newFrame = ImGui_ImplSdlGLES2_NewFrame;
         shutdown = ImGui_ImplSdlGLES2_Shutdown;
+        setAppOwnsGLState = ImGui_ImplSdlGLES2_SetAppOwnsGLState;
+        glFrameStats = ImGui_ImplSdlGLES2_GetFrameStats;
     }
 #else
     initImgui = ImGui_ImplSdlGL3_Init;
     processEvent = ImGui_ImplSdlGL3_ProcessEvent;
     newFrame = ImGui_ImplSdlGL3_NewFrame;
     shutdown = ImGui_ImplSdlGL3_Shutdown;
+    setAppOwnsGLState = ImGui_ImplSdlGL3_SetAppOwnsGLState;
+    glFrameStats = ImGui_ImplSdlGL3_GetFrameStats;
 #endif
     Log(LOG_INFO) << "Finished initialization";
     return ctx;
 }
 
 
+// Frame times of a replay, in seconds.
+static void reportReplay(std::vector<double>& frameTimes, double total){
+    if (frameTimes.empty())
+        return;
+    std::sort(frameTimes.begin(), frameTimes.end());
+    size_t n = frameTimes.size();
+    const double pct[] = { 0.50, 0.90, 0.99 };
+    double at[3];
+    for (int i = 0; i < 3; i++)
+        at[i] = frameTimes[std::min(n - 1, (size_t) (pct[i] * n))];
+    printf("replay: %zu frames in %.3f s, %.1f frames/s; frame ms p50 %.3f p90 %.3f p99 %.3f max %.3f; "
+           "framebuffer %016llx\n", n, total, n / total, at[0] * 1e3, at[1] * 1e3, at[2] * 1e3,
+           frameTimes[n - 1] * 1e3, (unsigned long long) ImGui_ImplHeadless_FramebufferHash());
+}
+
 int main(int argc, char** argv)
 {
-    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER);
-
+    startupBegin = SDL_GetPerformanceCounter();
     if (argc < 2)
     {
-        Log(LOG_FATAL) << "Not enough arguments! Usage: " << argv[0] << " path_to_data_dir";
-        SDL_Quit();
+        Log(LOG_FATAL) << "Not enough arguments! Usage: " << argv[0]
+                       << " path_to_data_dir [--log file] [--event-log file] [--profile] [--trace file] [--own-gl-state]"
+                          " [--record file | --replay file]";
         return 1;
     }
-    if (chdir(argv[1])) {
+    const char* recordPath = NULL;
+    for (int i = 2; i < argc; ++i) {
+        if (!strcmp(argv[i], "--log") && i + 1 < argc) {
+            if (!_Logger::Logger::setFile(argv[++i]))
+                Log(LOG_ERROR) << "Could not open log file " << argv[i];
+        } else if (!strcmp(argv[i], "--event-log") && i + 1 < argc) {
+            if (!_Logger::Logger::setEventFile(argv[++i]))
+                Log(LOG_ERROR) << "Could not create event log " << argv[i];
+        } else if (!strcmp(argv[i], "--profile"))
+            showProfiler = true;
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (!strcmp(argv[i], "--own-gl-state"))
+            ownGLState = true;
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+            // Read before chdir, so the path is relative to where we started.
+            if (!replay.load(argv[++i]))
+                return 1;
+            headless = true;
+        } else
+            Log(LOG_WARN) << "Ignoring argument " << argv[i];
+    }
+    if (showProfiler || tracePath) {
+        prof::setEnabled(true);
+        prof::setThreadName("main");
+    }
+    if (recordPath && !headless && !recorder.open(recordPath, kWindowWidth, kWindowHeight))
+        return 1;
+
+    // Nothing on disk is looked at until it is needed. The font atlas is
+    // built while SDL brings up the window and context.
+    bool inDataDir = chdir(argv[1]) == 0;
+    if (!inDataDir)
         Log(LOG_ERROR) << "Could not change directory properly!";
-    } else {
-        dirent **namelist;
-        int numdirs = scandir(".", &namelist, NULL, alphasort);
-        if (numdirs < 0) {
-            Log(LOG_ERROR) << "Could not list directory";
-        } else {
-            for (int dirid = 0; dirid < numdirs; ++dirid) {
-                Log(LOG_INFO) << "Got file: " << namelist[dirid]->d_name;
-            }
-            free(namelist);
-        }
+    ImGuiIO& io = ImGui::GetIO();
+    fontLoader.start(io.Fonts, kFontFile, kFontSize);
+
+    if (headless)
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);     // SDL_HINT_VIDEODRIVER needs SDL 2.0.22
+    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER);
+    evalDoneEvent = SDL_RegisterEvents(1);
+
+    // A replay starts from an empty history so that it draws the same
+    // frames every time.
+    if (inDataDir && !headless && historyLog.open(kHistoryLogFile)) {
+        size_t loaded = historyLog.loadTail(history);
+        Log(LOG_INFO) << "Loaded " << loaded << " of " << historyLog.records() << " history entries";
+        scrollToBottom = history.size() > 0;
     }
 
     // Create window
     Log(LOG_INFO) << "Creating SDL_Window";
-    SDL_Window *window = SDL_CreateWindow("Demo App", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1280, 800, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
-    SDL_GLContext ctx = createCtx(window);
-    initImgui(window);
+    SDL_GLContext ctx = NULL;
+    SDL_Window *window;
+    if (headless) {
+        window = SDL_CreateWindow("Demo App", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, replay.width(), replay.height(), 0);
+        initImgui = ImGui_ImplHeadless_Init;
+        processEvent = ImGui_ImplHeadless_ProcessEvent;
+        newFrame = ImGui_ImplHeadless_NewFrame;
+        shutdown = ImGui_ImplHeadless_Shutdown;
+    } else {
+        window = SDL_CreateWindow("Demo App", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, kWindowWidth, kWindowHeight, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+        ctx = createCtx(window);
+    }
+    double windowMs = msSince(startupBegin);
 
-    // Load Fonts
-    // (there is a default font, this is only if you want to change it. see extra_fonts/README.txt for more details)
-    ImGuiIO& io = ImGui::GetIO();
-    //io.Fonts->AddFontDefault();
-    //io.Fonts->AddFontFromFileTTF("../../extra_fonts/Cousine-Regular.ttf", 15.0f);
-    //io.Fonts->AddFontFromFileTTF("../../extra_fonts/DroidSans.ttf", 16.0f);
-    io.Fonts->AddFontFromFileTTF("Roboto-Medium.ttf", 32.0f);
+    fontLoader.finish();
+    initImgui(window);
+    if (ownGLState && setAppOwnsGLState)
+        setAppOwnsGLState(true);
 
     ImVec4 clear_color = ImColor(114, 144, 154);
     ImVec4 white = ImColor(255, 255, 255);
     ImVec4 black = ImColor(0, 0, 0);
 
     ImVec4 darkRed = ImColor(0, 128, 0);
+    ImVec4 grey = ImColor(128, 128, 128);
+
+    if (!headless && evalDoneEvent != (Uint32) -1)
+        evaluator = new calc::EvaluationWorker(wakeMainLoop, NULL);
 
     Log(LOG_INFO) << "Entering main loop";
     {
@@ -206,67 +519,100 @@ int main(int argc, char** argv)
         int prevX , prevY;
         SDL_GetMouseState(&prevX, &prevY);
 
+        int settleFrames = kSettleFrames;
+
+        // Frames drawn so far; event scripts are timed in these.
+        uint64_t frame = 0;
+        std::vector<double> frameTimes;
+        Uint64 replayStart = SDL_GetPerformanceCounter();
+
         while (!done) {
             SDL_Event e;
 
-            newFrame(window);
+            if (headless) {
+                // A replay never sleeps. It ends where the app would have
+                // gone idle after the script's last event.
+                if (replay.finished() && settleFrames <= 0 && !scrollToBottom)
+                    break;
+                replay.push(frame);
+            } else if (settleFrames <= 0 && !scrollToBottom) {
+                // Nothing has changed since the last frame drawn. Leave the
+                // event in the queue for the poll below.
+                SDL_WaitEvent(NULL);
+                settleFrames = kSettleFrames;
+            }
+            settleFrames--;
+            Uint64 frameStart = SDL_GetPerformanceCounter();
+
+            PROFILE_ZONE("frame");
+            {
+                PROFILE_ZONE("newFrame");
+                newFrame(window);
+            }
             deltaX = 0;
             deltaY = 0;
 
             sizeY = (int) ImGui::GetIO().DisplaySize.y - 100;
             sizeX = (int) ImGui::GetIO().DisplaySize.x - 50;
 
-            while (SDL_PollEvent(&e)) {
-                bool handledByImGui = processEvent(&e);
-                {
-                    switch (e.type) {
-                        case SDL_QUIT:
-                            done = true;
-                            break;
-                        case SDL_MOUSEBUTTONDOWN:
-                            prevX = e.button.x;
-                            prevY = e.button.y;
-                            break;
-                        case SDL_MOUSEMOTION:
-
-                            if (e.motion.y < ImGui::GetIO()
-                                                     .DisplaySize.y/2 ) {
-                                if (e.motion.state & SDL_BUTTON_LMASK) {
-                                    deltaX += prevX - e.motion.x;
-                                    deltaY += prevY - e.motion.y;
-                                    prevX = e.motion.x;
-                                    prevY = e.motion.y;
+            {
+                PROFILE_ZONE("events");
+                while (SDL_PollEvent(&e)) {
+                    settleFrames = kSettleFrames;
+                    bool handledByImGui = processEvent(&e);
+                    recorder.record(frame, e);
+                    {
+                        switch (e.type) {
+                            case SDL_QUIT:
+                                done = true;
+                                break;
+                            case SDL_MOUSEBUTTONDOWN:
+                                prevX = e.button.x;
+                                prevY = e.button.y;
+                                break;
+                            case SDL_MOUSEMOTION:
+
+                                if (e.motion.y < ImGui::GetIO()
+                                                         .DisplaySize.y/2 ) {
+                                    if (e.motion.state & SDL_BUTTON_LMASK) {
+                                        deltaX += prevX - e.motion.x;
+                                        deltaY += prevY - e.motion.y;
+                                        prevX = e.motion.x;
+                                        prevY = e.motion.y;
+                                    }
                                 }
-                            }
 
-                            break;
-                        case SDL_MULTIGESTURE:
+                                break;
+                            case SDL_MULTIGESTURE:
 
-                            break;
-                        case SDL_MOUSEWHEEL:
-                            break;
-                        default:
-                            break;
+                                break;
+                            case SDL_MOUSEWHEEL:
+                                break;
+                            default:
+                                break;
+                        }
                     }
                 }
             }
+            collectEvaluations();
 
 
             ImGui::GetStateStorage()->SetInt(ImGui::GetID("Calculator"), 1);
 
             {
+                PROFILE_ZONE("windows");
 
                 ImGui::PushStyleColor(ImGuiCol_WindowBg, white);
                 ImGui::Begin("History",&done,ImGuiWindowFlags_NoTitleBar|ImGuiWindowFlags_NoResize);
                 ImGui::SetWindowPos(ImVec2(0, fmax((sizeY/2 -
                                                    (ImGui::GetItemsLineHeightWithSpacing
-                                                                    () + 10)*2*(2 + historySize*2)
+                                                                    () + 10)*2*(2 + history.size()*2)
                                                     + 30), 0.0f)),
                                     ImGuiSetCond_Always|ImGuiWindowFlags_NoResize);
                 ImGui::SetWindowCollapsed(false, ImGuiSetCond_Always|ImGuiWindowFlags_NoResize);
                 ImGui::SetWindowSize(ImVec2((int) ImGui::GetIO()
                         .DisplaySize.x, fmin((ImGui::GetItemsLineHeightWithSpacing() + 10)*2*(2 +
-                                             historySize*2)+ 30, (float)sizeY/2)),
+                                             history.size()*2)+ 30, (float)sizeY/2)),
                                      ImGuiSetCond_Always|ImGuiWindowFlags_NoResize);
                 ImGui::PushStyleColor(ImGuiCol_ChildWindowBg, white);
                 ImGui::BeginChild("scrolling", ImVec2(0, 0)
@@ -294,52 +640,51 @@ int main(int argc, char** argv)
 
 
 
-                for (int i = 0 ; i < historySize ; i++){
+                // Only the entries in view are laid out; the clipper
+                // skips the rest with one cursor move. Each entry is two
+                // lines, equation and result.
+                ImGuiListClipper clipper((int) history.size(), ImGui::GetTextLineHeightWithSpacing() * 2);
+                while (clipper.Step()) {
+                    for (int i = clipper.DisplayStart ; i < clipper.DisplayEnd ; i++){
 
-                    if (equation[i].empty()) {
+                        calc::HistoryStore::Entry entry = history.at((size_t) i);
+                        float equationWidth, resultWidth;
+                        measureHistoryEntry((size_t) i, entry, equationWidth, resultWidth);
 
-                        break;
+                        ImGui::Indent( sizeX - equationWidth);
+                        ImGui::TextColored(black, "%s", entry.equation.data);
+                        ImGui::Unindent( sizeX - equationWidth);
 
-                    }
-                    if (result[i].empty()) {
-
-                        break;
+                        ImGui::Indent( sizeX - resultWidth);
+                        ImGui::TextColored(darkRed, "%s", entry.result.data);
+                        ImGui::Unindent( sizeX - resultWidth);
 
                     }
-                    const char* tempEquation = &equation[i][0u];
-                    const char* tempResult = &result[i][0u];
-
-
-
-                    ImGui::Indent( sizeX - ImGui::CalcTextSize(tempEquation).x);
-                    ImGui::TextColored(black, "%s", tempEquation);
-                    ImGui::Unindent( sizeX - ImGui::CalcTextSize(tempEquation).x);
-
-                    ImGui::Indent( sizeX - ImGui::CalcTextSize(tempResult).x);
-                    ImGui::TextColored(darkRed, "%s", tempResult);
-                    ImGui::Unindent( sizeX - ImGui::CalcTextSize(tempResult).x);
-
-
-
                 }
 
 
                 const char* cstr = &currentEquation[0u];
 
-                ImGui::Indent( sizeX - ImGui::CalcTextSize(cstr).x);
+                // Measured once for the Indent/Unindent pair; repeats of an
+                // unchanged string are hits in ImGui's text size cache.
+                float cstrWidth = ImGui::CalcTextSize(cstr).x;
+                ImGui::Indent( sizeX - cstrWidth);
 
                 ImGui::TextColored(black,"%s", cstr);
 
 
 
-                ImGui::Unindent( sizeX - ImGui::CalcTextSize(cstr).x);
+                ImGui::Unindent( sizeX - cstrWidth);
 
-                const char* resultStr = &currentResult[0u];
+                bool showPreview = currentResult.empty();
+                const char* resultStr = pendingEval || (showPreview && pendingPreview) ? "computing..."
+                                                    : showPreview ? &previewResult[0u] : &currentResult[0u];
 
-                ImGui::Indent( sizeX - ImGui::CalcTextSize(resultStr).x);
+                float resultWidth = ImGui::CalcTextSize(resultStr).x;
+                ImGui::Indent( sizeX - resultWidth);
 
-                ImGui::TextColored(darkRed,"%s", resultStr);
-                ImGui::Unindent( sizeX - ImGui::CalcTextSize(resultStr).x);
+                ImGui::TextColored(showPreview || pendingEval ? grey : darkRed,"%s", resultStr);
+                ImGui::Unindent( sizeX - resultWidth);
 
 
                 if (scrollToBottom){
@@ -390,19 +735,23 @@ int main(int argc, char** argv)
 
                 if(ImGui::Button("del",ImVec2( (int) ImGui::GetIO()
                         .DisplaySize.x/4 , sizeY/12  ))){
-                    currentEquation.pop_back();
+                    popEquation();
                 }; ImGui::SameLine();
 
                 ImGui::NewLine();
 
                 if(ImGui::Button("c",ImVec2( (int) ImGui::GetIO()
                         .DisplaySize.x/4 , sizeY/12  ))){
-                    currentEquation = "";
+                    clearEquation();
+                }; ImGui::SameLine();
+                if(ImGui::Button("(",ImVec2( (int) ImGui::GetIO()
+                        .DisplaySize.x/4 , sizeY/12  ))){
+                    addStrToEquation("(");
+                }; ImGui::SameLine();
+                if(ImGui::Button(")",ImVec2( (int) ImGui::GetIO()
+                        .DisplaySize.x/4 , sizeY/12  ))){
+                    addStrToEquation(")");
                 }; ImGui::SameLine();
-                ImGui::Button("(",ImVec2( (int) ImGui::GetIO()
-                        .DisplaySize.x/4 , sizeY/12  )); ImGui::SameLine();
-                ImGui::Button(")",ImVec2( (int) ImGui::GetIO()
-                        .DisplaySize.x/4 , sizeY/12  )); ImGui::SameLine();
                 if(ImGui::Button("/",ImVec2( (int) ImGui::GetIO()
                         .DisplaySize.x/4 , sizeY/12  ))){
                     addStrToEquation("/");
@@ -469,8 +818,13 @@ int main(int argc, char** argv)
 
                 ImGui::NewLine();
 
+                if (ImGui::Button(calcMode == CALC_MODE_DECIMAL ? "dec###mode" : "flt###mode",ImVec2( (int) ImGui::GetIO()
+                        .DisplaySize.x/4 , sizeY/12  ))){
+                    calcMode = calcMode == CALC_MODE_DECIMAL ? CALC_MODE_DOUBLE : CALC_MODE_DECIMAL;
+                    updatePreview();
+                }; ImGui::SameLine();
                 if (ImGui::Button("0",ImVec2( (int) ImGui::GetIO()
-                        .DisplaySize.x/2 , sizeY/12  ))){
+                        .DisplaySize.x/4 , sizeY/12  ))){
                     addStrToEquation("0");
                 }; ImGui::SameLine();
                 if (ImGui::Button(".",ImVec2( (int) ImGui::GetIO()
@@ -482,9 +836,7 @@ int main(int argc, char** argv)
 
                     if (!currentEquation.empty()){
                         scrollToBottom = true;
-                        std::ostringstream strs;
-                        strs << calculator::calEverything(currentEquation);
-                        currentResult = strs.str();
+                        evaluateEquation();
 
                     }
 
@@ -493,26 +845,71 @@ int main(int argc, char** argv)
 
 
                 ImGui::End();
+
+                if (showProfiler) {
+                    prof::drawOverlay(&showProfiler);
+                    if (glFrameStats)
+                        drawGLStats(&showProfiler);
+                }
             }
 
 
             // Rendering
-            glViewport(0, 0, (int) ImGui::GetIO().DisplaySize.x , (int) ImGui::GetIO()
-                    .DisplaySize.y);
-            glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-            glViewport(0, 0, (int) ImGui::GetIO().DisplaySize.x /2, (int) ImGui::GetIO()
-                    .DisplaySize.y/2 );
-            glClearColor(white.x, white.y, white.z, white.w);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-            ImGui::Render();
-            SDL_GL_SwapWindow(window);
+            if (!headless) {
+                // The backend leaves the scissor test on when it does not
+                // restore state, and glClear honours it.
+                if (ownGLState)
+                    glDisable(GL_SCISSOR_TEST);
+                glViewport(0, 0, (int) ImGui::GetIO().DisplaySize.x , (int) ImGui::GetIO()
+                        .DisplaySize.y);
+                glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                glViewport(0, 0, (int) ImGui::GetIO().DisplaySize.x /2, (int) ImGui::GetIO()
+                        .DisplaySize.y/2 );
+                glClearColor(white.x, white.y, white.z, white.w);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+
+            {
+                PROFILE_ZONE("ImGui::Render");
+                ImGui::Render();
+            }
+            if (!headless) {
+                PROFILE_ZONE("swap");
+                SDL_GL_SwapWindow(window);
+            }
+            if (frame == 0)
+                reportStartup(windowMs);
+
+            if (headless)
+                frameTimes.push_back((double) (SDL_GetPerformanceCounter() - frameStart) / SDL_GetPerformanceFrequency());
+            ++frame;
         }
+
+        if (headless)
+            reportReplay(frameTimes, (double) (SDL_GetPerformanceCounter() - replayStart) / SDL_GetPerformanceFrequency());
+    }
+    recorder.close();
+    if (!currentResult.empty())
+        commitResult();
+    if (tracePath) {
+        if (prof::writeChromeTrace(tracePath))
+            Log(LOG_INFO) << "Wrote trace to " << tracePath;
+        else
+            Log(LOG_ERROR) << "Could not write trace to " << tracePath;
     }
+
+    delete evaluator;
+    evaluator = NULL;
+
+    CalcCacheStats cache = calculator::cacheStats();
+    LogReport(LOG_INFO) << "Result cache: " << cache.hits << " hits, " << cache.misses << " misses, "
+                        << cache.evictions << " evictions, " << cache.size << "/" << cache.capacity << " entries";
+
     shutdown();
-    SDL_GL_DeleteContext(ctx);
+    if (ctx)
+        SDL_GL_DeleteContext(ctx);
     SDL_Quit();
     return 0;
 }
@@ -0,0 +1,292 @@
+//
+// Frame profiler: scoped zones, per-thread rings, an ImGui overlay and
+// Chrome trace export.
+//
+#include "profiler.h"
+#include "imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+
+namespace prof {
+
+    namespace detail {
+        std::atomic<bool> enabled(false);
+    }
+
+    namespace {
+
+        const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+        // Relaxed atomics so a reader copying a slot that is being
+        // rewritten gets a stale or torn record, never undefined behaviour;
+        // the sequence check throws such records away.
+        struct Slot {
+            std::atomic<const char*> name;
+            std::atomic<uint64_t> beginNs;
+            std::atomic<uint64_t> endNs;
+            std::atomic<uint32_t> depth;
+        };
+
+        // Zone i lives in slots[i % kRingZones]. The writer bumps claimed
+        // before it touches a slot and published after, so a reader that
+        // copied zone j knows it is intact if j >= claimed - kRingZones,
+        // claimed being read after the copy.
+        struct ThreadRing {
+            uint32_t id;
+            std::atomic<const char*> name;
+            std::atomic<uint64_t> claimed;
+            std::atomic<uint64_t> published;
+            Slot slots[kRingZones];
+        };
+
+        std::mutex& registryLock()
+        {
+            static std::mutex lock;
+            return lock;
+        }
+
+        std::vector<ThreadRing*>& registry()
+        {
+            static std::vector<ThreadRing*> rings;
+            return rings;
+        }
+
+        thread_local ThreadRing* threadRing = NULL;
+        thread_local uint32_t threadDepth = 0;
+        // Kept until the thread's first zone creates its ring.
+        thread_local const char* threadName = NULL;
+
+        ThreadRing* thisRing()
+        {
+            if (!threadRing) {
+                ThreadRing* r = new ThreadRing;
+                r->name.store(threadName, std::memory_order_relaxed);
+                r->claimed.store(0, std::memory_order_relaxed);
+                r->published.store(0, std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(registryLock());
+                r->id = (uint32_t) registry().size();
+                registry().push_back(r);
+                threadRing = r;
+            }
+            return threadRing;
+        }
+
+        // Appends ring's newest zones, at most max, oldest first.
+        void copyRing(const ThreadRing& ring, std::vector<ZoneRecord>& out, size_t max)
+        {
+            uint64_t end = ring.published.load(std::memory_order_acquire);
+            uint64_t begin = end - std::min<uint64_t>(end, std::min<uint64_t>(max, kRingZones));
+            size_t base = out.size();
+            for (uint64_t i = begin; i < end; ++i) {
+                const Slot& s = ring.slots[i % kRingZones];
+                ZoneRecord z;
+                z.name = s.name.load(std::memory_order_relaxed);
+                z.beginNs = s.beginNs.load(std::memory_order_relaxed);
+                z.endNs = s.endNs.load(std::memory_order_relaxed);
+                z.depth = s.depth.load(std::memory_order_relaxed);
+                out.push_back(z);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t claimed = ring.claimed.load(std::memory_order_relaxed);
+            if (claimed > kRingZones && claimed - kRingZones > begin) {
+                size_t torn = (size_t) (std::min(end, claimed - kRingZones) - begin);
+                out.erase(out.begin() + base, out.begin() + base + torn);
+            }
+        }
+
+        void writeJsonString(FILE* f, const char* s)
+        {
+            fputc('"', f);
+            for (; *s; ++s) {
+                unsigned char c = (unsigned char) *s;
+                if (c == '"' || c == '\\')
+                    fprintf(f, "\\%c", c);
+                else if (c < 0x20)
+                    fprintf(f, "\\u%04x", c);
+                else
+                    fputc(c, f);
+            }
+            fputc('"', f);
+        }
+
+        ImU32 zoneColor(const char* name)
+        {
+            // Literals have stable addresses, so a zone keeps its colour.
+            uint64_t h = (uint64_t) (uintptr_t) name * 0x9e3779b97f4a7c15ull;
+            float hue = (float) (h >> 40) / (float) (1 << 24);
+            return ImGui::GetColorU32(ImVec4(ImColor::HSV(hue, 0.45f, 0.85f)));
+        }
+
+    }
+
+    void setEnabled(bool on)
+    {
+        detail::enabled.store(on, std::memory_order_relaxed);
+    }
+
+    void setThreadName(const char* name)
+    {
+        threadName = name;
+        if (threadRing)
+            threadRing->name.store(name, std::memory_order_relaxed);
+    }
+
+    uint64_t now()
+    {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    uint32_t detail::enter()
+    {
+        return threadDepth++;
+    }
+
+    void detail::leave(const char* name, uint64_t beginNs, uint32_t depth)
+    {
+        uint64_t endNs = now();
+        --threadDepth;
+        ThreadRing& ring = *thisRing();
+        uint64_t i = ring.claimed.load(std::memory_order_relaxed);
+        ring.claimed.store(i + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        Slot& s = ring.slots[i % kRingZones];
+        s.name.store(name, std::memory_order_relaxed);
+        s.beginNs.store(beginNs, std::memory_order_relaxed);
+        s.endNs.store(endNs, std::memory_order_relaxed);
+        s.depth.store(depth, std::memory_order_relaxed);
+        ring.published.store(i + 1, std::memory_order_release);
+    }
+
+    void collectThisThread(std::vector<ZoneRecord>& out, size_t max)
+    {
+        out.clear();
+        if (threadRing)
+            copyRing(*threadRing, out, max);
+    }
+
+    void collect(std::vector<ThreadTrace>& out)
+    {
+        std::vector<ThreadRing*> rings;
+        {
+            std::lock_guard<std::mutex> lock(registryLock());
+            rings = registry();
+        }
+        out.resize(rings.size());
+        for (size_t t = 0; t < rings.size(); ++t) {
+            out[t].id = rings[t]->id;
+            out[t].name = rings[t]->name.load(std::memory_order_relaxed);
+            out[t].zones.clear();
+            copyRing(*rings[t], out[t].zones, kRingZones);
+        }
+    }
+
+    bool writeChromeTrace(const char* path)
+    {
+        std::vector<ThreadTrace> threads;
+        collect(threads);
+
+        FILE* f = fopen(path, "w");
+        if (!f)
+            return false;
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+        const char* sep = "\n";
+        for (size_t t = 0; t < threads.size(); ++t) {
+            const ThreadTrace& thread = threads[t];
+            if (thread.name) {
+                fprintf(f, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":",
+                        sep, thread.id);
+                writeJsonString(f, thread.name);
+                fputs("}}", f);
+                sep = ",\n";
+            }
+            for (size_t i = 0; i < thread.zones.size(); ++i) {
+                const ZoneRecord& z = thread.zones[i];
+                fprintf(f, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":", sep, thread.id);
+                writeJsonString(f, z.name);
+                fprintf(f, ",\"ts\":%.3f,\"dur\":%.3f}", z.beginNs / 1e3, (z.endNs - z.beginNs) / 1e3);
+                sep = ",\n";
+            }
+        }
+        fputs("\n]}\n", f);
+        bool ok = !ferror(f);
+        return fclose(f) == 0 && ok;
+    }
+
+    void drawOverlay(bool* open)
+    {
+        // Reused from frame to frame.
+        static std::vector<ZoneRecord> zones;
+        static std::vector<float> frameMs;
+        static char exportStatus[64] = "";
+
+        // Plenty for a few hundred frames of the app's handful of zones.
+        collectThisThread(zones, 4096);
+        frameMs.clear();
+        const ZoneRecord* frame = NULL;
+        for (size_t i = 0; i < zones.size(); ++i) {
+            if (zones[i].depth == 0) {
+                frameMs.push_back((zones[i].endNs - zones[i].beginNs) / 1e6f);
+                frame = &zones[i];
+            }
+        }
+
+        ImGui::SetNextWindowSize(ImVec2(800, 400), ImGuiSetCond_FirstUseEver);
+        if (!ImGui::Begin("Profiler", open)) {
+            ImGui::End();
+            return;
+        }
+
+        if (!frame) {
+            ImGui::Text("No complete frame recorded yet");
+        } else {
+            float worst = *std::max_element(frameMs.begin(), frameMs.end());
+            float sum = 0.0f;
+            for (size_t i = 0; i < frameMs.size(); ++i)
+                sum += frameMs[i];
+            ImGui::Text("last %.2f ms, mean %.2f ms, worst %.2f ms over %d frames",
+                        frameMs.back(), sum / frameMs.size(), worst, (int) frameMs.size());
+            float width = ImGui::GetContentRegionAvailWidth();
+            ImGui::PlotLines("##frames", &frameMs[0], (int) frameMs.size(), 0, NULL, 0.0f, worst,
+                             ImVec2(width, 80));
+
+            // Last frame's zones, one row per depth, across the full width.
+            // Its children were stored before it, so they come earlier.
+            ImDrawList* draw = ImGui::GetWindowDrawList();
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+            double scale = width / (double) std::max<uint64_t>(frame->endNs - frame->beginNs, 1);
+            uint32_t rows = 1;
+            for (const ZoneRecord* z = &zones[0]; z <= frame; ++z) {
+                if (z->beginNs < frame->beginNs || z->endNs > frame->endNs)
+                    continue;
+                float x0 = origin.x + (float) ((z->beginNs - frame->beginNs) * scale);
+                float x1 = std::max(x0 + 1.0f, origin.x + (float) ((z->endNs - frame->beginNs) * scale));
+                float y0 = origin.y + z->depth * rowHeight;
+                ImVec2 a(x0, y0), b(x1, y0 + rowHeight - 1.0f);
+                draw->AddRectFilled(a, b, zoneColor(z->name));
+                if (ImGui::CalcTextSize(z->name).x < x1 - x0 - 4.0f)
+                    draw->AddText(ImVec2(x0 + 2.0f, y0), IM_COL32_BLACK, z->name);
+                if (ImGui::IsMouseHoveringRect(a, b))
+                    ImGui::SetTooltip("%s: %.3f ms", z->name, (z->endNs - z->beginNs) / 1e6);
+                rows = std::max(rows, z->depth + 1);
+            }
+            ImGui::Dummy(ImVec2(width, rows * rowHeight));
+        }
+
+        if (ImGui::Button("Export trace")) {
+            if (writeChromeTrace("trace.json"))
+                snprintf(exportStatus, sizeof(exportStatus), "Wrote trace.json");
+            else
+                snprintf(exportStatus, sizeof(exportStatus), "Could not write trace.json");
+        }
+        if (exportStatus[0]) {
+            ImGui::SameLine();
+            ImGui::Text("%s", exportStatus);
+        }
+        ImGui::End();
+    }
+
+}
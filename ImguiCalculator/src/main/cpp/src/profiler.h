@@ -0,0 +1,106 @@
+//
+// Frame profiler: scoped zones, per-thread rings, an ImGui overlay and
+// Chrome trace export.
+//
+// PROFILE_ZONE("name") times the rest of the enclosing scope. Names must be
+// string literals; only the pointer is stored. Each thread records into a
+// ring of its own, allocated on its first zone and kept until the process
+// exits, so recording never takes a lock or allocates. A full ring
+// overwrites its oldest zones. Readers copy a ring while its thread keeps
+// writing, and a sequence count tells them which copied zones may have been
+// overwritten meanwhile; those are dropped.
+//
+// Nothing is recorded until setEnabled(true). Zones are stored when they
+// end, so a thread's zones come out in end order: children before parents.
+//
+
+#ifndef IMGUI_ANDROID_PROFILER_H
+#define IMGUI_ANDROID_PROFILER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace prof {
+
+    struct ZoneRecord {
+        const char* name;
+        uint64_t beginNs;       // since the profiler's epoch
+        uint64_t endNs;
+        uint32_t depth;         // zones open on the thread when it began
+    };
+
+    struct ThreadTrace {
+        uint32_t id;            // 0 for the first thread to record, and so on
+        const char* name;       // NULL if never named
+        std::vector<ZoneRecord> zones;
+    };
+
+    // Zones recorded per thread before the oldest are overwritten.
+    static const size_t kRingZones = 1 << 14;
+
+    void setEnabled(bool on);
+    // Names the calling thread in exports; name must be a literal. Cheap
+    // when profiling is off: the thread's ring is only made by its first zone.
+    void setThreadName(const char* name);
+
+    // Nanoseconds since the profiler's epoch, on the steady clock.
+    uint64_t now();
+
+    // The calling thread's most recent zones, at most max of them, oldest
+    // first. Clears out first but keeps its capacity.
+    void collectThisThread(std::vector<ZoneRecord>& out, size_t max = kRingZones);
+    // Every thread that has recorded, with all the zones its ring holds.
+    void collect(std::vector<ThreadTrace>& out);
+
+    // Writes every thread's zones as Chrome trace-event JSON, loadable in
+    // chrome://tracing or Perfetto. False if the file cannot be written.
+    bool writeChromeTrace(const char* path);
+
+    // Frame times and a flame graph of the last complete frame on the
+    // calling thread. Frames are its depth-0 zones, so the caller should
+    // wrap each frame in one zone and draw the overlay inside it.
+    void drawOverlay(bool* open);
+
+    namespace detail {
+        extern std::atomic<bool> enabled;
+        uint32_t enter();
+        void leave(const char* name, uint64_t beginNs, uint32_t depth);
+    }
+
+    class Zone {
+    public:
+        explicit Zone(const char* name)
+            : name_(name), active_(detail::enabled.load(std::memory_order_relaxed)), depth_(0), beginNs_(0)
+        {
+            if (active_) {
+                depth_ = detail::enter();
+                beginNs_ = now();
+            }
+        }
+
+        ~Zone()
+        {
+            if (active_)
+                detail::leave(name_, beginNs_, depth_);
+        }
+
+    private:
+        Zone(const Zone&);
+        Zone& operator=(const Zone&);
+
+        const char* name_;
+        bool active_;
+        uint32_t depth_;
+        uint64_t beginNs_;
+    };
+
+}
+
+#define PROFILE_ZONE_CONCAT2(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT2(a, b)
+// "" name "" only compiles for a string literal.
+#define PROFILE_ZONE(name) prof::Zone PROFILE_ZONE_CONCAT(profileZone, __LINE__)("" name "")
+
+#endif //IMGUI_ANDROID_PROFILER_H
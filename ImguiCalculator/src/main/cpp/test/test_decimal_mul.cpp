@@ -0,0 +1,135 @@
+//
+// Checks Natural::mul against schoolbook multiplication on random operands.
+//
+// Most operands are past Natural::kKaratsubaLimbs, so the Karatsuba and
+// lopsided paths are the ones exercised. Dense, sparse (mostly zero limbs)
+// and lopsided operands are mixed, and some have runs of zero limbs at the
+// top of their low half, which once made the middle product too short for
+// the subtraction from it. Run under AddressSanitizer for the full check.
+//
+// Usage: calc_decimal_test [count] [seed]
+//
+// Exits with 1 on the first product that differs, after printing the seed
+// and the operand sizes.
+//
+#include "calc_decimal.h"
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using calc::Natural;
+
+namespace {
+
+    typedef std::vector<uint32_t> Limbs;
+
+    Natural fromLimbs(const Limbs& limbs)
+    {
+        Natural n;
+        for (size_t i = limbs.size(); i-- > 0;)
+            n.mulSmall(Natural::kBase, limbs[i]);
+        return n;
+    }
+
+    Limbs toLimbs(const Natural& n)
+    {
+        return Limbs(n.limbs(), n.limbs() + n.size());
+    }
+
+    Limbs trimmed(Limbs x)
+    {
+        while (!x.empty() && x.back() == 0)
+            x.pop_back();
+        return x;
+    }
+
+    Limbs schoolbook(const Limbs& a, const Limbs& b)
+    {
+        Limbs out(a.size() + b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < b.size(); ++j) {
+                uint64_t t = (uint64_t) a[i] * b[j] + out[i + j] + carry;
+                out[i + j] = (uint32_t) (t % Natural::kBase);
+                carry = t / Natural::kBase;
+            }
+            out[i + b.size()] = (uint32_t) carry;
+        }
+        return trimmed(out);
+    }
+
+    enum Shape { DENSE, SPARSE, ZERO_RUN, ALL_MAX, kShapes };
+
+    // n limbs, the top one nonzero.
+    Limbs operand(std::mt19937_64& rng, size_t n, Shape shape)
+    {
+        std::uniform_int_distribution<uint32_t> limb(0, Natural::kBase - 1);
+        Limbs x(n);
+        for (size_t i = 0; i < n; ++i) {
+            switch (shape) {
+            case DENSE: x[i] = limb(rng); break;
+            case SPARSE: x[i] = rng() % 8 == 0 ? limb(rng) : 0; break;
+            case ZERO_RUN: x[i] = limb(rng); break;
+            case ALL_MAX: x[i] = Natural::kBase - 1; break;
+            default: break;
+            }
+        }
+        if (shape == ZERO_RUN) {
+            // Zeros just below the middle, and at the bottom.
+            size_t mid = n / 2;
+            for (size_t i = mid - std::min(mid, (size_t) (rng() % (mid + 1))); i < mid; ++i)
+                x[i] = 0;
+            for (size_t i = 0; i < n && rng() % 2; ++i)
+                x[i] = 0;
+        }
+        if (x[n - 1] == 0)
+            x[n - 1] = 1 + (uint32_t) (rng() % (Natural::kBase - 1));
+        return x;
+    }
+
+    bool check(const Limbs& a, const Limbs& b, const char* what, unsigned long long seed)
+    {
+        Natural product;
+        Natural::mul(fromLimbs(a), fromLimbs(b), product);
+        if (toLimbs(product) == schoolbook(a, b))
+            return true;
+        fprintf(stderr, "calc_decimal_test: %s: product of %zu and %zu limbs differs (seed %llu)\n",
+                what, a.size(), b.size(), seed);
+        return false;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? (size_t) strtoull(argv[1], NULL, 10) : 300;
+    unsigned long long seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+
+    // 64 limbs of sevens times 10^288 + 1: the low half of the second
+    // operand is a one and 31 zero limbs.
+    Limbs sevens(64, 777777777), sparse(33);
+    sparse[0] = 1;
+    sparse[32] = 1;
+    if (!check(sevens, sparse, "sevens times 10^288 + 1", seed))
+        return 1;
+
+    std::mt19937_64 rng(seed);
+    const size_t k = Natural::kKaratsubaLimbs;
+    for (size_t i = 0; i < count; ++i) {
+        Shape sa = (Shape) (rng() % kShapes), sb = (Shape) (rng() % kShapes);
+        size_t an = k + rng() % (8 * k);
+        size_t bn;
+        const char* what;
+        switch (rng() % 3) {
+        case 0: bn = an; what = "balanced"; break;
+        case 1: bn = k + rng() % (an - k + 1); what = "uneven"; break;
+        default: bn = k + rng() % (an / 2 - k / 2 + 1); an = 2 * bn + rng() % (4 * bn); what = "lopsided"; break;
+        }
+        if (!check(operand(rng, an, sa), operand(rng, bn, sb), what, seed))
+            return 1;
+    }
+    printf("calc_decimal_test: %zu products match\n", count + 1);
+    return 0;
+}
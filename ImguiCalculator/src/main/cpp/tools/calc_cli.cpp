@@ -0,0 +1,202 @@
+//
+// Headless front end for the calculator engine.
+//
+// Reads newline-delimited expressions and writes one result per line, in the
+// same text the app shows after "=". Regular files, named or redirected to
+// stdin, are memory-mapped and scanned in place; pipes are read through a
+// fixed buffer that only grows for a line longer than it. The program, the
+// line buffer and the output buffer are reused from line to line, so double
+// mode does no per-line allocation once they have grown to the longest line.
+// Decimal results are built as strings and may allocate when they are long.
+//
+// Usage: calc_cli [-d|--decimal] [file]
+//
+// With no file, or "-", expressions come from stdin. A trailing "\r" on a
+// line is ignored. Exits with 1 on a read or write error, 2 on bad usage.
+//
+#include "calc_decimal.h"
+#include "calc_number.h"
+#include "calc_program.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    // Buffered stdout; write(2) directly, so nothing else buffers behind it.
+    class Output {
+    public:
+        Output() : used_(0), failed_(false) {}
+
+        void append(const char* s, size_t n)
+        {
+            if (n > sizeof(buf_) - used_) {
+                flush();
+                if (n > sizeof(buf_)) {
+                    writeAll(s, n);
+                    return;
+                }
+            }
+            memcpy(buf_ + used_, s, n);
+            used_ += n;
+        }
+
+        void flush()
+        {
+            writeAll(buf_, used_);
+            used_ = 0;
+        }
+
+        bool failed() const { return failed_; }
+
+    private:
+        void writeAll(const char* s, size_t n)
+        {
+            while (n && !failed_) {
+                ssize_t w = write(STDOUT_FILENO, s, n);
+                if (w < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    perror("calc_cli: write");
+                    failed_ = true;
+                    return;
+                }
+                s += w;
+                n -= (size_t) w;
+            }
+        }
+
+        char buf_[1 << 16];
+        size_t used_;
+        bool failed_;
+    };
+
+    class LineEvaluator {
+    public:
+        LineEvaluator(Output& out, bool decimal) : out_(out), decimal_(decimal) {}
+
+        void line(const char* s, size_t n)
+        {
+            if (n && s[n - 1] == '\r')
+                --n;
+            program_.compile(s, n);
+            if (decimal_) {
+                std::string text = calc::evaluateDecimal(program_, s, n).toString();
+                out_.append(text.data(), text.size());
+            } else {
+                char text[calc::kFormatBufferSize];
+                out_.append(text, calc::formatShortest(program_.run(), text));
+            }
+            out_.append("\n", 1);
+        }
+
+        // Every complete line in [s, s + n); returns the bytes consumed.
+        size_t lines(const char* s, size_t n)
+        {
+            size_t done = 0;
+            while (const char* nl = (const char*) memchr(s + done, '\n', n - done)) {
+                line(s + done, (size_t) (nl - (s + done)));
+                done = (size_t) (nl - s) + 1;
+            }
+            return done;
+        }
+
+    private:
+        Output& out_;
+        bool decimal_;
+        calc::Program program_;
+    };
+
+    // False if the file cannot be mapped; the caller falls back to reading.
+    bool evaluateMapped(int fd, LineEvaluator& eval)
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+            return false;
+        size_t size = (size_t) st.st_size;
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            return false;
+        madvise(map, size, MADV_SEQUENTIAL);
+        const char* text = (const char*) map;
+        size_t done = eval.lines(text, size);
+        if (done < size)
+            eval.line(text + done, size - done);
+        munmap(map, size);
+        return true;
+    }
+
+    bool evaluateStream(int fd, LineEvaluator& eval)
+    {
+        std::vector<char> buf(1 << 16);
+        size_t have = 0;
+        for (;;) {
+            if (have == buf.size())
+                buf.resize(buf.size() * 2);     // a line longer than the buffer
+            ssize_t r = read(fd, &buf[have], buf.size() - have);
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                perror("calc_cli: read");
+                return false;
+            }
+            if (r == 0)
+                break;
+            // Only the new bytes can hold a newline the last scan missed.
+            size_t scanFrom = have;
+            have += (size_t) r;
+            if (!memchr(&buf[scanFrom], '\n', have - scanFrom))
+                continue;
+            size_t done = eval.lines(&buf[0], have);
+            memmove(&buf[0], &buf[done], have - done);
+            have -= done;
+        }
+        if (have)
+            eval.line(&buf[0], have);
+        return true;
+    }
+
+    int usage()
+    {
+        fprintf(stderr, "usage: calc_cli [-d|--decimal] [file]\n");
+        return 2;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    bool decimal = false;
+    const char* path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-d") || !strcmp(argv[i], "--decimal"))
+            decimal = true;
+        else if (path || (argv[i][0] == '-' && argv[i][1] != '\0'))
+            return usage();
+        else
+            path = argv[i];
+    }
+
+    int fd = STDIN_FILENO;
+    if (path && strcmp(path, "-") != 0) {
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "calc_cli: %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+    }
+
+    Output out;
+    LineEvaluator eval(out, decimal);
+    bool ok = evaluateMapped(fd, eval) || evaluateStream(fd, eval);
+    out.flush();
+    if (fd != STDIN_FILENO)
+        close(fd);
+    return ok && !out.failed() ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+//
+// Prints an event file written by Logger::setEventFile as text.
+//
+// Each event comes out as one line: seconds since logging started, the
+// severity tag and the call site's format with its arguments filled in, as
+// the app would have printed it. The file layout is described at the top of
+// src/logger.h; it must have been written on a machine of the same byte
+// order.
+//
+// Usage: calc_log_decode [-l|--locations] [file]
+//
+// -l puts the call site's file:line before each line. With no file, or "-",
+// the events come from stdin. Exits with 1 if the file cannot be read, ends
+// in the middle of a record or holds a bad one, after printing every whole
+// event before that point, and 2 on bad usage.
+//
+#include "logger.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Site {
+        int severity;
+        uint32_t line;
+        std::string file;
+        std::string format;
+    };
+
+    // Reads fixed-size fields from the file's bytes; every read fails once
+    // one runs past the end.
+    class Reader {
+    public:
+        Reader(const std::vector<char>& data) : data_(data), pos_(0), ok_(true) {}
+
+        template <typename T>
+        T get()
+        {
+            T v = T();
+            if (need(sizeof(v))) {
+                memcpy(&v, &data_[pos_], sizeof(v));
+                pos_ += sizeof(v);
+            }
+            return v;
+        }
+
+        // A uint16_t size and that many bytes, which stay in the file.
+        const char* sized(size_t* size)
+        {
+            *size = get<uint16_t>();
+            if (!need(*size))
+                return NULL;
+            const char* s = &data_[pos_];
+            pos_ += *size;
+            return s;
+        }
+
+        bool ok() const { return ok_; }
+        bool atEnd() const { return pos_ == data_.size(); }
+        size_t pos() const { return pos_; }
+
+    private:
+        bool need(size_t n)
+        {
+            if (ok_ && data_.size() - pos_ < n)
+                ok_ = false;
+            return ok_;
+        }
+
+        const std::vector<char>& data_;
+        size_t pos_;
+        bool ok_;
+    };
+
+    bool readAll(FILE* f, std::vector<char>& data)
+    {
+        char buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            data.insert(data.end(), buf, buf + n);
+        return !ferror(f);
+    }
+
+    int usage()
+    {
+        fprintf(stderr, "usage: calc_log_decode [-l|--locations] [file]\n");
+        return 2;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    bool locations = false;
+    const char* path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--locations"))
+            locations = true;
+        else if (path || (argv[i][0] == '-' && argv[i][1] != '\0'))
+            return usage();
+        else
+            path = argv[i];
+    }
+    const char* name = path && strcmp(path, "-") != 0 ? path : "stdin";
+
+    FILE* f = stdin;
+    if (path && strcmp(path, "-") != 0 && !(f = fopen(path, "rb"))) {
+        fprintf(stderr, "calc_log_decode: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    std::vector<char> data;
+    bool readOk = readAll(f, data);
+    if (f != stdin)
+        fclose(f);
+    if (!readOk) {
+        fprintf(stderr, "calc_log_decode: %s: read error\n", name);
+        return 1;
+    }
+
+    Reader in(data);
+    char magic[8];
+    for (size_t i = 0; i < sizeof(magic); ++i)
+        magic[i] = in.get<char>();
+    uint32_t byteOrder = in.get<uint32_t>();
+    if (!in.ok() || memcmp(magic, "CALCEVT1", sizeof(magic)) != 0) {
+        fprintf(stderr, "calc_log_decode: %s: not an event file\n", name);
+        return 1;
+    }
+    if (byteOrder != 0x01020304) {
+        fprintf(stderr, "calc_log_decode: %s: written with the other byte order\n", name);
+        return 1;
+    }
+
+    std::vector<Site> sites;
+    std::string text;
+    size_t recordStart = in.pos();
+    while (!in.atEnd()) {
+        recordStart = in.pos();
+        char kind = in.get<char>();
+        uint32_t id = in.get<uint32_t>();
+        if (!in.ok())
+            break;
+        if (kind == 'S') {
+            // Sites are numbered in the order they are written, so anything
+            // else is a corrupt record, not a reason to grow the table.
+            if (id != sites.size()) {
+                fprintf(stderr, "calc_log_decode: %s: site record at offset %zu has id %u, expected %zu\n",
+                        name, recordStart, id, sites.size());
+                return 1;
+            }
+            Site site;
+            site.severity = in.get<uint8_t>();
+            site.line = in.get<uint32_t>();
+            size_t n;
+            const char* s = in.sized(&n);
+            if (s)
+                site.file.assign(s, n);
+            s = in.sized(&n);
+            if (s)
+                site.format.assign(s, n);
+            if (!in.ok())
+                break;
+            sites.push_back(site);
+        } else if (kind == 'E') {
+            uint64_t ns = in.get<uint64_t>();
+            size_t n;
+            const char* args = in.sized(&n);
+            if (!in.ok())
+                break;
+            if (id >= sites.size()) {
+                fprintf(stderr, "calc_log_decode: %s: event at offset %zu has no site\n", name, recordStart);
+                return 1;
+            }
+            const Site& site = sites[id];
+            char prefix[32];
+            snprintf(prefix, sizeof(prefix), "%.6f ", ns / 1e9);
+            text = prefix;
+            text += _Logger::severityTag(site.severity);
+            if (locations) {
+                text += site.file;
+                snprintf(prefix, sizeof(prefix), ":%u: ", site.line);
+                text += prefix;
+            }
+            _Logger::formatEvent(site.format.c_str(), args, n, text);
+            text += '\n';
+            fwrite(text.data(), 1, text.size(), stdout);
+        } else {
+            fprintf(stderr, "calc_log_decode: %s: unknown record at offset %zu\n", name, recordStart);
+            return 1;
+        }
+    }
+    if (!in.ok()) {
+        fprintf(stderr, "calc_log_decode: %s: ends inside the record at offset %zu\n", name, recordStart);
+        return 1;
+    }
+    return ferror(stdout) ? 1 : 0;
+}